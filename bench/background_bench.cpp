@@ -0,0 +1,84 @@
+// ingest latency: inline doubling of emhash8::HashMap against emhash8::BackgroundMap.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread background_bench.cpp -o background
+//   ./background [keys] [start_load]
+//
+//   inline     - emhash8::HashMap, each insert that crosses the load factor rehashes
+//   background - BackgroundMap, the helper thread builds the next table meanwhile
+// every insert is timed; reported are throughput, p99.9/p99.99 and the worst insert.
+// the helper needs a spare core, on a single cpu it competes with the inserts.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+
+#include "hash_background8.hpp"
+
+using my_clock = std::chrono::steady_clock;
+
+//log2 buckets of nanoseconds
+struct Latency
+{
+    uint64_t hist[64] = {0};
+    uint64_t worst = 0, count = 0;
+
+    void add(uint64_t ns)
+    {
+        hist[ns ? 63 - __builtin_clzll(ns) : 0] ++;
+        worst = ns > worst ? ns : worst;
+        count ++;
+    }
+
+    //upper bound of the bucket that holds quantile q
+    uint64_t quantile(double q) const
+    {
+        uint64_t seen = 0;
+        for (int i = 0; i < 64; i++)
+            if ((seen += hist[i]) >= count * q)
+                return UINT64_C(2) << i;
+        return worst;
+    }
+};
+
+template<typename F>
+static void run(const char* name, const std::vector<uint64_t>& keys, F insert)
+{
+    Latency lat;
+    const auto start = my_clock::now();
+    for (const auto key : keys) {
+        const auto t0 = my_clock::now();
+        insert(key);
+        lat.add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(my_clock::now() - t0).count());
+    }
+    const auto secs = std::chrono::duration<double>(my_clock::now() - start).count();
+    printf("%-10s %7.2f M inserts/s  p99.9 < %6.1f us  p99.99 < %8.1f us  worst %8.2f ms\n", name,
+           keys.size() / secs / 1e6, lat.quantile(0.999) / 1e3, lat.quantile(0.9999) / 1e3, lat.worst / 1e6);
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t n  = argc > 1 ? atoll(argv[1]) : 20000000;
+    const float start_load = argc > 2 ? (float)atof(argv[2]) : EMH_BG_START;
+
+    std::vector<uint64_t> keys(n);
+    uint64_t x = 1;
+    for (auto& key : keys)
+        key = x = x * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+    printf("%zd keys, start_load %.2f\n", n, start_load);
+
+    {
+        emhash8::HashMap<uint64_t, uint64_t> map;
+        run("inline", keys, [&](uint64_t key) { map.insert_unique(key, key); });
+    }
+
+    {
+        emhash8::BackgroundMap<uint64_t, uint64_t> map(16, start_load);
+        run("background", keys, [&](uint64_t key) { map.insert(key, key); });
+        const auto& st = map.stats();
+        printf("           %zd migrations, %zd delta entries replayed, longest swap %.2f ms\n",
+               (size_t)st.migrations, (size_t)st.replayed, st.max_swap_ns / 1e6);
+    }
+    return 0;
+}
@@ -25,6 +25,7 @@
 #include "../hash_table8.hpp"
 #include "../hash_table7.hpp"
 #include "../hash_table5.hpp"
+#include "../hash_cpu.hpp"
 
 #include "emilib/emilib3so.hpp"
 #include "emilib/emilib2o.hpp"
@@ -282,7 +283,9 @@ template<template<class...> class Map> BOOST_NOINLINE void test( char const* lab
     times.push_back( rec );
 }
 
-#if ABSL_HASH
+#if HW_HASH
+    #define BstrHasher emcpu::HwHash
+#elif ABSL_HASH
     #define BstrHasher absl::Hash<K>
 #elif BOOST_HASH
     #define BstrHasher boost::hash<K>
@@ -307,6 +310,8 @@ template<class K, class V> using boost_unordered_flat_map =
 template<class K, class V> using emhash_map8 = emhash8::HashMap<K, V, BstrHasher, std::equal_to<K>>;
 template<class K, class V> using emhash_map7 = emhash7::HashMap<K, V, BstrHasher, std::equal_to<K>>;
 template<class K, class V> using emhash_map5 = emhash5::HashMap<K, V, BstrHasher, std::equal_to<K>>;
+template<class V, class K = std::string_view> using emhash_arena8 = emhash8::StringMap<V, BstrHasher>;
+template<class K, class V> using emhash_str8 = emhash_arena8<V>;
 
 template<class K, class V> using martinus_flat = robin_hood::unordered_map<K, V, BstrHasher, std::equal_to<K>>;
 template<class K, class V> using martinus_dense = ankerl::unordered_dense::map<K, V, BstrHasher, std::equal_to<K>>;
@@ -423,10 +428,70 @@ template<class K, class V> using tsl_robin_pg_map_fnv1a =
 
 #endif
 
+#if HW_HASH && EMH_CPU_X64
+// ns per hash of wyhash and aes-ni over key lengths (best of 5, hashes chained through the seed).
+// the longest run of lengths where aes wins (the first of equal runs) becomes
+// emcpu::aes_range() for the rest of the run, open ended when it reaches the last length
+static void pick_aes_range()
+{
+    if (!emcpu::has_aes()) {
+        std::cout << "no aes-ni/sse4.2, HwHash uses the wyhash fallback\n\n";
+        return;
+    }
+
+    constexpr size_t lengths[] = {16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 1024, 4096};
+    constexpr size_t keys = 256;
+    std::vector<char> pool(keys * 4096 + 64);
+    for (size_t i = 0; i < pool.size(); i++)
+        pool[i] = (char)(i * 0x9E3779B97F4A7C15ull >> 56);
+
+    size_t min_len = 0, max_len = 0, run_min = 0, run = 0, best = 0;
+    std::uint64_t sum = 0;
+    std::cout << "   len   wyhash ns  aes ns\n";
+    for (auto len : lengths) {
+        const int loops = (int)(1024 * 1024 / len) + 64;
+        double ns[2] = {1e9, 1e9};
+        for (int rep = 0; rep < 10; rep++) {
+            const int hw = rep % 2;
+            auto t0 = std::chrono::steady_clock::now();
+            for (int l = 0; l < loops; l++) {
+                const char* key = pool.data() + (l % keys) * len;
+                sum += hw ? emcpu::aes_hash_bytes(key, len, sum) : emcpu::wyhash_bytes(key, len, sum);
+            }
+            ns[hw] = std::min(ns[hw], std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / loops);
+        }
+        std::cout << std::setw(6) << len << std::setw(11) << std::setprecision(3) << ns[0] << std::setw(9) << ns[1] << "\n";
+        if (ns[1] >= ns[0]) {
+            run = 0;
+            continue;
+        }
+        if (run++ == 0)
+            run_min = len;
+        if (run > best) {
+            best = run;
+            min_len = run_min;
+            max_len = len;
+        }
+    }
+
+    if (max_len == lengths[sizeof(lengths) / sizeof(lengths[0]) - 1])
+        max_len = SIZE_MAX;
+    emcpu::aes_range() = {min_len ? min_len : SIZE_MAX, max_len};
+    if (min_len == 0)
+        std::cout << "aes never wins, HwHash strings use wyhash (sum " << (sum & 0xFF) << ")\n\n";
+    else
+        std::cout << "pick -DEMH_AES_MIN=" << min_len << (max_len == SIZE_MAX ? "" : " -DEMH_AES_MAX=" + std::to_string(max_len))
+            << " (sum " << (sum & 0xFF) << ")\n\n";
+}
+#endif
+
 //
 
 int main()
 {
+#if HW_HASH && EMH_CPU_X64
+    pick_aes_range();
+#endif
     init_indices();
 
 //    test<std_unordered_map>( "std::unordered_map" );
@@ -435,6 +500,7 @@ int main()
 
     test<emhash_map7>( "emhash7::hash_map" );
     test<emhash_map8>( "emhash8::hash_map" );
+    test<emhash_str8>( "emhash8::StringMap" );
     test<martinus_dense>("martinus::dense_hash_map" );
     test<martinus_flat>("martinus::flat_hash_map" );
 
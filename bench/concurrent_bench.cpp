@@ -0,0 +1,105 @@
+// dedup stage: many threads insert 64 bit fingerprints into one shared table that never erases.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread concurrent_bench.cpp -o concurrent
+// g++ -I.. -I../thirdparty -I../thirdparty/ck -I../thirdparty/ck/base -DCK_HMAP=1 -O3 -march=native -pthread concurrent_bench.cpp -o concurrent
+//   ./concurrent [threads] [fingerprints per thread] [duplicate %]
+//
+//   concurrent - emhash5::ConcurrentMap, CAS inserts, cooperative growth
+//   mutex      - emhash5::HashMap behind a std::mutex
+//   cuckoo     - libcuckoo::cuckoohash_map (fine grained bucket locks)
+//   ck         - ck::HashMap behind a std::mutex (-DCK_HMAP=1)
+// every table starts small and grows, reported in million inserts/s over all threads.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hash_concurrent5.hpp"
+#include "libcuckoo/cuckoohash_map.hh"
+#if CK_HMAP
+#include "ck/Common/HashTable/HashMap.h"
+#endif
+
+using my_clock = std::chrono::steady_clock;
+
+static inline uint64_t wymix(uint64_t x)
+{
+    x ^= x >> 33; x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33; x *= UINT64_C(0xc4ceb9fe1a85ec53);
+    return x ^ (x >> 33);
+}
+
+//thread t sees fingerprint i of its own stream, or with dup% one of another thread's
+static inline uint64_t fingerprint(int t, uint64_t i, int threads, int dup)
+{
+    const auto r = wymix(i * 131 + t);
+    const auto owner = (int)(r % 100) < dup ? (int)(r >> 40) % threads : t;
+    return wymix((uint64_t)owner << 40 | i);
+}
+
+template<typename Insert, typename Size>
+static void run(const char* name, int threads, uint64_t per_thread, int dup, Insert insert, Size size)
+{
+    std::vector<std::thread> workers;
+    std::atomic<size_t> fresh{0};
+    const auto start = my_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            size_t n = 0;
+            for (uint64_t i = 0; i < per_thread; i++)
+                n += insert(fingerprint(t, i, threads, dup), (uint32_t)i);
+            fresh += n;
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    const auto secs = std::chrono::duration<double>(my_clock::now() - start).count();
+    printf("%-10s %3d threads %8.2f M inserts/s  %zd unique (size %zd)\n",
+           name, threads, threads * per_thread / secs / 1e6, (size_t)fresh, (size_t)size());
+}
+
+int main(int argc, char* argv[])
+{
+    const int threads         = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+    const uint64_t per_thread = argc > 2 ? atoll(argv[2]) : 2000000;
+    const int dup             = argc > 3 ? atoi(argv[3]) : 30;
+
+    {
+        emhash5::ConcurrentMap<uint64_t, uint32_t> map;
+        run("concurrent", threads, per_thread, dup,
+            [&](uint64_t key, uint32_t val) { return map.insert(key, val); },
+            [&] { return map.size(); });
+        printf("           %u resizes, %u buckets\n", map.resize_count(), map.bucket_count());
+    }
+
+    {
+        emhash5::HashMap<uint64_t, uint32_t> map;
+        std::mutex lock;
+        run("mutex", threads, per_thread, dup,
+            [&](uint64_t key, uint32_t val) { std::lock_guard<std::mutex> guard(lock); return map.emplace(key, val).second; },
+            [&] { return map.size(); });
+    }
+
+    {
+        libcuckoo::cuckoohash_map<uint64_t, uint32_t> map;
+        run("cuckoo", threads, per_thread, dup,
+            [&](uint64_t key, uint32_t val) { return map.insert(key, val); },
+            [&] { return map.size(); });
+    }
+
+#if CK_HMAP
+    {
+        ck::HashMap<uint64_t, uint32_t> map;
+        std::mutex lock;
+        run("ck", threads, per_thread, dup,
+            [&](uint64_t key, uint32_t val) { std::lock_guard<std::mutex> guard(lock); return map.insert({key, val}).second; },
+            [&] { return map.size(); });
+    }
+#endif
+    return 0;
+}
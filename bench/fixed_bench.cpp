@@ -0,0 +1,131 @@
+// fixed size binary keys (16 byte uuids, 32 byte digests) in every emhash table.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native fixed_bench.cpp -o fixed
+//   ./fixed [keys] [loops]
+//
+// each table runs twice with the same keys:
+//   user  - a byte loop hasher (fnv-1a) and std::equal_to, what a std::array key usually gets
+//   fixed - emcpu::FixedHash and emcpu::FixedEqual, unrolled loads and sse/avx compares
+// reported in ns per operation: insert, find hit, find miss, erase.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <array>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <functional>
+
+#include "hash_table5.hpp"
+#include "hash_table6.hpp"
+#include "hash_table7.hpp"
+#include "hash_table8.hpp"
+#include "hash_set8.hpp"
+#include "hash_cpu.hpp"
+
+struct Fnv1aHash
+{
+    template<typename T>
+    size_t operator()(const T& key) const
+    {
+        uint64_t h = UINT64_C(0xCBF29CE484222325);
+        for (auto c : key)
+            h = (h ^ (uint8_t)c) * UINT64_C(0x00000100000001B3);
+        return (size_t)h;
+    }
+};
+
+using my_clock = std::chrono::steady_clock;
+
+static double now_ns()
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(my_clock::now().time_since_epoch()).count();
+}
+
+template<typename M, typename K>
+inline void add(M& m, const K& key, int i, std::false_type) { m.emplace(key, i); }
+template<typename M, typename K>
+inline void add(M& m, const K& key, int, std::true_type) { m.insert(key); }
+
+template<typename M>
+struct is_set
+{
+    template<typename U> static std::false_type test(typename U::mapped_type*);
+    template<typename U> static std::true_type  test(...);
+    using type = decltype(test<M>(nullptr));
+};
+
+template<typename M, typename K>
+static void run(const char* name, const char* variant, const std::vector<K>& keys, const std::vector<K>& miss, int loops)
+{
+    double best[4] = {1e30, 1e30, 1e30, 1e30};
+    size_t sum = 0;
+    const auto n = (double)keys.size();
+    for (int l = 0; l < loops; l++) {
+        M m;
+        auto t0 = now_ns();
+        for (size_t i = 0; i < keys.size(); i++)
+            add(m, keys[i], (int)i, typename is_set<M>::type());
+        auto t1 = now_ns();
+        for (const auto& key : keys)
+            sum += m.count(key);
+        auto t2 = now_ns();
+        for (const auto& key : miss)
+            sum += m.count(key);
+        auto t3 = now_ns();
+        for (const auto& key : keys)
+            sum += m.erase(key);
+        auto t4 = now_ns();
+        const double ns[4] = {t1 - t0, t2 - t1, t3 - t2, t4 - t3};
+        for (int i = 0; i < 4; i++)
+            best[i] = std::min(best[i], ns[i] / n);
+    }
+    printf("%-22s %-6s %8.1f %8.1f %8.1f %8.1f   %zd\n", name, variant, best[0], best[1], best[2], best[3], sum);
+}
+
+#define RUN_MAP(MAP, K) \
+    run<MAP<K, int, Fnv1aHash, std::equal_to<K>>>(#MAP, "user", keys, miss, loops); \
+    run<MAP<K, int, emcpu::FixedHash, emcpu::FixedEqual>>(#MAP, "fixed", keys, miss, loops)
+
+#define RUN_SET(SET, K) \
+    run<SET<K, Fnv1aHash, std::equal_to<K>>>(#SET, "user", keys, miss, loops); \
+    run<SET<K, emcpu::FixedHash, emcpu::FixedEqual>>(#SET, "fixed", keys, miss, loops)
+
+template<size_t N>
+static void bench(size_t count, int loops)
+{
+    using K = std::array<uint8_t, N>;
+    std::mt19937_64 rng(N * count);
+    std::vector<K> keys(count), miss(count);
+    for (auto* v : {&keys, &miss}) {
+        for (auto& key : *v) {
+            for (auto& c : key)
+                c = (uint8_t)rng();
+        }
+    }
+
+    printf("\n%zd byte keys, %zd keys (ns/op)\n", N, count);
+    printf("%-22s %-6s %8s %8s %8s %8s\n", "table", "eq", "insert", "hit", "miss", "erase");
+    RUN_MAP(emhash5::HashMap, K);
+    RUN_MAP(emhash6::HashMap, K);
+    RUN_MAP(emhash7::HashMap, K);
+    RUN_MAP(emhash8::HashMap, K);
+    RUN_SET(emhash8::HashSet, K);
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t count = argc > 1 ? (size_t)atoll(argv[1]) : 1000000;
+    const int loops = argc > 2 ? atoi(argv[2]) : 3;
+#if __AVX2__
+    printf("compare: avx2 (32 byte) + sse2\n");
+#elif EMH_CPU_X64
+    printf("compare: sse2\n");
+#else
+    printf("compare: scalar\n");
+#endif
+    bench<16>(count, loops);
+    bench<32>(count, loops);
+    return 0;
+}
@@ -0,0 +1,140 @@
+// zipfian lookups of a shared map from many threads, with and without an emfront::FrontCache.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread front_bench.cpp -o front
+//   ./front [threads] [keys] [lookups per thread] [zipf s] [write per mille]
+//
+//   locked - every lookup takes the shared_mutex of one emhash8::HashMap
+//   frontN - a thread local FrontCache of N entries in front of it, writes bump a Generation
+// hot keys are spread over the key space, reported in million lookups/s over all threads.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "hash_table8.hpp"
+#include "hash_front.hpp"
+
+using my_clock = std::chrono::steady_clock;
+
+static inline uint64_t wymix(uint64_t x)
+{
+    x ^= x >> 33; x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33; x *= UINT64_C(0xc4ceb9fe1a85ec53);
+    return x ^ (x >> 33);
+}
+
+struct Shared
+{
+    emhash8::HashMap<uint64_t, uint64_t> map;
+    std::shared_mutex lock;
+    emfront::Generation gen;
+};
+
+//a negative op is a write of key -op - 1
+using Ops = std::vector<std::vector<int64_t>>;
+
+template<typename Lookup>
+static void run(const char* name, Shared& shared, const Ops& ops, Lookup lookup)
+{
+    std::vector<std::thread> workers;
+    std::vector<double> rates(ops.size());
+    std::vector<uint64_t> sums(ops.size());
+    const auto start = my_clock::now();
+    for (size_t t = 0; t < ops.size(); t++) {
+        workers.emplace_back([&, t] {
+            uint64_t sum = 0;
+            auto cache = lookup();
+            for (const auto op : ops[t]) {
+                if (op < 0) {
+                    std::unique_lock<std::shared_mutex> guard(shared.lock);
+                    shared.map[wymix(-op - 1)] ++;
+                    shared.gen.bump(std::hash<uint64_t>()(wymix(-op - 1)));
+                } else {
+                    uint64_t val = 0;
+                    cache(wymix(op), val);
+                    sum += val;
+                }
+            }
+            rates[t] = cache.hit_rate();
+            sums[t] = sum;
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    const auto secs = std::chrono::duration<double>(my_clock::now() - start).count();
+    double hit = 0;
+    uint64_t sum = 0;
+    for (size_t t = 0; t < ops.size(); t++)
+        hit += rates[t] / ops.size(), sum += sums[t];
+    printf("%-10s %8.2f M lookups/s  hit rate %5.1f%%  (sum %zx)\n", name, ops.size() * ops[0].size() / secs / 1e6, hit * 100, (size_t)sum);
+}
+
+struct Locked
+{
+    Shared* shared;
+    bool operator()(uint64_t key, uint64_t& val)
+    {
+        std::shared_lock<std::shared_mutex> guard(shared->lock);
+        return shared->map.try_get(key, val);
+    }
+    double hit_rate() const { return 0; }
+};
+
+template<uint32_t N>
+struct Front
+{
+    Shared* shared;
+    std::unique_ptr<emfront::FrontCache<uint64_t, uint64_t, N>> cache;
+
+    explicit Front(Shared* s) : shared(s), cache(new emfront::FrontCache<uint64_t, uint64_t, N>(s->gen)) {}
+    bool operator()(uint64_t key, uint64_t& val)
+    {
+        return cache->find(key, val, Locked{shared});
+    }
+    double hit_rate() const { return cache->hit_rate(); }
+};
+
+int main(int argc, char* argv[])
+{
+    const int threads   = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+    const size_t keys   = argc > 2 ? atoll(argv[2]) : 1000000;
+    const size_t per    = argc > 3 ? atoll(argv[3]) : 10000000;
+    const double s      = argc > 4 ? atof(argv[4]) : 0.99;
+    const int permille  = argc > 5 ? atoi(argv[5]) : 1;
+
+    std::vector<double> cdf(keys);
+    double total = 0;
+    for (size_t i = 0; i < keys; i++)
+        cdf[i] = total += 1 / std::pow((double)(i + 1), s);
+    const auto top = cdf[std::max<size_t>(keys / 100, 1) - 1] / total;
+
+    Ops ops(threads, std::vector<int64_t>(per));
+    for (int t = 0; t < threads; t++) {
+        std::mt19937_64 rng(t + 1);
+        std::uniform_real_distribution<double> uni(0, total);
+        for (auto& op : ops[t]) {
+            const auto rank = (int64_t)(std::lower_bound(cdf.begin(), cdf.end(), uni(rng)) - cdf.begin());
+            op = (int)(rng() % 1000) < permille ? -rank - 1 : rank;
+        }
+    }
+    printf("%d threads, %zd keys, zipf %.2f (top 1%% keys take %.0f%%), %d per mille writes\n",
+           threads, keys, s, top * 100, permille);
+
+    Shared shared;
+    for (size_t i = 0; i < keys; i++)
+        shared.map[wymix(i)] = i;
+
+    run("locked",    shared, ops, [&] { return Locked{&shared}; });
+    run("front256",  shared, ops, [&] { return Front<256>(&shared); });
+    run("front1024", shared, ops, [&] { return Front<1024>(&shared); });
+    run("front4096", shared, ops, [&] { return Front<4096>(&shared); });
+    return 0;
+}
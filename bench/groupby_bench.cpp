@@ -0,0 +1,87 @@
+// GROUP BY key, SUM(val): one operator[] loop against emhash8::GroupBy partitions.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread groupby_bench.cpp -o groupby
+//   ./groupby [rows] [groups] [threads]
+//
+//   operator[] - emhash8::HashMap, map[key] += val over all rows
+//   serial     - GroupBy on emhash8::SerialExecutor: radix partitions on one thread
+//   threads    - GroupBy on a thread pool, then merge_into() one map
+// keys are uniform over the groups, reported in million rows/s.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "hash_groupby8.hpp"
+
+using my_clock = std::chrono::steady_clock;
+
+//a fixed set of threads fed with task ranges through one counter
+struct ThreadExecutor
+{
+    int threads;
+
+    template<typename F>
+    void operator()(size_t tasks, const F& task) const
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back([&] { for (size_t i; (i = next++) < tasks; ) task(i); });
+        for (size_t i; (i = next++) < tasks; )
+            task(i);
+        for (auto& w : workers)
+            w.join();
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    const size_t rows   = argc > 1 ? atoll(argv[1]) : 50000000;
+    const size_t groups = argc > 2 ? atoll(argv[2]) : 5000000;
+    const int threads   = argc > 3 ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+
+    std::vector<uint64_t> keys(rows);
+    std::vector<int64_t> vals(rows);
+    uint64_t x = 1;
+    for (size_t i = 0; i < rows; i++) {
+        x = x * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+        keys[i] = (x >> 20) % groups * UINT64_C(0x9E3779B97F4A7C15);
+        vals[i] = (int64_t)(x >> 54);
+    }
+    printf("%zd rows, %zd groups, %d threads\n", rows, groups, threads);
+
+    int64_t check = 0;
+    {
+        const auto start = my_clock::now();
+        emhash8::HashMap<uint64_t, int64_t> map;
+        for (size_t i = 0; i < rows; i++)
+            map[keys[i]] += vals[i];
+        const auto secs = std::chrono::duration<double>(my_clock::now() - start).count();
+        check = map[keys[rows / 2]];
+        printf("operator[] %8.2f M rows/s  %zd groups\n", rows / secs / 1e6, (size_t)map.size());
+    }
+
+    using GroupSum = emhash8::GroupBy<uint64_t, emhash8::agg::Sum<int64_t>>;
+    {
+        GroupSum group;
+        const auto& st = group.aggregate(keys.data(), vals.data(), rows, emhash8::SerialExecutor());
+        printf("serial     %8.2f M rows/s  %zd groups, %u partitions\n", st.rows_per_sec() / 1e6, (size_t)st.groups, st.partitions);
+    }
+
+    {
+        GroupSum group;
+        const auto& st = group.aggregate(keys.data(), vals.data(), rows, ThreadExecutor{threads});
+        const auto start = my_clock::now();
+        emhash8::HashMap<uint64_t, int64_t> out;
+        group.merge_into(out);
+        const auto ms = std::chrono::duration<double, std::milli>(my_clock::now() - start).count();
+        printf("threads    %8.2f M rows/s  %zd groups, merge_into %.1f ms %s\n", st.rows_per_sec() / 1e6,
+               (size_t)out.size(), ms, out[keys[rows / 2]] == check ? "" : "MISMATCH");
+    }
+    return 0;
+}
@@ -0,0 +1,320 @@
+// hash quality analyzer: run every known hasher over one key population and pick one.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -fpermissive hash_quality.cpp -o hq
+//   ./hq -g seq|stride|random|high|str|rstr [n] [mask_bits]   generated keys
+//   ./hq -f keys.txt [mask_bits]                              one key per line, integer when every line is a number
+//
+// per hasher it reports
+//   avalanche  - mean and worst |P(output bit flips) - 0.5| when one input bit flips
+//   bit bias   - worst |P(output bit == 1) - 0.5| over the low mask_bits bits that select a bucket
+//   buckets    - occupied buckets vs a random function, largest bucket
+//   emhash8    - every non empty main bucket keeps one of its keys and the rest chain from it,
+//                so main-bucket occupancy and hit/miss probe lengths follow from the bucket counts
+//   speed      - ns per key, hashing the whole set
+// and recommends the fastest hasher whose collisions stay close to a random function.
+
+#ifndef EMH_INT_HASH
+    #define EMH_INT_HASH 1
+#endif
+#define EMH_WYHASH_HASH 1
+
+#include "util.h"
+#include "hash_table8.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <functional>
+
+#define STR_(x) #x
+#define STR(x)  STR_(x)
+
+using my_clock = std::chrono::steady_clock;
+using emhash8_int = emhash8::HashMap<uint64_t, int>;
+
+struct Result
+{
+    std::string name;
+    double aval_mean, aval_worst, bit_bias;
+    double used_ratio;   //occupied buckets / expected for a random function
+    uint32_t max_bucket;
+    double main_ratio, hit_probe, miss_probe;
+    double ns_key;
+};
+
+static std::vector<Result> s_results;
+static uint32_t s_mask_bits = 0;
+static uint64_t s_checksum = 0;
+
+static void bucket_stats(const std::vector<uint64_t>& hashes, Result& res)
+{
+    const uint64_t buckets = 1ull << s_mask_bits, mask = buckets - 1;
+    std::vector<uint32_t> counts(buckets, 0);
+    for (auto h : hashes)
+        counts[h & mask] ++;
+
+    uint64_t used = 0, hit_sum = 0, miss_sum = 0;
+    uint32_t max_bucket = 0;
+    for (auto c : counts) {
+        if (c == 0)
+            continue;
+        used ++;
+        hit_sum  += (uint64_t)c * (c + 1) / 2;
+        miss_sum += c;
+        max_bucket = std::max(max_bucket, c);
+    }
+
+    const double n = (double)hashes.size(), lambda = n / buckets;
+    const double expect_used = buckets * (1 - std::exp(-lambda));
+    res.used_ratio = used / expect_used;
+    res.max_bucket = max_bucket;
+    res.main_ratio = used / n;
+    res.hit_probe  = hit_sum / n;
+    res.miss_probe = (double)miss_sum / buckets;
+
+    //ones ratio of the bits that pick the bucket
+    double worst = 0;
+    for (uint32_t bit = 0; bit < s_mask_bits; bit++) {
+        uint64_t ones = 0;
+        for (auto h : hashes)
+            ones += (h >> bit) & 1;
+        worst = std::max(worst, std::fabs(ones / n - 0.5));
+    }
+    res.bit_bias = worst;
+}
+
+template<typename Key>
+static void flip_bit(Key& key, uint32_t bit) { key ^= (Key)1 << bit; }
+static void flip_bit(std::string& key, uint32_t bit) { key[bit / 8] ^= (char)(1 << (bit % 8)); }
+template<typename Key>
+static uint32_t input_bits(const Key&) { return sizeof(Key) * 8; }
+static uint32_t input_bits(const std::string& key) { return (uint32_t)std::min<size_t>(key.size() * 8, 256); }
+
+template<typename Key, typename Hasher>
+static void avalanche(const std::vector<Key>& keys, Hasher hasher, Result& res)
+{
+    //flip[i * 64 + j]: input bit i flipped output bit j
+    std::vector<uint32_t> flip(256 * 64, 0), trials(256, 0);
+    const size_t samples = std::min<size_t>(keys.size(), 2000);
+    const size_t stride  = keys.size() / samples;
+    for (size_t s = 0; s < samples; s++) {
+        auto key = keys[s * stride];
+        const uint64_t base = hasher(key);
+        const auto bits = input_bits(key);
+        for (uint32_t i = 0; i < bits; i++) {
+            flip_bit(key, i);
+            auto diff = base ^ (uint64_t)hasher(key);
+            flip_bit(key, i);
+            trials[i] ++;
+            for (uint32_t j = 0; diff; j++, diff >>= 1)
+                flip[i * 64 + j] += diff & 1;
+        }
+    }
+
+    double sum = 0, worst = 0; uint64_t cells = 0;
+    for (uint32_t i = 0; i < 256; i++) {
+        if (trials[i] == 0)
+            continue;
+        for (uint32_t j = 0; j < 64; j++) {
+            const auto bias = std::fabs(flip[i * 64 + j] / (double)trials[i] - 0.5);
+            sum += bias; cells ++;
+            worst = std::max(worst, bias);
+        }
+    }
+    res.aval_mean  = cells ? sum / cells : 0;
+    res.aval_worst = worst;
+}
+
+template<typename Key, typename Hasher>
+static void analyze(const char* name, const std::vector<Key>& keys, Hasher hasher)
+{
+    Result res;
+    res.name = name;
+
+    std::vector<uint64_t> hashes(keys.size());
+    uint64_t sum = 0;
+    double best_ns = 1e30;
+    for (int loop = 0; loop < 3; loop++) {
+        const auto start = my_clock::now();
+        for (size_t i = 0; i < keys.size(); i++)
+            sum += hashes[i] = hasher(keys[i]);
+        best_ns = std::min(best_ns, (double)std::chrono::duration_cast<std::chrono::nanoseconds>(my_clock::now() - start).count());
+    }
+    res.ns_key = best_ns / keys.size();
+
+    bucket_stats(hashes, res);
+    avalanche(keys, hasher, res);
+    s_results.emplace_back(res);
+
+    s_checksum += sum;
+    printf("%-20s %6.3lf %6.3lf %7.4lf %8.3lf %6u %7.3lf %6.3lf %6.3lf %7.2lf\n", name,
+            res.aval_mean, res.aval_worst, res.bit_bias, res.used_ratio, res.max_bucket,
+            res.main_ratio, res.hit_probe, res.miss_probe, res.ns_key);
+}
+
+static void print_head(size_t n)
+{
+    const double lambda = (double)n / (1ull << s_mask_bits);
+    printf("keys = %zd, mask bits = %u, load factor = %.3lf\n", n, s_mask_bits, lambda);
+    printf("random function: main ratio %.3lf, hit probe %.3lf, miss probe %.3lf\n\n",
+            (1 - std::exp(-lambda)) / lambda, 1 + lambda / 2, lambda);
+    printf("%-20s %6s %6s %7s %8s %6s %7s %6s %6s %7s\n", "hasher", "aval", "a_max", "bitbias",
+            "used/rnd", "maxb", "main", "hit", "miss", "ns/key");
+}
+
+static void recommend(size_t n)
+{
+    //within bounds: hit probe and occupied buckets no worse than a random function (a few % noise).
+    //a hasher with weak avalanche can still win on this key set, so a robust pick is reported too.
+    const double lambda = (double)n / (1ull << s_mask_bits);
+    const double random_hit = 1 + lambda / 2;
+    const Result* best = nullptr, *robust = nullptr;
+
+    puts("");
+    for (const auto& res : s_results) {
+        const bool bad_hit = res.hit_probe > random_hit * 1.03, bad_used = res.used_ratio < 0.97;
+        if (bad_hit || bad_used) {
+            printf("  reject %-20s", res.name.data());
+            if (bad_hit)
+                printf(" hit probe %.3lf > random %.3lf", res.hit_probe, random_hit);
+            if (bad_used)
+                printf("%s used/rnd %.3lf < 0.97", bad_hit ? "," : "", res.used_ratio);
+            puts("");
+            continue;
+        }
+        if (!best || res.ns_key < best->ns_key)
+            best = &res;
+        if (res.aval_worst < 0.1 && (!robust || res.ns_key < robust->ns_key))
+            robust = &res;
+    }
+
+    if (!best) {
+        puts("\nno hasher stays within the collision bounds for this key set");
+        return;
+    }
+    printf("\nrecommend %s: %.2lf ns/key, main ratio %.3lf, hit probe %.3lf\n",
+            best->name.data(), best->ns_key, best->main_ratio, best->hit_probe);
+    if (robust && robust != best)
+        printf("          %s if the key distribution may change (worst avalanche %.3lf vs %.3lf)\n",
+                robust->name.data(), robust->aval_worst, best->aval_worst);
+}
+
+static void run_int(const std::vector<uint64_t>& keys)
+{
+    print_head(keys.size());
+    analyze("std::hash", keys, [](uint64_t key) { return (uint64_t)std::hash<uint64_t>()(key); });
+    analyze("hashfib", keys, [](uint64_t key) { return hashfib(key); });
+    analyze("hashmix", keys, [](uint64_t key) { return hashmix(key); });
+    analyze("rrxmrrxmsx_0", keys, [](uint64_t key) { return rrxmrrxmsx_0(key); });
+    analyze("hash_mur3", keys, [](uint64_t key) { return hash_mur3(key); });
+    analyze("Int64Hasher", keys, [](uint64_t key) { return (uint64_t)Int64Hasher<uint64_t>()(key); });
+#if WYHASH_LITTLE_ENDIAN
+    analyze("wyhash64", keys, [](uint64_t key) { return wyhash64(key, UINT64_C(11400714819323198485)); });
+#endif
+    analyze("emhash8::hash64/" STR(EMH_INT_HASH), keys, [](uint64_t key) { return emhash8_int::hash64(key); });
+    recommend(keys.size());
+}
+
+static void run_str(const std::vector<std::string>& keys)
+{
+    print_head(keys.size());
+    analyze("std::hash", keys, [](const std::string& key) { return (uint64_t)std::hash<std::string>()(key); });
+#if WYHASH_LITTLE_ENDIAN
+    analyze("WysHasher", keys, [](const std::string& key) { return (uint64_t)WysHasher()(key); });
+#endif
+#if AHASH_AHASH_H
+    analyze("Ahash64er", keys, [](const std::string& key) { return (uint64_t)Ahash64er()(key); });
+#endif
+#if KOMI_HESH
+    analyze("KomiHasher", keys, [](const std::string& key) { return (uint64_t)KomiHasher()(key); });
+#endif
+    analyze("emhash8::wyhashstr", keys, [](const std::string& key) { return emhash8_int::wyhashstr(key.data(), key.size()); });
+    recommend(keys.size());
+}
+
+static bool load_keys(const char* path, std::vector<uint64_t>& ints, std::vector<std::string>& strs)
+{
+    std::ifstream ifs(path);
+    if (!ifs)
+        return false;
+
+    bool all_int = true;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+        if (all_int) {
+            char* end = nullptr;
+            const auto val = strtoull(line.data(), &end, 0);
+            if (end && *end == '\0')
+                ints.emplace_back(val);
+            else
+                all_int = false;
+        }
+        strs.emplace_back(line);
+    }
+    if (!all_int)
+        ints.clear();
+    return !strs.empty();
+}
+
+static void gen_keys(const std::string& kind, size_t n, std::vector<uint64_t>& ints, std::vector<std::string>& strs)
+{
+    WyRand rng(n);
+    for (size_t i = 0; i < n; i++) {
+        if (kind == "seq")
+            ints.emplace_back(i);
+        else if (kind == "stride")
+            ints.emplace_back(i << 12);
+        else if (kind == "high")
+            ints.emplace_back(i << 32);
+        else if (kind == "random")
+            ints.emplace_back(rng());
+        else if (kind == "str")
+            strs.emplace_back("user_id_" + std::to_string(i));
+        else {
+            std::string key(8 + rng() % 24, '\0');
+            for (auto& c : key)
+                c = 'a' + rng() % 26;
+            strs.emplace_back(std::move(key));
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<uint64_t> ints;
+    std::vector<std::string> strs;
+    size_t mask_arg = 2;
+
+    if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+        if (!load_keys(argv[2], ints, strs)) {
+            printf("can not read keys from %s\n", argv[2]);
+            return 1;
+        }
+        mask_arg = 3;
+    } else if (argc > 2 && strcmp(argv[1], "-g") == 0) {
+        const size_t n = argc > 3 ? (size_t)atoll(argv[3]) : 1000000;
+        gen_keys(argv[2], n ? n : 1, ints, strs);
+        mask_arg = 4;
+    } else {
+        printf("usage: %s -g seq|stride|random|high|str|rstr [n] [mask_bits]\n", argv[0]);
+        printf("       %s -f key_file [mask_bits]\n", argv[0]);
+        return 1;
+    }
+
+    //default mask: the bucket count emhash8 holds n keys with at the default load factor
+    const size_t n = ints.empty() ? strs.size() : ints.size();
+    s_mask_bits = argc > (int)mask_arg ? (uint32_t)atoi(argv[mask_arg]) : 0;
+    if (s_mask_bits == 0 || s_mask_bits > 32)
+        for (s_mask_bits = 2; (1ull << s_mask_bits) * 0.80 < n; s_mask_bits++);
+
+    if (!ints.empty())
+        run_int(ints);
+    else
+        run_str(strs);
+    return (int)(s_checksum & 0);
+}
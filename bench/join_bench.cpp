@@ -0,0 +1,104 @@
+// equi join of a build and a probe column: one big emhash8 probed in place against emhash8::HashJoin.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread join_bench.cpp -o join
+//   ./join [build rows] [probe rows] [threads] [match %]
+//
+//   naive   - one emhash8::HashMap over all build keys plus a next array, probe rows in order
+//   serial  - HashJoin on emhash8::SerialExecutor: both sides radix partitioned, L2 sized tables
+//   threads - HashJoin on a thread pool
+// every build key appears twice, reported as build ms and million probe rows/s of an inner join.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "hash_join8.hpp"
+
+using my_clock = std::chrono::steady_clock;
+
+//a fixed set of threads fed with task ranges through one counter
+struct ThreadExecutor
+{
+    int threads;
+
+    template<typename F>
+    void operator()(size_t tasks, const F& task) const
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back([&] { for (size_t i; (i = next++) < tasks; ) task(i); });
+        for (size_t i; (i = next++) < tasks; )
+            task(i);
+        for (auto& w : workers)
+            w.join();
+    }
+};
+
+static inline uint64_t wymix(uint64_t x)
+{
+    x ^= x >> 33; x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33; x *= UINT64_C(0xc4ceb9fe1a85ec53);
+    return x ^ (x >> 33);
+}
+
+template<typename Exec>
+static void run(const char* name, const std::vector<uint64_t>& build, const std::vector<uint64_t>& probe, Exec&& exec)
+{
+    emhash8::HashJoin<uint64_t> join;
+    const auto& st = join.build(build.data(), build.size(), exec);
+    std::atomic<uint64_t> sum{0};
+    join.inner(probe.data(), probe.size(), exec, [&](size_t b, size_t p) { sum.fetch_add(b ^ p, std::memory_order_relaxed); });
+    printf("%-8s build %8.1f ms, probe %8.2f M rows/s  %zd matches, %u partitions (check %zx)\n", name, st.build_seconds * 1e3,
+           st.probe_rows_per_sec() / 1e6, (size_t)st.matches, st.partitions, (size_t)sum);
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t build_rows = argc > 1 ? atoll(argv[1]) : 20000000;
+    const size_t probe_rows = argc > 2 ? atoll(argv[2]) : 200000000;
+    const int threads       = argc > 3 ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+    const int match         = argc > 4 ? atoi(argv[4]) : 50;
+
+    std::vector<uint64_t> build(build_rows), probe(probe_rows);
+    for (size_t i = 0; i < build_rows; i++)
+        build[i] = wymix(i / 2);
+    for (size_t i = 0; i < probe_rows; i++) {
+        const auto r = wymix(i + build_rows);
+        build_rows && (int)(r % 100) < match ? probe[i] = wymix(r % ((build_rows + 1) / 2)) : probe[i] = r;
+    }
+    printf("%zd build rows, %zd probe rows, %d threads, %d%% matching\n", build_rows, probe_rows, threads, match);
+
+    {
+        auto start = my_clock::now();
+        emhash8::HashMap<uint64_t, uint32_t> map;
+        std::vector<uint32_t> next(build_rows);
+        for (size_t i = 0; i < build_rows; i++) {
+            auto it = map.try_emplace(build[i], (uint32_t)i);
+            next[i] = it.second ? ~0u : it.first->second;
+            it.first->second = (uint32_t)i;
+        }
+        const auto build_ms = std::chrono::duration<double, std::milli>(my_clock::now() - start).count();
+
+        start = my_clock::now();
+        uint64_t sum = 0, matches = 0;
+        for (size_t p = 0; p < probe_rows; p++) {
+            const auto it = map.find(probe[p]);
+            if (it == map.end())
+                continue;
+            for (auto b = it->second; b != ~0u; b = next[b], matches++)
+                sum += b ^ p;
+        }
+        const auto secs = std::chrono::duration<double>(my_clock::now() - start).count();
+        printf("%-8s build %8.1f ms, probe %8.2f M rows/s  %zd matches (check %zx)\n", "naive", build_ms,
+               probe_rows / secs / 1e6, (size_t)matches, (size_t)sum);
+    }
+
+    run("serial", build, probe, emhash8::SerialExecutor());
+    run("threads", build, probe, ThreadExecutor{threads});
+    return 0;
+}
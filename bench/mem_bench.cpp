@@ -0,0 +1,267 @@
+// memory footprint of emhash maps and sets.
+//
+// g++ -I.. -I../thirdparty -O2 mem_bench.cpp -o mem
+//   ./mem [max_size] [erase_percent]
+//
+// emhash tables call malloc/free directly and ignore any std allocator, so the
+// accounting here interposes the c heap (glibc only) and records live and peak
+// bytes. that needs a dynamic link: with -static the libc malloc family is defined
+// twice, the Makefile builds mem without it. every table is measured in isolation:
+//   bytes/entry  - live heap bytes after inserting n keys divided by n
+//   grow peak    - highest live bytes reached while inserting, relative to the final size.
+//                  emhash rebuilds into a fresh allocation, so old + new buckets coexist.
+//   churn        - live bytes and process rss after erasing erase_percent of the keys
+//   shrink       - live bytes after shrink_to_fit() and the peak reached during it
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+#if __linux__
+    #include <unistd.h>
+#endif
+#if __GLIBC__
+    #include <malloc.h>
+#endif
+
+#include "hash_table5.hpp"
+#include "hash_table6.hpp"
+#include "hash_table7.hpp"
+#include "hash_table8.hpp"
+#include "hash_set2.hpp"
+#include "hash_set3.hpp"
+#include "hash_set4.hpp"
+#include "hash_set8.hpp"
+#include "hash_quotient.hpp"
+
+static size_t s_live_bytes = 0, s_peak_bytes = 0, s_alloc_count = 0;
+
+#if __GLIBC__
+#define EMH_TRACK_HEAP 1
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void  __libc_free(void* ptr);
+
+static inline void* track_alloc(void* ptr)
+{
+    if (ptr) {
+        s_alloc_count ++;
+        s_live_bytes += malloc_usable_size(ptr);
+        if (s_live_bytes > s_peak_bytes)
+            s_peak_bytes = s_live_bytes;
+    }
+    return ptr;
+}
+
+void* malloc(size_t size) { return track_alloc(__libc_malloc(size)); }
+void* calloc(size_t n, size_t size) { return track_alloc(__libc_calloc(n, size)); }
+
+void free(void* ptr)
+{
+    if (ptr)
+        s_live_bytes -= malloc_usable_size(ptr);
+    __libc_free(ptr);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    //realloc may move: account the new block before the old one is released
+    const auto old_size = ptr ? malloc_usable_size(ptr) : 0;
+    auto* new_ptr = __libc_realloc(ptr, size);
+    if (new_ptr || size == 0)
+        s_live_bytes -= old_size;
+    return track_alloc(new_ptr);
+}
+}
+#else
+#define EMH_TRACK_HEAP 0
+#endif
+
+static size_t current_rss_kb()
+{
+#if __linux__
+    long pages = 0, resident = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp) {
+        if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(fp);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+    return 0;
+#endif
+}
+
+static inline void reset_peak() { s_peak_bytes = s_live_bytes; }
+
+template<typename T> inline T make_key(uint64_t i) { return (T)(i * UINT64_C(0x9E3779B97F4A7C15) >> 7); }
+template<> inline std::string make_key<std::string>(uint64_t i)
+{
+    //24 bytes, longer than the libstdc++ sso buffer so every key owns a heap block
+    char buff[32];
+    snprintf(buff, sizeof(buff), "key_%020llu", (unsigned long long)i);
+    return buff;
+}
+
+template<typename V> inline V make_value(uint64_t i) { return (V)i; }
+
+template<typename M, typename K>
+inline void add(M& m, const K& key, std::true_type) { m.insert(key); }
+template<typename M, typename K>
+inline void add(M& m, const K& key, std::false_type) { m.emplace(key, make_value<typename M::mapped_type>(0)); }
+
+template<typename M> struct is_set
+{
+    template<typename U> static std::false_type test(typename U::mapped_type*);
+    template<typename U> static std::true_type  test(...);
+    static constexpr bool value = decltype(test<M>(nullptr))::value;
+};
+
+//not every table has shrink_to_fit (emhash7::HashSet), fall back to nothing
+template<typename M>
+static auto shrink(M& m, int) -> decltype(m.shrink_to_fit(), bool()) { m.shrink_to_fit(); return true; }
+template<typename M>
+static bool shrink(M&, long) { return false; }
+
+struct MemResult
+{
+    double bytes_entry;
+    double grow_peak;    //peak / final live bytes
+    size_t churn_bytes;
+    size_t churn_rss_kb;
+    size_t shrink_bytes;
+    size_t shrink_peak;
+    bool   has_shrink;
+};
+
+template<typename M, bool = is_set<M>::value> struct key_of { using type = typename M::value_type; };
+template<typename M> struct key_of<M, false> { using type = typename M::key_type; };
+
+template<typename M>
+static MemResult measure(size_t n, int erase_percent)
+{
+    using K = typename key_of<M>::type;
+    using is_set_t = std::integral_constant<bool, is_set<M>::value>;
+
+    std::vector<K> keys; keys.reserve(n);
+    for (size_t i = 0; i < n; i++)
+        keys.emplace_back(make_key<K>(i + 1));
+
+    MemResult res;
+    const auto base = s_live_bytes;
+    {
+        auto* m = new M();
+        const auto start = s_live_bytes;
+        reset_peak();
+        for (const auto& key : keys)
+            add(*m, key, is_set_t());
+        const auto live = s_live_bytes - start;
+        res.bytes_entry = (double)live / (m->size() + !m->size());
+        res.grow_peak   = (double)(s_peak_bytes - start) / (live + !live);
+
+        const auto erased = n * erase_percent / 100;
+        for (size_t i = 0; i < erased; i++)
+            m->erase(keys[i]);
+#if __GLIBC__
+        malloc_trim(0);
+#endif
+        res.churn_bytes  = s_live_bytes - start;
+        res.churn_rss_kb = current_rss_kb();
+
+        reset_peak();
+        res.has_shrink   = shrink(*m, 0);
+        res.shrink_bytes = s_live_bytes - start;
+        res.shrink_peak  = s_peak_bytes - start;
+        delete m;
+    }
+
+    if (s_live_bytes != base)
+        printf("    leak %zd bytes\n", (size_t)(s_live_bytes - base));
+    return res;
+}
+
+template<typename M>
+static void report(const char* name, size_t n, int erase_percent)
+{
+    const auto r = measure<M>(n, erase_percent);
+    printf("%-42s %10zd %9.2lf %8.2lfx %10.2lf %8.1lf",
+            name, n, r.bytes_entry, r.grow_peak, r.churn_bytes / 1048576.0, r.churn_rss_kb / 1024.0);
+    if (r.has_shrink)
+        printf(" %10.2lf %10.2lf\n", r.shrink_bytes / 1048576.0, r.shrink_peak / 1048576.0);
+    else
+        printf(" %10s %10s\n", "-", "-");
+}
+
+#define REPORT(...) report<__VA_ARGS__>(#__VA_ARGS__, n, erase_percent)
+
+static void run_maps(size_t n, int erase_percent)
+{
+    REPORT(emhash5::HashMap<uint32_t, uint32_t>);
+    REPORT(emhash6::HashMap<uint32_t, uint32_t>);
+    REPORT(emhash7::HashMap<uint32_t, uint32_t>);
+    REPORT(emhash8::HashMap<uint32_t, uint32_t>);
+
+    REPORT(emhash5::HashMap<uint64_t, uint32_t>);
+    REPORT(emhash6::HashMap<uint64_t, uint32_t>);
+    REPORT(emhash7::HashMap<uint64_t, uint32_t>);
+    REPORT(emhash8::HashMap<uint64_t, uint32_t>);
+    REPORT(emhash8::QuotientMap<uint64_t, uint32_t>);
+
+    REPORT(emhash5::HashMap<uint64_t, uint64_t>);
+    REPORT(emhash6::HashMap<uint64_t, uint64_t>);
+    REPORT(emhash7::HashMap<uint64_t, uint64_t>);
+    REPORT(emhash8::HashMap<uint64_t, uint64_t>);
+
+    REPORT(emhash5::HashMap<std::string, int>);
+    REPORT(emhash6::HashMap<std::string, int>);
+    REPORT(emhash7::HashMap<std::string, int>);
+    REPORT(emhash8::HashMap<std::string, int>);
+}
+
+static void run_sets(size_t n, int erase_percent)
+{
+    REPORT(emhash2::HashSet<uint32_t>);
+    REPORT(emhash7::HashSet<uint32_t>);
+    REPORT(emhash9::HashSet<uint32_t>);
+    REPORT(emhash8::HashSet<uint32_t>);
+
+    REPORT(emhash2::HashSet<uint64_t>);
+    REPORT(emhash7::HashSet<uint64_t>);
+    REPORT(emhash9::HashSet<uint64_t>);
+    REPORT(emhash8::HashSet<uint64_t>);
+    REPORT(emhash8::QuotientSet<uint64_t>);
+
+    REPORT(emhash2::HashSet<std::string>);
+    REPORT(emhash7::HashSet<std::string>);
+    REPORT(emhash9::HashSet<std::string>);
+    REPORT(emhash8::HashSet<std::string>);
+}
+
+int main(int argc, char* argv[])
+{
+#if EMH_TRACK_HEAP == 0
+    printf("heap tracking needs glibc, only rss is reported\n");
+#endif
+    const size_t max_size   = argc > 1 ? (size_t)atoll(argv[1]) : 1000000;
+    const int erase_percent = argc > 2 ? atoi(argv[2]) : 90;
+
+    //sizes just below and above a power of two show the load factor sawtooth
+    for (size_t n = 1000; n <= max_size; n *= 10) {
+        for (auto size : {n, n * 3 / 2}) {
+            if (size > max_size)
+                break;
+            printf("\n%-42s %10s %9s %9s %10s %8s %10s %10s\n", "table", "size", "B/entry", "grow_pk",
+                    "churn_MB", "rss_MB", "shrink_MB", "shrink_pk");
+            run_maps(size, erase_percent);
+            run_sets(size, erase_percent);
+        }
+    }
+    return 0;
+}
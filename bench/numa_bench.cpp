@@ -0,0 +1,107 @@
+// random lookups of one big table from threads on every node: one emhash8 against emhash8::NumaMap.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread numa_bench.cpp -o numa
+// g++ -I.. -I../thirdparty -DEMH_NUMA=1 -O3 -march=native -pthread numa_bench.cpp -o numa -lnuma
+//   ./numa [threads] [keys] [lookups per thread]
+//
+//   single      - one emhash8::HashMap built by the main thread, pages wherever they landed
+//   partitioned - NumaMap, shards spread over the nodes by hash
+//   replicated  - NumaMap, one copy per node, every lookup local
+// threads are pinned round robin over the cpus, reported in million lookups/s over all threads.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#include "hash_numa8.hpp"
+
+using my_clock = std::chrono::steady_clock;
+
+static inline uint64_t wymix(uint64_t x)
+{
+    x ^= x >> 33; x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33; x *= UINT64_C(0xc4ceb9fe1a85ec53);
+    return x ^ (x >> 33);
+}
+
+static void pin(int t)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(t % std::thread::hardware_concurrency(), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    emnuma::rebind_thread();
+#else
+    (void)t;
+#endif
+}
+
+template<typename Find>
+static void run(const char* name, int threads, uint64_t keys, uint64_t per, Find find)
+{
+    std::vector<std::thread> workers;
+    std::vector<uint64_t> found(threads);
+    const auto start = my_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            pin(t);
+            uint64_t n = 0, r = t + 1;
+            for (uint64_t i = 0; i < per; i++)
+                n += find(wymix(wymix(r++ * 7) % (keys * 2)));
+            found[t] = n;
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    const auto secs = std::chrono::duration<double>(my_clock::now() - start).count();
+    uint64_t n = 0;
+    for (auto f : found)
+        n += f;
+    printf("%-12s %8.2f M lookups/s  %.1f%% found\n", name, threads * per / secs / 1e6, 100.0 * n / (threads * per));
+}
+
+template<typename Map>
+static void report(const Map& map)
+{
+    const auto stats = map.stats();
+    for (size_t node = 0; node < stats.size(); node++) {
+        const auto& st = stats[node];
+        printf("  node %zd: %u shards, %zd entries, %.1f MB, %zd local / %zd remote lookups\n", node, st.shards,
+               (size_t)st.entries, st.bytes / 1e6, (size_t)st.local_lookups, (size_t)st.remote_lookups);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int threads   = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+    const uint64_t keys = argc > 2 ? atoll(argv[2]) : 20000000;
+    const uint64_t per  = argc > 3 ? atoll(argv[3]) : 10000000;
+    printf("%d threads, %zd keys, %d numa nodes\n", threads, (size_t)keys, emnuma::nodes());
+
+    {
+        emhash8::HashMap<uint64_t, uint64_t> map;
+        for (uint64_t k = 0; k < keys; k++)
+            map.emplace(wymix(k), k);
+        run("single", threads, keys, per, [&](uint64_t key) { return map.contains(key); });
+    }
+
+    using Numa = emhash8::NumaMap<uint64_t, uint64_t>;
+    for (auto mode : {Numa::PARTITIONED, Numa::REPLICATED}) {
+        Numa map(mode, 4, true);
+        map.reserve(keys);
+        for (uint64_t k = 0; k < keys; k++)
+            map.insert(wymix(k), k);
+        run(mode == Numa::PARTITIONED ? "partitioned" : "replicated", threads, keys, per,
+            [&](uint64_t key) { return map.contains(key); });
+        report(map);
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+// periodic config rebuilds of a big read mostly map: cost to publish a batch of updates.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread publish_bench.cpp -o publish
+//   ./publish [keys] [batch] [rounds] [readers]
+//
+//   clone     - copy the live map (clone), apply the batch, swap a shared_ptr under a mutex
+//   published - emhash8::Published: replay the last batch on the retired version, apply, swap
+// readers keep looking up random keys meanwhile, reported in million lookups/s.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hash_publish8.hpp"
+
+using Map = emhash8::HashMap<uint64_t, uint64_t>;
+using my_clock = std::chrono::steady_clock;
+static std::atomic<size_t> hits{0};
+
+static inline uint64_t lcg(uint64_t& x)
+{
+    x = x * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+    return x >> 20;
+}
+
+template<typename Lookup, typename Publish>
+static void run(const char* name, int readers, int rounds, Lookup lookup, Publish publish)
+{
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> total{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < readers; t++) {
+        threads.emplace_back([&, t] {
+            uint64_t x = t + 1;
+            size_t n = lookup(x, stop);
+            total += n;
+        });
+    }
+
+    const auto start = my_clock::now();
+    double worst = 0;
+    for (int r = 0; r < rounds; r++) {
+        const auto t0 = my_clock::now();
+        publish(r);
+        worst = std::max(worst, std::chrono::duration<double, std::milli>(my_clock::now() - t0).count());
+    }
+    const auto secs = std::chrono::duration<double>(my_clock::now() - start).count();
+    stop = true;
+    for (auto& t : threads)
+        t.join();
+    printf("%-10s %8.2f ms/publish (worst %7.2f)  readers %7.1f M lookups/s\n",
+           name, secs * 1e3 / rounds, worst, total / secs / 1e6);
+}
+
+int main(int argc, char* argv[])
+{
+    const uint64_t keys = argc > 1 ? atoll(argv[1]) : 5000000;
+    const int batch     = argc > 2 ? atoi(argv[2]) : 10000;
+    const int rounds    = argc > 3 ? atoi(argv[3]) : 20;
+    const int readers   = argc > 4 ? atoi(argv[4]) : 2;
+
+    Map base;
+    base.reserve(keys);
+    for (uint64_t k = 0; k < keys; k++)
+        base.emplace(k, k);
+    printf("%zd keys, batch %d, %d rounds, %d readers\n", (size_t)keys, batch, rounds, readers);
+
+    {
+        std::shared_ptr<const Map> live = std::make_shared<const Map>(base);
+        std::mutex lock;
+        run("clone", readers, rounds,
+            [&](uint64_t& x, std::atomic<bool>& stop) {
+                size_t n = 0, sum = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    std::shared_ptr<const Map> snap;
+                    { std::lock_guard<std::mutex> guard(lock); snap = live; }
+                    for (int i = 0; i < 256; i++)
+                        sum += snap->count(lcg(x) % keys);
+                    n += 256;
+                }
+                hits += sum;
+                return n;
+            },
+            [&](int r) {
+                std::shared_ptr<const Map> cur;
+                { std::lock_guard<std::mutex> guard(lock); cur = live; }
+                auto next = std::make_shared<Map>(*cur);
+                uint64_t x = r;
+                for (int i = 0; i < batch; i++)
+                    next->insert_or_assign(lcg(x) % keys, (uint64_t)r);
+                std::lock_guard<std::mutex> guard(lock);
+                live = std::move(next);
+            });
+    }
+
+    {
+        emhash8::Published<Map> pub(Map(base), readers + 1);
+        size_t reused = 0;
+        run("published", readers, rounds,
+            [&](uint64_t& x, std::atomic<bool>& stop) {
+                auto reader = pub.reader();
+                size_t n = 0, sum = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    auto snap = reader.snapshot();
+                    for (int i = 0; i < 256; i++)
+                        sum += snap->count(lcg(x) % keys);
+                    n += 256;
+                }
+                hits += sum;
+                return n;
+            },
+            [&](int r) {
+                emhash8::Published<Map>::Batch b;
+                b.reserve(batch);
+                uint64_t x = r;
+                for (int i = 0; i < batch; i++)
+                    b.insert_or_assign(lcg(x) % keys, (uint64_t)r);
+                reused += pub.publish(std::move(b));
+            });
+        printf("           %zd of %d publishes reused the retired version\n", reused, rounds);
+    }
+    return 0;
+}
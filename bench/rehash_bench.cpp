@@ -0,0 +1,76 @@
+// rehash of a very large emhash8 map: rehash() against parallel_rehash() on a thread pool.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread rehash_bench.cpp -o rehash
+//   ./rehash [keys] [threads]
+//
+// parallel_rehash() builds the layout of rehash() with any executor, checked per key with
+// index_bucket(). only copying, clearing and hashing run on the pool, placement stays serial.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "hash_table8.hpp"
+
+using Map = emhash8::HashMap<uint64_t, uint64_t>;
+using my_clock = std::chrono::steady_clock;
+
+//a fixed set of threads fed with task ranges through one counter
+struct ThreadExecutor
+{
+    int threads;
+
+    template<typename F>
+    void operator()(size_t tasks, const F& task) const
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back([&] { for (size_t i; (i = next++) < tasks; ) task(i); });
+        for (size_t i; (i = next++) < tasks; )
+            task(i);
+        for (auto& w : workers)
+            w.join();
+    }
+};
+
+template<typename F>
+static double timeit(F f)
+{
+    const auto start = my_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(my_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    const uint64_t keys = argc > 1 ? atoll(argv[1]) : 20000000;
+    const int threads   = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+
+    Map base;
+    base.reserve(keys);
+    for (uint64_t k = 0; k < keys; k++)
+        base.emplace(k * UINT64_C(0x9E3779B97F4A7C15), k);
+    printf("%zd keys, %d threads\n", (size_t)keys, threads);
+
+    Map plain = base, serial = base, parallel = base;
+    const auto buckets = keys * 2;
+    const auto t0 = timeit([&] { plain.rehash(buckets); });
+    const auto t1 = timeit([&] { serial.parallel_rehash(buckets, emhash8::SerialExecutor()); });
+    const auto t2 = timeit([&] { parallel.parallel_rehash(buckets, ThreadExecutor{threads}); });
+
+    bool same = plain.size() == parallel.size() && plain.bucket_count() == parallel.bucket_count();
+    for (uint64_t k = 0; same && k < keys; k++) {
+        const auto key = k * UINT64_C(0x9E3779B97F4A7C15);
+        same = plain.index_bucket(key) == parallel.index_bucket(key) && plain.index_bucket(key) == serial.index_bucket(key);
+    }
+    printf("rehash            %8.1f ms\n", t0);
+    printf("parallel serial   %8.1f ms\n", t1);
+    printf("parallel %3d thr  %8.1f ms  layout of rehash %s\n", threads, t2, same ? "yes" : "NO");
+    return 0;
+}
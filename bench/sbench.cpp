@@ -80,6 +80,7 @@ std::map<std::string, std::string> maps =
 #include "hash_set3.hpp"
 #include "hash_set4.hpp"
 #include "hash_set8.hpp"
+#include "hash_cpu.hpp"
 
 
 //https://www.zhihu.com/question/46156495
@@ -1056,6 +1057,8 @@ static int benchHashSet(int n)
 
 #if ABSL_HASH
     using ehash_func = absl::Hash<keyType>;
+#elif HW_HASH && (KEY_STR || KEY_INT)
+    using ehash_func = emcpu::HwHash;
 #elif WY_HASH && KEY_STR
     using ehash_func = WysHasher;
 #elif AHASH_AHASH_H && KEY_STR
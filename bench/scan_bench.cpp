@@ -0,0 +1,87 @@
+// periodic full table passes: an aggregation and an expiry sweep, serial against parallel_*.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread scan_bench.cpp -o scan
+//   ./scan [keys] [threads] [expired %]
+//
+//   reduce  - sum of all values, iterator loop against parallel_reduce()
+//   erase   - erase_if() against parallel_erase_if(), same victims in both
+// emhash7 splits its buckets (whole bitmask words), emhash8 its dense slots.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "hash_table7.hpp"
+#include "hash_table8.hpp"
+
+using my_clock = std::chrono::steady_clock;
+
+//a fixed set of threads fed with task ranges through one counter
+struct ThreadExecutor
+{
+    int threads;
+
+    template<typename F>
+    void operator()(size_t tasks, const F& task) const
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back([&] { for (size_t i; (i = next++) < tasks; ) task(i); });
+        for (size_t i; (i = next++) < tasks; )
+            task(i);
+        for (auto& w : workers)
+            w.join();
+    }
+};
+
+template<typename F>
+static double timeit(F f)
+{
+    const auto start = my_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(my_clock::now() - start).count();
+}
+
+template<typename Map>
+static void run(const char* name, uint64_t keys, int threads, int expired)
+{
+    Map base;
+    base.reserve(keys);
+    for (uint64_t k = 0; k < keys; k++)
+        base.emplace(k * UINT64_C(0x9E3779B97F4A7C15), k);
+
+    uint64_t sum1 = 0, sum2 = 0;
+    const auto t0 = timeit([&] { for (const auto& kv : base) sum1 += kv.second; });
+    const auto t1 = timeit([&] {
+        sum2 = base.parallel_reduce(ThreadExecutor{threads}, (uint64_t)0,
+            [](const auto& kv) { return kv.second; },
+            [](uint64_t a, uint64_t b) { return a + b; });
+    });
+
+    auto pred = [expired](const auto& kv) { return (int)(kv.second % 100) < expired; };
+    Map serial = base, parallel = base;
+    size_t n1 = 0, n2 = 0;
+    const auto t2 = timeit([&] { n1 = serial.erase_if(pred); });
+    const auto t3 = timeit([&] { n2 = parallel.parallel_erase_if(ThreadExecutor{threads}, pred); });
+
+    printf("%-8s reduce %8.1f ms, parallel %8.1f ms %s\n", name, t0, t1, sum1 == sum2 ? "" : "MISMATCH");
+    printf("%-8s erase  %8.1f ms, parallel %8.1f ms %s (%zd erased)\n", name, t2, t3,
+           n1 == n2 && serial.size() == parallel.size() ? "" : "MISMATCH", n2);
+}
+
+int main(int argc, char* argv[])
+{
+    const uint64_t keys = argc > 1 ? atoll(argv[1]) : 20000000;
+    const int threads   = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+    const int expired   = argc > 3 ? atoi(argv[3]) : 10;
+
+    printf("%zd keys, %d threads, %d%% expired\n", (size_t)keys, threads, expired);
+    run<emhash7::HashMap<uint64_t, uint64_t>>("emhash7", keys, threads, expired);
+    run<emhash8::HashMap<uint64_t, uint64_t>>("emhash8", keys, threads, expired);
+    return 0;
+}
@@ -0,0 +1,153 @@
+// read mostly routing table: many reader threads, one writer at a fixed update rate.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -pthread swmr_bench.cpp -o swmr
+//   ./swmr [readers] [keys] [writes/s] [seconds]
+//
+// the same emhash7::HashMap behind
+//   swmr   - emhash7::SwmrMap, lock free readers, stripe versions + epoch reclamation
+//   rwlock - std::shared_mutex (shared lock per batch of lookups)
+//   mutex  - std::mutex (lock per batch of lookups)
+// readers look up 64 keys per batch (80% hit), reported in million lookups/s over all readers.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "hash_swmr7.hpp"
+
+struct Route
+{
+    uint32_t next_hop;
+    uint32_t port;
+};
+
+using my_clock = std::chrono::steady_clock;
+static constexpr int BATCH = 64;
+
+static inline uint64_t lcg(uint64_t& x)
+{
+    x = x * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+    return x >> 33;
+}
+
+template<typename ReadBatch, typename Write>
+static void run(const char* name, int readers, uint64_t keys, int writes, double seconds, ReadBatch read_batch, Write write)
+{
+    std::atomic<bool> stop{false};
+    std::vector<size_t> lookups(readers * 16);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < readers; t++) {
+        threads.emplace_back([&, t] {
+            uint64_t x = t + 1, n = 0, hit = 0;
+            uint64_t batch[BATCH];
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (auto& key : batch)
+                    key = lcg(x) % (keys + keys / 4);
+                hit += read_batch(t, batch);
+                n += BATCH;
+            }
+            lookups[t * 16] = n + (hit & 0);
+        });
+    }
+
+    uint64_t x = 99, done = 0;
+    const auto start = my_clock::now();
+    const auto period = std::chrono::nanoseconds((int64_t)(1e9 / (writes > 0 ? writes : 1)));
+    auto next = start;
+    while (my_clock::now() - start < std::chrono::duration<double>(seconds)) {
+        if (writes > 0 && my_clock::now() >= next) {
+            const auto key = lcg(x) % keys;
+            write(key, (done++ % 4) == 0);
+            next += period;
+        }
+        std::this_thread::yield();
+    }
+    stop = true;
+    for (auto& t : threads)
+        t.join();
+
+    size_t total = 0;
+    for (int t = 0; t < readers; t++)
+        total += lookups[t * 16];
+    printf("%-8s %3d readers %8.1f M lookups/s  %6zd writes\n", name, readers, total / seconds / 1e6, (size_t)done);
+}
+
+int main(int argc, char* argv[])
+{
+    const int readers   = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency() - 1;
+    const uint64_t keys = argc > 2 ? atoll(argv[2]) : 1000000;
+    const int writes    = argc > 3 ? atoi(argv[3]) : 500;
+    const double secs   = argc > 4 ? atof(argv[4]) : 3;
+
+    {
+        emhash7::SwmrMap<uint64_t, Route> map(16, readers + 1);
+        map.reserve(keys);
+        for (uint64_t k = 0; k < keys; k++)
+            map.insert(k, Route{(uint32_t)k, (uint32_t)k & 63});
+        std::vector<emhash7::SwmrMap<uint64_t, Route>::Reader> handles;
+        for (int t = 0; t < readers; t++)
+            handles.emplace_back(map.reader());
+        run("swmr", readers, keys, writes, secs,
+            [&](int t, const uint64_t* batch) {
+                auto& r = handles[t];
+                auto guard = r.pin();
+                size_t hit = 0; Route v;
+                for (int i = 0; i < BATCH; i++)
+                    hit += r.find(batch[i], v);
+                return hit;
+            },
+            [&](uint64_t key, bool erase) {
+                if (erase) map.erase(key); else map.insert_or_assign(key, Route{(uint32_t)key + 1, 1});
+            });
+        printf("         published %u tables, %zd read retries\n", map.publish_count(), map.read_retries());
+    }
+
+    {
+        emhash7::HashMap<uint64_t, Route> map(keys);
+        std::shared_mutex lock;
+        for (uint64_t k = 0; k < keys; k++)
+            map.emplace(k, Route{(uint32_t)k, (uint32_t)k & 63});
+        run("rwlock", readers, keys, writes, secs,
+            [&](int, const uint64_t* batch) {
+                std::shared_lock<std::shared_mutex> guard(lock);
+                size_t hit = 0;
+                for (int i = 0; i < BATCH; i++) {
+                    auto it = map.find(batch[i]);
+                    hit += it != map.end() && it->second.port < 64;
+                }
+                return hit;
+            },
+            [&](uint64_t key, bool erase) {
+                std::unique_lock<std::shared_mutex> guard(lock);
+                if (erase) map.erase(key); else map.insert_or_assign(key, Route{(uint32_t)key + 1, 1});
+            });
+    }
+
+    {
+        emhash7::HashMap<uint64_t, Route> map(keys);
+        std::mutex lock;
+        for (uint64_t k = 0; k < keys; k++)
+            map.emplace(k, Route{(uint32_t)k, (uint32_t)k & 63});
+        run("mutex", readers, keys, writes, secs,
+            [&](int, const uint64_t* batch) {
+                std::lock_guard<std::mutex> guard(lock);
+                size_t hit = 0;
+                for (int i = 0; i < BATCH; i++) {
+                    auto it = map.find(batch[i]);
+                    hit += it != map.end() && it->second.port < 64;
+                }
+                return hit;
+            },
+            [&](uint64_t key, bool erase) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (erase) map.erase(key); else map.insert_or_assign(key, Route{(uint32_t)key + 1, 1});
+            });
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+// compact binary operation trace used by trace_bench.cpp
+//
+// file layout: TraceHeader | TraceRecord[count]
+// every record is 12 bytes: 64 bit key + 4 bit op + 28 bit value size.
+// a production service can include this header and feed TraceWriter::add()
+// from its own map wrapper to capture the real access pattern.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace emtrace {
+
+enum TraceOp : uint8_t
+{
+    OP_FIND   = 0,
+    OP_INSERT = 1, //insert if absent (emplace)
+    OP_ASSIGN = 2, //insert or overwrite (operator[])
+    OP_ERASE  = 3,
+    OP_CLEAR  = 4,
+    OP_COUNT
+};
+
+static const char* const op_name[OP_COUNT] = {"find", "insert", "assign", "erase", "clear"};
+
+constexpr uint32_t TRACE_VERSION    = 1;
+constexpr uint32_t TRACE_SIZE_BITS  = 28;
+constexpr uint32_t TRACE_SIZE_MASK  = (1u << TRACE_SIZE_BITS) - 1;
+
+struct TraceHeader
+{
+    char     magic[8];    //"EMTRACE"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+};
+
+#pragma pack(push, 4)
+struct TraceRecord
+{
+    uint64_t key;
+    uint32_t meta;        //op << 28 | value_size
+
+    TraceOp  op()         const { return (TraceOp)(meta >> TRACE_SIZE_BITS); }
+    uint32_t value_size() const { return meta & TRACE_SIZE_MASK; }
+};
+#pragma pack(pop)
+
+static_assert(sizeof(TraceRecord) == 12, "trace record must stay packed");
+
+inline TraceRecord make_record(TraceOp op, uint64_t key, uint32_t value_size = 0)
+{
+    if (value_size > TRACE_SIZE_MASK)
+        value_size = TRACE_SIZE_MASK;
+    return {key, ((uint32_t)op << TRACE_SIZE_BITS) | value_size};
+}
+
+inline bool check_header(const TraceHeader& head, uint64_t file_size)
+{
+    return memcmp(head.magic, "EMTRACE", 8) == 0 && head.version == TRACE_VERSION &&
+        head.record_size == sizeof(TraceRecord) && file_size >= sizeof(head) &&
+        head.count <= (file_size - sizeof(head)) / sizeof(TraceRecord); //no overflow for a corrupt count
+}
+
+/// buffered writer, the header count is patched in close()
+class TraceWriter
+{
+public:
+    explicit TraceWriter(const char* path, size_t buffer_records = 1 << 16)
+    {
+        _fp = fopen(path, "wb");
+        _count = 0;
+        _buffer.reserve(buffer_records);
+        if (_fp) {
+            const auto head = header(0);
+            fwrite(&head, sizeof(head), 1, _fp);
+        }
+    }
+
+    ~TraceWriter() { close(); }
+
+    //owns the FILE*, a copy would close it twice
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool good() const { return _fp != nullptr; }
+    uint64_t count() const { return _count + _buffer.size(); }
+
+    void add(TraceOp op, uint64_t key, uint32_t value_size = 0)
+    {
+        _buffer.emplace_back(make_record(op, key, value_size));
+        if (_buffer.size() == _buffer.capacity())
+            flush();
+    }
+
+    void flush()
+    {
+        if (_fp && !_buffer.empty())
+            fwrite(_buffer.data(), sizeof(TraceRecord), _buffer.size(), _fp);
+        _count += _buffer.size();
+        _buffer.clear();
+    }
+
+    void close()
+    {
+        if (!_fp)
+            return;
+        flush();
+        const auto head = header(_count);
+        fseek(_fp, 0, SEEK_SET);
+        fwrite(&head, sizeof(head), 1, _fp);
+        fclose(_fp);
+        _fp = nullptr;
+    }
+
+private:
+    static TraceHeader header(uint64_t count)
+    {
+        TraceHeader head;
+        memcpy(head.magic, "EMTRACE", 8);
+        head.version = TRACE_VERSION;
+        head.record_size = sizeof(TraceRecord);
+        head.count = count;
+        return head;
+    }
+
+    FILE* _fp;
+    uint64_t _count;
+    std::vector<TraceRecord> _buffer;
+};
+
+} // namespace emtrace
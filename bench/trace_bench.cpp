@@ -0,0 +1,336 @@
+// replay a captured operation trace (see trace.h) against one hash map selected at compile time.
+//
+// g++ -I.. -I../thirdparty -O3 -march=native -DEMH=8 trace_bench.cpp -o trace
+//   ./trace -g ops.trc 10000000 1000000 [skew]   generate a synthetic trace
+//   ./trace ops.trc [sample_every] [loops]       replay it and report ops/sec, latency, peak rss
+//
+// map selection: EMH=5/6/7/8, LRU=1(lru_size)/2(lru_time), MARTIN, DENSE, PHMAP, TSL, SKA, ABSL, BOOST
+// value type   : TVal=2 for std::string values sized by the record, otherwise uint64_t
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "trace.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/resource.h>
+#endif
+
+#if EMH == 5
+    #include "hash_table5.hpp"
+    #define MAPNAME emhash5::HashMap
+#elif EMH == 6
+    #include "hash_table6.hpp"
+    #define MAPNAME emhash6::HashMap
+#elif EMH == 7
+    #include "hash_table7.hpp"
+    #define MAPNAME emhash7::HashMap
+#elif LRU == 1
+    #include "lru_size.h"
+    #define MAPNAME emlru_size::lru_cache
+#elif LRU == 2
+    #include "lru_time.h"
+    #define MAPNAME emlru_time::lru_cache
+#elif MARTIN
+    #include "martinus/robin_hood.h"
+    #define MAPNAME robin_hood::unordered_flat_map
+#elif DENSE
+    #include "martinus/unordered_dense.h"
+    #define MAPNAME ankerl::unordered_dense::map
+#elif PHMAP
+    #include "phmap/phmap.h"
+    #define MAPNAME phmap::flat_hash_map
+#elif TSL
+    #include "tsl/robin_map.h"
+    #define MAPNAME tsl::robin_map
+#elif SKA
+    #include "ska/flat_hash_map.hpp"
+    #define MAPNAME ska::flat_hash_map
+#elif ABSL
+    #include "absl/container/flat_hash_map.h"
+    #include "absl/container/internal/raw_hash_set.cc"
+    #include "absl/hash/internal/low_level_hash.cc"
+    #include "absl/hash/internal/hash.cc"
+    #include "absl/hash/internal/city.cc"
+    #define MAPNAME absl::flat_hash_map
+#elif BOOST
+    #include <boost/unordered/unordered_flat_map.hpp>
+    #define MAPNAME boost::unordered_flat_map
+#else
+    #include "hash_table8.hpp"
+    #define MAPNAME emhash8::HashMap
+#endif
+
+#define STR_(x) #x
+#define STR(x)  STR_(x)
+
+using namespace emtrace;
+using KeyType = uint64_t;
+#if TVal == 2
+using ValType = std::string;
+#else
+using ValType = uint64_t;
+#endif
+
+using MapType = MAPNAME<KeyType, ValType>;
+using my_clock = std::chrono::steady_clock;
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(my_clock::now().time_since_epoch()).count();
+}
+
+static size_t peak_rss_kb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+    return pmc.PeakWorkingSetSize / 1024;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#if __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+#endif
+}
+
+static size_t current_rss_kb()
+{
+#if __linux__
+    long pages = 0, resident = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp) {
+        if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(fp);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+    return peak_rss_kb();
+#endif
+}
+
+/// read only view of a trace file, mmap when possible
+class TraceFile
+{
+public:
+    bool open(const char* path)
+    {
+#ifdef _WIN32
+        FILE* fp = fopen(path, "rb");
+        if (!fp)
+            return false;
+        fseek(fp, 0, SEEK_END);
+        _size = (uint64_t)ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        _copy.resize(_size);
+        if (_size != fread(&_copy[0], 1, _size, fp))
+            _size = 0;
+        fclose(fp);
+        _base = _copy.data();
+#else
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(TraceHeader)) {
+            ::close(fd);
+            return false;
+        }
+        _size = (uint64_t)st.st_size;
+        auto addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+            return false;
+        madvise(addr, _size, MADV_SEQUENTIAL);
+        _base = (const char*)addr;
+#endif
+        return _size >= sizeof(TraceHeader) && check_header(header(), _size);
+    }
+
+    ~TraceFile()
+    {
+#ifndef _WIN32
+        if (_base)
+            munmap((void*)_base, _size);
+#endif
+    }
+
+    const TraceHeader& header() const { return *(const TraceHeader*)_base; }
+    const TraceRecord* records() const { return (const TraceRecord*)(_base + sizeof(TraceHeader)); }
+    uint64_t count() const { return header().count; }
+    uint64_t bytes() const { return _size; }
+
+private:
+    const char* _base = nullptr;
+    uint64_t _size = 0;
+#ifdef _WIN32
+    std::vector<char> _copy;
+#endif
+};
+
+static std::string s_value_pool;
+
+static inline ValType make_value(const TraceRecord& rec)
+{
+#if TVal == 2
+    const auto vsize = std::min<size_t>(rec.value_size(), s_value_pool.size());
+    return ValType(s_value_pool.data(), vsize);
+#else
+    return (ValType)rec.key + rec.value_size();
+#endif
+}
+
+static inline uint64_t apply(MapType& map, const TraceRecord& rec)
+{
+    switch (rec.op()) {
+    case OP_FIND:
+        return map.find(rec.key) != map.end();
+    case OP_INSERT:
+        return map.emplace(rec.key, make_value(rec)).second;
+    case OP_ASSIGN:
+        map[rec.key] = make_value(rec);
+        return 1;
+    case OP_ERASE:
+        return map.erase(rec.key);
+    case OP_CLEAR:
+        map.clear();
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+static int generate(const char* path, uint64_t ops, uint64_t keys, double skew)
+{
+    TraceWriter writer(path);
+    if (!writer.good()) {
+        printf("can not create %s\n", path);
+        return -1;
+    }
+
+    std::mt19937_64 rng(ops ^ keys);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    //op mix: 60% find, 15% insert, 15% assign, 10% erase
+    for (uint64_t i = 0; i < ops; i++) {
+        const auto r = rng() % 100;
+        const auto op = r < 60 ? OP_FIND : (r < 75 ? OP_INSERT : (r < 90 ? OP_ASSIGN : OP_ERASE));
+        //power law skew: u^skew concentrates on small ranks when skew > 1
+        const auto rank = skew > 1.0 ? (uint64_t)(std::pow(uni(rng), skew) * keys) : rng() % keys;
+        const auto key  = rank * UINT64_C(0x9E3779B97F4A7C15);
+        writer.add(op, key, op == OP_INSERT || op == OP_ASSIGN ? (uint32_t)(8 + rng() % 56) : 0);
+    }
+    writer.close();
+    printf("write %s ops = %llu keys = %llu skew = %.2lf\n", path, (unsigned long long)ops, (unsigned long long)keys, skew);
+    return 0;
+}
+
+static int replay(const char* path, uint32_t sample_every, int loops)
+{
+    TraceFile trace;
+    if (!trace.open(path)) {
+        printf("invalid trace file %s\n", path);
+        return -1;
+    }
+
+    const auto* recs = trace.records();
+    const auto count = trace.count();
+    s_value_pool.assign(1 << 16, 'v');
+
+    //touch every page once so the trace mapping is not charged to the map
+    uint64_t op_count[OP_COUNT] = {0};
+    for (uint64_t i = 0; i < count; i++)
+        op_count[recs[i].op() < OP_COUNT ? recs[i].op() : 0] ++;
+
+    printf("map = %s, trace = %s records = %llu (%.1lf MB)\n", STR(MAPNAME), path,
+            (unsigned long long)count, trace.bytes() / 1048576.0);
+    for (int op = 0; op < OP_COUNT; op++)
+        printf("  %-6s %6.2lf%%\n", op_name[op], op_count[op] * 100.0 / (count + !count));
+
+    const auto base_rss = current_rss_kb();
+
+    //1. throughput, no per operation timer
+    uint64_t sum = 0;
+    double best_ns = 1e30;
+    size_t final_size = 0;
+    for (int l = 0; l < loops; l++) {
+        MapType map;
+        const auto start = now_ns();
+        for (uint64_t i = 0; i < count; i++)
+            sum += apply(map, recs[i]);
+        best_ns = std::min(best_ns, double(now_ns() - start));
+        final_size = map.size();
+    }
+    const auto peak_rss = peak_rss_kb();
+
+    //2. latency, time one of every sample_every operations
+    int64_t overhead = 1 << 30;
+    for (int i = 0; i < 1000; i++) {
+        const auto t0 = now_ns();
+        overhead = std::min(overhead, now_ns() - t0);
+    }
+
+    std::vector<uint32_t> lat;
+    lat.reserve(count / sample_every + 1);
+    {
+        MapType map;
+        for (uint64_t i = 0; i < count; i++) {
+            if (i % sample_every != 0) {
+                sum += apply(map, recs[i]);
+                continue;
+            }
+            const auto t0 = now_ns();
+            sum += apply(map, recs[i]);
+            const auto ns = now_ns() - t0 - overhead;
+            lat.emplace_back(ns > 0 ? (uint32_t)std::min<int64_t>(ns, UINT32_MAX) : 0);
+        }
+    }
+    std::sort(lat.begin(), lat.end());
+
+    auto pct = [&lat](double p) { return lat.empty() ? 0u : lat[std::min(lat.size() - 1, (size_t)(lat.size() * p))]; };
+    printf("\n  throughput  = %.2lf Mops/s (%.2lf ns/op, best of %d)\n", count * 1e3 / best_ns, best_ns / (count + !count), loops);
+    printf("  latency ns  = p50 %u, p90 %u, p99 %u, p99.9 %u, max %u (%zd samples, clock overhead %d ns)\n",
+            pct(0.50), pct(0.90), pct(0.99), pct(0.999), lat.empty() ? 0 : lat.back(), lat.size(), (int)overhead);
+    printf("  memory      = peak rss %.1lf MB, base rss %.1lf MB, map size %zd\n",
+            peak_rss / 1024.0, base_rss / 1024.0, final_size);
+    printf("  checksum    = %llu\n", (unsigned long long)sum);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2 && strcmp(argv[1], "-g") == 0) {
+        const uint64_t ops  = argc > 3 ? strtoull(argv[3], nullptr, 10) : 10000000;
+        const uint64_t keys = argc > 4 ? strtoull(argv[4], nullptr, 10) : ops / 10 + 1;
+        const double skew   = argc > 5 ? atof(argv[5]) : 1.0;
+        return generate(argv[2], ops, keys ? keys : 1, skew);
+    }
+
+    if (argc < 2) {
+        printf("usage: %s -g trace_file [ops] [keys] [skew]\n", argv[0]);
+        printf("       %s trace_file [sample_every] [loops]\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t sample_every = argc > 2 ? std::max(1, atoi(argv[2])) : 32;
+    const int loops = argc > 3 ? std::max(1, atoi(argv[3])) : 3;
+    return replay(argv[1], sample_every, loops);
+}
@@ -0,0 +1,390 @@
+// emhash8::BackgroundMap growth on a helper thread for C++11/14/17
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+// ingest without rehash stalls: a HashMap doubles inside the insert that crosses its max
+// load factor. a BackgroundMap starts the next generation earlier, at start_load, on a
+// helper thread it owns:
+//  - the full table is frozen (old) and the helper copies it into a table of twice the
+//    buckets. reading a frozen table from two threads is safe, nothing writes it.
+//  - meanwhile the owner writes into a small delta map: inserts, assignments (a key of
+//    old is copied up first) and tombstones for erased keys of old. lookups consult the
+//    delta, then old.
+//  - the first write after the helper is done swaps the new table in and replays the
+//    delta on it, then hands old to the helper to free. the owner pays for the keys
+//    written during the migration, never for the copy.
+// one owner thread calls everything, as with HashMap; the helper only touches the frozen
+// table and the one it builds. a migration costs one spare core and the memory of both.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "hash_table8.hpp"
+
+#ifndef EMH_BG_START
+    #define EMH_BG_START 0.5f  //load factor that starts the next generation
+#endif
+
+namespace emhash8 {
+
+/// counters of a BackgroundMap
+struct BackgroundStats
+{
+    uint64_t migrations;
+    uint64_t replayed;       //delta entries applied at the swaps
+    uint64_t max_swap_ns;    //longest swap + replay on the owner thread
+};
+
+template <typename KeyT, typename ValueT, typename HashT = Hash<KeyT>, typename EqT = EqualTo<KeyT>, typename PolicyT = DefaultPolicy>
+class BackgroundMap
+{
+    static_assert(std::is_default_constructible<ValueT>::value, "a tombstone in the delta holds ValueT()");
+
+public:
+    using map_type  = HashMap<KeyT, ValueT, HashT, EqT, PolicyT>;
+    using size_type = typename map_type::size_type;
+
+    /// start_load is clamped below the tables' max_load_factor(), which they never reach
+    explicit BackgroundMap(size_type bucket = 16, float start_load = EMH_BG_START)
+        : _cur(new map_type(bucket)), _old(nullptr), _size(0), _stats{}
+    {
+        _start = std::min(start_load, _cur->max_load_factor() * 0.95f);
+        _start_at = (uint64_t)(_cur->bucket_count() * _start);
+    }
+
+    BackgroundMap(const BackgroundMap&) = delete;
+    BackgroundMap& operator=(const BackgroundMap&) = delete;
+
+    ~BackgroundMap()
+    {
+        if (_helper.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _stop = true;
+            }
+            _wake.notify_one();
+            _helper.join();
+        }
+        delete _built;
+        delete _retired;
+        delete _old;
+        delete _cur;
+    }
+
+    size_type size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    bool migrating() const { return _old != nullptr; }
+    /// buckets of the current table, of the frozen one while migrating
+    size_type bucket_count() const { return _cur ? _cur->bucket_count() : _old->bucket_count(); }
+    const BackgroundStats& stats() const { return _stats; }
+
+    // ---------------- reads ----------------
+
+    bool try_get(const KeyT& key, ValueT& val) const
+    {
+        if (EMH_UNLIKELY(_old != nullptr)) {
+            const auto* d = _delta.try_get(key);
+            if (d) {
+                if (d->live)
+                    val = d->val;
+                return d->live;
+            }
+            return _old->try_get(key, val);
+        }
+        return _cur->try_get(key, val);
+    }
+
+    ValueT* try_get(const KeyT& key)
+    {
+        if (EMH_UNLIKELY(_old != nullptr)) {
+            auto* d = _delta.try_get(key);
+            if (d)
+                return d->live ? &d->val : nullptr;
+            //a pointer into the frozen table could be written through, copy the entry up
+            const auto* v = _old->try_get(key);
+            return v ? &_delta.try_emplace(key, Delta{*v, true}).first->second.val : nullptr;
+        }
+        return _cur->try_get(key);
+    }
+
+    bool contains(const KeyT& key) const
+    {
+        if (EMH_UNLIKELY(_old != nullptr)) {
+            const auto* d = _delta.try_get(key);
+            return d ? d->live : _old->contains(key);
+        }
+        return _cur->contains(key);
+    }
+
+    size_type count(const KeyT& key) const { return contains(key) ? 1 : 0; }
+
+    /// fn(key, value) for every entry
+    template<typename F>
+    void for_each(const F& fn) const
+    {
+        if (_old) {
+            for (const auto& kv : _delta)
+                if (kv.second.live)
+                    fn(kv.first, kv.second.val);
+            for (const auto& kv : *_old)
+                if (!_delta.contains(kv.first))
+                    fn(kv.first, kv.second);
+            return;
+        }
+        for (const auto& kv : *_cur)
+            fn(kv.first, kv.second);
+    }
+
+    // ---------------- writes ----------------
+
+    /// true when key was new
+    bool insert(const KeyT& key, const ValueT& val)
+    {
+        poll();
+        if (EMH_UNLIKELY(_old != nullptr)) {
+            auto* d = _delta.try_get(key);
+            if (d ? d->live : _old->contains(key))
+                return false;
+            if (d)
+                *d = Delta{val, true};
+            else
+                _delta.try_emplace(key, Delta{val, true});
+            _size ++;
+            return true;
+        }
+
+        const auto fresh = _cur->try_emplace(key, val).second;
+        _size += fresh;
+        check_start();
+        return fresh;
+    }
+
+    bool insert_or_assign(const KeyT& key, const ValueT& val)
+    {
+        const auto it = upsert(key);
+        *it.first = val;
+        return it.second;
+    }
+
+    /// like HashMap::operator[], during a migration a key of the frozen table is copied up
+    ValueT& operator[](const KeyT& key) { return *upsert(key).first; }
+
+    size_type erase(const KeyT& key)
+    {
+        poll();
+        if (EMH_UNLIKELY(_old != nullptr)) {
+            auto* d = _delta.try_get(key);
+            if (d && !d->live)
+                return 0;
+            const auto in_old = _old->contains(key);
+            if (!d && !in_old)
+                return 0;
+            if (d && !in_old)
+                _delta.erase(key);
+            else if (d)
+                *d = Delta{ValueT(), false};
+            else
+                _delta.try_emplace(key, Delta{ValueT(), false});
+            _size --;
+            return 1;
+        }
+
+        const auto n = _cur->erase(key);
+        _size -= n;
+        return n;
+    }
+
+    /// block until no migration runs
+    void wait()
+    {
+        while (_old) {
+            {
+                std::unique_lock<std::mutex> lock(_lock);
+                _done.wait(lock, [this] { return _built != nullptr; });
+            }
+            poll();
+        }
+    }
+
+    void clear()
+    {
+        wait();
+        _cur->clear();
+        _size = 0;
+    }
+
+private:
+    struct Delta
+    {
+        ValueT val;
+        bool   live;  //false: erased from the frozen table
+    };
+
+    //slot of key, inserted as ValueT() when missing; second: it was missing
+    std::pair<ValueT*, bool> upsert(const KeyT& key)
+    {
+        poll();
+        if (EMH_UNLIKELY(_old != nullptr)) {
+            auto* d = _delta.try_get(key);
+            bool fresh;
+            if (d) {
+                fresh = !d->live;
+                if (fresh)
+                    *d = Delta{ValueT(), true};
+            } else {
+                const auto* v = _old->try_get(key);
+                fresh = v == nullptr;
+                d = &_delta.try_emplace(key, Delta{v ? *v : ValueT(), true}).first->second;
+            }
+            _size += fresh;
+            return {&d->val, fresh};
+        }
+
+        const auto it = _cur->try_emplace(key, ValueT());
+        _size += it.second;
+        if (it.second && EMH_UNLIKELY(_size >= _start_at)) {
+            //the slot froze with the table: hand out its copy in the delta
+            check_start();
+            return {upsert(key).first, true};
+        }
+        return {&it.first->second, it.second};
+    }
+
+    void check_start()
+    {
+        if (EMH_LIKELY(_size < _start_at))
+            return;
+
+        if (!_helper.joinable())
+            _helper = std::thread([this] { run(); });
+        _old = _cur;
+        _cur = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _source = _old;
+        }
+        _wake.notify_one();
+        _stats.migrations ++;
+    }
+
+    //swap in a finished table: one atomic load when none is ready
+    void poll()
+    {
+        if (EMH_LIKELY(!_ready.load(std::memory_order_acquire)))
+            return;
+
+        const auto start = std::chrono::steady_clock::now();
+        map_type* built;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            built = _built;
+            _built = nullptr;
+            _ready.store(false, std::memory_order_relaxed);
+        }
+
+        for (auto& kv : _delta) {
+            if (kv.second.live)
+                built->insert_or_assign(kv.first, std::move(kv.second.val));
+            else
+                built->erase(kv.first);
+        }
+        _stats.replayed += _delta.size();
+        _delta.clear();  //keeps its buckets for the next migration
+
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _retired = _old;
+        }
+        _wake.notify_one();
+        _old = nullptr;
+        _cur = built;
+        _start_at = (uint64_t)(_cur->bucket_count() * _start);
+
+        const auto ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        if (ns > _stats.max_swap_ns)
+            _stats.max_swap_ns = ns;
+        check_start();
+    }
+
+    //helper thread: copy a frozen table into one of twice its buckets, free retired ones
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        while (true) {
+            _wake.wait(lock, [this] { return _stop || _source || _retired; });
+            if (_retired) {
+                auto* retired = _retired;
+                _retired = nullptr;
+                lock.unlock();
+                delete retired;
+                lock.lock();
+                continue;
+            }
+            if (_stop)
+                return;
+
+            const auto* source = _source;
+            _source = nullptr;
+            lock.unlock();
+
+            auto* built = new map_type();
+            built->rehash((uint64_t)source->bucket_count() * 2);
+            for (const auto& kv : *source)
+                built->insert_unique(kv.first, kv.second);
+
+            lock.lock();
+            _built = built;
+            _ready.store(true, std::memory_order_release);
+            _done.notify_all();
+        }
+    }
+
+    map_type*           _cur;      //takes writes, null while migrating
+    map_type*           _old;      //frozen while the helper copies it
+    HashMap<KeyT, Delta, HashT, EqT, PolicyT> _delta;
+    uint64_t            _size;
+    uint64_t            _start_at;
+    float               _start;
+    BackgroundStats     _stats;
+
+    std::thread             _helper;
+    std::mutex              _lock;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    const map_type*         _source  = nullptr;
+    map_type*               _built   = nullptr;
+    map_type*               _retired = nullptr;
+    std::atomic<bool>       _ready{false};
+    bool                    _stop    = false;
+};
+
+}
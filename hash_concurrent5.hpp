@@ -0,0 +1,535 @@
+// emhash5::ConcurrentMap/ConcurrentSet grow only tables shared by many writers for C++11/14/17
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+// insert only tables for many threads (dedup sets, interning): no erase, no overwrite.
+// the layout is emhash5's, every slot keeps its bucket word: INACTIVE when empty, the next
+// slot of its chain or itself at the tail. an insert into an empty main bucket is one CAS
+// on the bucket word (INACTIVE -> BUSY) then a release store of the link once the key is
+// written. otherwise the key walks its chain to the tail, claims an empty slot the same way
+// and CASes the tail's bucket word from itself to that slot.
+// a live entry can not be moved without a lock, so there is no kickout: a collided entry
+// stays where it landed and chains meeting in a slot merge (coalesced chaining). links
+// are only ever added at a tail, so every walk from a main bucket is a suffix of one list
+// and an entry, once linked, stays reachable from the bucket it was appended for.
+// growing freezes the table, waits for the writers still inside it and then every thread
+// that touches the table copies chunks of it into the new one before going on.
+// the old table is freed once the gates counted on both sides of a flipped epoch were
+// left, gates entered after the flip never hold it so steady readers do not delay that.
+// keys and values must be trivially copyable.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "hash_table5.hpp"
+
+#ifndef EMH_CONCURRENT_STRIPES
+    #define EMH_CONCURRENT_STRIPES 64
+#endif
+#ifndef EMH_CONCURRENT_CHUNK
+    #define EMH_CONCURRENT_CHUNK 4096
+#endif
+
+namespace emhash5 {
+
+template <typename KeyT, typename ValueT>
+struct concurrent_slot
+{
+    std::atomic<size_type> bucket;
+    KeyT   first;
+    ValueT second;
+
+    void assign(const concurrent_slot& rhs) { first = rhs.first; second = rhs.second; }
+};
+
+template <typename KeyT>
+struct concurrent_slot<KeyT, void>
+{
+    std::atomic<size_type> bucket;
+    KeyT first;
+
+    void assign(const concurrent_slot& rhs) { first = rhs.first; }
+};
+
+/// the shared part of ConcurrentMap and ConcurrentSet
+template <typename KeyT, typename ValueT, typename HashT, typename EqT>
+class ConcurrentTable
+{
+    static_assert(std::is_trivially_copyable<KeyT>::value, "concurrent tables copy keys with plain stores");
+    static_assert((EMH_CONCURRENT_STRIPES & (EMH_CONCURRENT_STRIPES - 1)) == 0, "EMH_CONCURRENT_STRIPES is a power of two");
+
+public:
+    using size_type = emhash5::size_type;
+
+protected:
+    using Slot = concurrent_slot<KeyT, ValueT>;
+
+    static constexpr size_type BUSY = INACTIVE - 1; //claimed, key not written yet
+    static constexpr uint64_t  WRITER = UINT64_C(1) << 32;
+    enum { OPEN, DRAINING, COPYING };
+    enum { EXISTS, INSERTED, FULL };
+
+    struct Table
+    {
+        Slot*     slots;
+        size_type mask;
+        size_type max_fill;
+        uint32_t  check_mask;    //how often a thread sums the fill counters
+        std::atomic<int>       state;
+        std::atomic<Table*>    next;
+        std::atomic<size_type> claim;  //chunks handed out while copying
+        std::atomic<size_type> done;
+    };
+
+    //one per thread (round robin): ops inside a table (low half) and writers (high half),
+    //counted apart for gates entered at an even and at an odd epoch
+    struct alignas(64) Stripe
+    {
+        std::atomic<uint64_t> active[2];
+        std::atomic<size_t>   filled;
+    };
+
+public:
+    using key_type  = KeyT;
+
+    explicit ConcurrentTable(size_type bucket = 16, float mlf = 0.75f)
+    {
+        _mlf = (mlf > 0.25f && mlf < 0.95f) ? mlf : 0.75f;
+        for (auto& s : _stripes) {
+            s.active[0].store(0, std::memory_order_relaxed);
+            s.active[1].store(0, std::memory_order_relaxed);
+            s.filled.store(0, std::memory_order_relaxed);
+        }
+        _table.store(new_table(bucket), std::memory_order_release);
+    }
+
+    ConcurrentTable(const ConcurrentTable&) = delete;
+    ConcurrentTable& operator=(const ConcurrentTable&) = delete;
+
+    ~ConcurrentTable() { free_table(_table.load(std::memory_order_relaxed)); }
+
+    bool contains(const KeyT& key) const
+    {
+        Gate gate(*this);
+        return find_slot(gate.table, key) != nullptr;
+    }
+
+    size_type count(const KeyT& key) const { return contains(key) ? 1 : 0; }
+
+    /// entries inserted before the call, exact once the writers stopped
+    size_type size() const
+    {
+        size_t sum = 0;
+        for (const auto& s : _stripes)
+            sum += s.filled.load(std::memory_order_relaxed);
+        return (size_type)sum;
+    }
+
+    bool empty() const { return size() == 0; }
+    size_type bucket_count() const { return _table.load(std::memory_order_acquire)->mask + 1; }
+    float max_load_factor() const { return _mlf; }
+
+    /// tables replaced by growth
+    size_type resize_count() const { return _resizes.load(std::memory_order_relaxed); }
+
+    /// not thread safe: no other thread may use the table meanwhile
+    void clear()
+    {
+        free_table(_table.load(std::memory_order_relaxed));
+        for (auto& s : _stripes)
+            s.filled.store(0, std::memory_order_relaxed);
+        _table.store(new_table(16), std::memory_order_release);
+    }
+
+    /// not thread safe: size the table for num_elems before sharing it
+    void reserve(size_type num_elems)
+    {
+        auto* table = _table.load(std::memory_order_relaxed);
+        if (num_elems < table->max_fill)
+            return;
+        auto* next = new_table((size_type)(num_elems / _mlf) + 2);
+        for (size_type i = 0; i <= table->mask; i++)
+            copy_slot(next, table->slots[i]);
+        free_table(table);
+        _table.store(next, std::memory_order_release);
+    }
+
+protected:
+    //holds a table pointer: the table is not freed before the gate is left
+    //a writer gate also keeps growth from copying the table until it is left or demoted
+    struct Gate
+    {
+        explicit Gate(const ConcurrentTable& map, uint64_t weight = 1) : stripe(map.stripe()), weight(weight)
+        {
+            epoch = map._epoch.load(std::memory_order_seq_cst) & 1;
+            stripe.active[epoch].fetch_add(weight, std::memory_order_seq_cst);
+            table = map._table.load(std::memory_order_seq_cst);
+        }
+        ~Gate() { stripe.active[epoch].fetch_sub(weight, std::memory_order_release); }
+
+        void demote()
+        {
+            stripe.active[epoch].fetch_sub(WRITER, std::memory_order_release);
+            weight = 1;
+        }
+
+        Stripe&  stripe;
+        Table*   table;
+        uint64_t weight;
+        uint32_t epoch;
+    };
+
+    Stripe& stripe() const
+    {
+        static std::atomic<uint32_t> threads{0};
+        static thread_local uint32_t index = threads.fetch_add(1, std::memory_order_relaxed);
+        return _stripes[index & (EMH_CONCURRENT_STRIPES - 1)];
+    }
+
+    const Slot* find_slot(const Table* table, const KeyT& key) const
+    {
+        auto cur = (size_type)hash_key(key) & table->mask;
+        while (true) {
+            const auto& slot = table->slots[cur];
+            const auto next = slot.bucket.load(std::memory_order_acquire);
+            if (next >= BUSY)
+                return nullptr; //empty, or an insert not finished yet
+            else if (_eq(key, slot.first))
+                return &slot;
+            else if (next == cur)
+                return nullptr;
+            cur = next;
+        }
+    }
+
+    /// fill(slot) writes key and value into a claimed slot. false when key was already in.
+    template<typename F>
+    bool insert_key(const KeyT& key, F fill)
+    {
+        const auto hash = (size_type)hash_key(key);
+        while (true) {
+            Table* retired = nullptr;
+            int result = FULL;
+            {
+                Gate gate(*this, WRITER + 1);
+                auto* table = gate.table;
+                if (EMH_LIKELY(table->state.load(std::memory_order_seq_cst) == OPEN))
+                    result = insert_into<false>(table, key, hash, fill, 1024);
+
+                if (result == INSERTED) {
+                    const auto filled = gate.stripe.filled.fetch_add(1, std::memory_order_relaxed) + 1;
+                    if ((filled & table->check_mask) == 0 && size() >= table->max_fill) {
+                        gate.demote();
+                        retired = grow(table);
+                    }
+                } else if (result == FULL) {
+                    gate.demote();
+                    retired = grow(table);
+                }
+            }
+            if (retired)
+                reclaim(retired);
+            if (result != FULL)
+                return result == INSERTED;
+        }
+    }
+
+    //walk the chain of key to its tail. Unique skips the key compare (copying while growing).
+    template<bool Unique, typename F>
+    int insert_into(Table* table, const KeyT& key, size_type hash, F& fill, size_type max_probe)
+    {
+        auto* slots = table->slots;
+        auto cur = hash & table->mask;
+        auto empty = INACTIVE;
+        for (uint32_t spin = 0; ; ) {
+            auto& slot = slots[cur];
+            auto next = slot.bucket.load(std::memory_order_acquire);
+            if (next == INACTIVE && empty == INACTIVE) {
+                if (slot.bucket.compare_exchange_strong(next, BUSY, std::memory_order_acquire)) {
+                    fill(slot);
+                    slot.bucket.store(cur, std::memory_order_release);
+                    return INSERTED;
+                }
+            }
+            if (next == BUSY) {
+                backoff(spin++);
+                continue;
+            } else if (next == INACTIVE)
+                continue; //our own claimed slot at the main bucket can not happen, reload
+            else if (!Unique && _eq(key, slot.first)) {
+                if (empty != INACTIVE)
+                    slots[empty].bucket.store(INACTIVE, std::memory_order_release);
+                return EXISTS;
+            } else if (next != cur) {
+                cur = next;
+                continue;
+            }
+
+            //at the tail: claim an empty slot once, then try to link it
+            if (empty == INACTIVE) {
+                empty = claim_empty(table, cur, max_probe);
+                if (empty == INACTIVE)
+                    return FULL;
+                fill(slots[empty]);
+            }
+            if (slot.bucket.compare_exchange_strong(next, empty, std::memory_order_acq_rel)) {
+                slots[empty].bucket.store(empty, std::memory_order_release);
+                return INSERTED;
+            }
+            //somebody else appended, look at what they linked
+        }
+    }
+
+    size_type claim_empty(Table* table, size_type from, size_type max_probe)
+    {
+        const auto mask = table->mask;
+        for (size_type i = 1; i <= max_probe && i <= mask; i++) {
+            auto& slot = table->slots[(from + i) & mask];
+            auto state = slot.bucket.load(std::memory_order_relaxed);
+            if (state == INACTIVE && slot.bucket.compare_exchange_strong(state, BUSY, std::memory_order_acquire))
+                return (from + i) & mask;
+        }
+        return INACTIVE;
+    }
+
+    static void backoff(uint32_t spin)
+    {
+        if (spin > 64)
+            std::this_thread::yield();
+    }
+
+    //called inside a gate. the thread that flips the table to DRAINING allocates the next
+    //one and waits for the writers, then everybody copies chunks. returns the old table
+    //to the thread that finished the copy, it frees it after leaving the gate.
+    Table* grow(Table* table)
+    {
+        auto state = (int)OPEN;
+        if (table->state.compare_exchange_strong(state, DRAINING, std::memory_order_seq_cst)) {
+            auto buckets = (uint64_t)(table->mask + 1) * 2;
+            while (buckets * _mlf < size() + 2)
+                buckets *= 2;
+            table->next.store(new_table((size_type)buckets), std::memory_order_release);
+            for (auto& s : _stripes) {
+                for (uint32_t spin = 0; s.active[0].load(std::memory_order_seq_cst) >= WRITER
+                        || s.active[1].load(std::memory_order_seq_cst) >= WRITER; )
+                    backoff(spin++);
+            }
+            table->state.store(COPYING, std::memory_order_release);
+        }
+        return help_copy(table);
+    }
+
+    Table* help_copy(Table* table)
+    {
+        for (uint32_t spin = 0; table->state.load(std::memory_order_acquire) != COPYING; )
+            backoff(spin++);
+
+        auto* next = table->next.load(std::memory_order_acquire);
+        const auto chunks = (table->mask + EMH_CONCURRENT_CHUNK) / EMH_CONCURRENT_CHUNK;
+        while (true) {
+            const auto chunk = table->claim.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= chunks)
+                break;
+            const auto first = (uint64_t)chunk * EMH_CONCURRENT_CHUNK;
+            const auto last = std::min<uint64_t>(first + EMH_CONCURRENT_CHUNK, (uint64_t)table->mask + 1);
+            for (auto i = first; i < last; i++)
+                copy_slot(next, table->slots[i]);
+            if (table->done.fetch_add(1, std::memory_order_acq_rel) + 1 == chunks) {
+                _table.store(next, std::memory_order_seq_cst);
+                _resizes.fetch_add(1, std::memory_order_relaxed);
+                return table;
+            }
+        }
+
+        for (uint32_t spin = 0; _table.load(std::memory_order_acquire) == table; )
+            backoff(spin++);
+        return nullptr;
+    }
+
+    void copy_slot(Table* next, const Slot& slot)
+    {
+        if (slot.bucket.load(std::memory_order_relaxed) >= BUSY)
+            return;
+        auto fill = [&slot](Slot& dst) { dst.assign(slot); };
+        insert_into<true>(next, slot.first, (size_type)hash_key(slot.first), fill, next->mask);
+    }
+
+    //a gate holding the old table was entered before the new one was published, so it is
+    //counted in one parity of its stripe until it is left. each flip of the epoch sends new
+    //gates to the other parity and the old one is waited for while only earlier gates drain
+    //from it. two flips see both parities idle, nobody can hold the old table after that.
+    void reclaim(Table* table)
+    {
+        std::lock_guard<std::mutex> lock(_reclaim);
+        for (int flip = 0; flip < 2; flip++) {
+            const auto old = _epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+            for (auto& s : _stripes) {
+                for (uint32_t spin = 0; s.active[old].load(std::memory_order_seq_cst) != 0; )
+                    backoff(spin++);
+            }
+        }
+        free_table(table);
+    }
+
+    Table* new_table(size_type buckets) const
+    {
+        size_type num = 16;
+        while (num < buckets)
+            num *= 2;
+
+        auto* table = new Table;
+        table->slots = (Slot*)malloc((size_t)num * sizeof(Slot));
+        if (!table->slots) {
+            delete table;
+            throw std::bad_alloc();
+        }
+        memset((void*)table->slots, 0xFF, (size_t)num * sizeof(Slot)); //bucket = INACTIVE
+        table->mask     = num - 1;
+        table->max_fill = (size_type)(num * _mlf);
+        //a thread checks the total every check_mask + 1 inserts, keep the overshoot of all
+        //stripes within half the free slots
+        uint32_t every = 1;
+        while (every < 64 && (uint64_t)every * 2 * EMH_CONCURRENT_STRIPES * 2 <= num - table->max_fill)
+            every *= 2;
+        table->check_mask = every - 1;
+        table->state.store(OPEN, std::memory_order_relaxed);
+        table->next.store(nullptr, std::memory_order_relaxed);
+        table->claim.store(0, std::memory_order_relaxed);
+        table->done.store(0, std::memory_order_relaxed);
+        return table;
+    }
+
+    static void free_table(Table* table)
+    {
+        free(table->slots);
+        delete table;
+    }
+
+    template<typename UType, typename std::enable_if<std::is_integral<UType>::value, size_type>::type = 0>
+    inline uint64_t hash_key(const UType key) const
+    {
+#if EMH_INT_HASH
+        return HashMap<KeyT, int, HashT, EqT>::hash64(key);
+#else
+        return (uint64_t)_hasher(key);
+#endif
+    }
+
+    template<typename UType, typename std::enable_if<!std::is_integral<UType>::value, size_type>::type = 0>
+    inline uint64_t hash_key(const UType& key) const
+    {
+        return (uint64_t)_hasher(key);
+    }
+
+    std::atomic<Table*>     _table;
+    mutable Stripe          _stripes[EMH_CONCURRENT_STRIPES];
+    std::atomic<size_type>  _resizes{0};
+    std::atomic<uint32_t>   _epoch{0};
+    std::mutex              _reclaim; //one epoch flipper at a time
+    float                   _mlf;
+    HashT                   _hasher;
+    EqT                     _eq;
+};
+
+/// many threads insert and look up at once, no erase
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>, typename EqT = std::equal_to<KeyT>>
+class ConcurrentMap : public ConcurrentTable<KeyT, ValueT, HashT, EqT>
+{
+    static_assert(std::is_trivially_copyable<ValueT>::value, "concurrent tables copy values with plain stores");
+    using Base = ConcurrentTable<KeyT, ValueT, HashT, EqT>;
+    using typename Base::Slot;
+
+public:
+    using mapped_type = ValueT;
+    using Base::Base;
+
+    /// false and no change when key exists, the first value stays
+    bool insert(const KeyT& key, const ValueT& val)
+    {
+        return this->insert_key(key, [&](Slot& slot) { slot.first = key; slot.second = val; });
+    }
+
+    bool find(const KeyT& key, ValueT& val) const
+    {
+        typename Base::Gate gate(*this);
+        const auto* slot = this->find_slot(gate.table, key);
+        if (slot)
+            val = slot->second;
+        return slot != nullptr;
+    }
+
+    /// sees every entry inserted before the call
+    template<typename F>
+    void for_each(F f) const
+    {
+        typename Base::Gate gate(*this);
+        const auto* table = gate.table;
+        for (size_type i = 0; i <= table->mask; i++) {
+            const auto& slot = table->slots[i];
+            if (slot.bucket.load(std::memory_order_acquire) < Base::BUSY)
+                f(slot.first, slot.second);
+        }
+    }
+};
+
+/// many threads insert and look up at once, no erase
+template <typename KeyT, typename HashT = std::hash<KeyT>, typename EqT = std::equal_to<KeyT>>
+class ConcurrentSet : public ConcurrentTable<KeyT, void, HashT, EqT>
+{
+    using Base = ConcurrentTable<KeyT, void, HashT, EqT>;
+    using typename Base::Slot;
+
+public:
+    using Base::Base;
+
+    /// true when key was new
+    bool insert(const KeyT& key)
+    {
+        return this->insert_key(key, [&](Slot& slot) { slot.first = key; });
+    }
+
+    template<typename F>
+    void for_each(F f) const
+    {
+        typename Base::Gate gate(*this);
+        const auto* table = gate.table;
+        for (size_type i = 0; i <= table->mask; i++) {
+            const auto& slot = table->slots[i];
+            if (slot.bucket.load(std::memory_order_acquire) < Base::BUSY)
+                f(slot.first);
+        }
+    }
+};
+
+}
@@ -0,0 +1,680 @@
+#pragma once
+// runtime cpu dispatch for the vectorizable emhash kernels
+// https://github.com/ktprime/emhash
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// the hash tables are built for the baseline isa (x86-64 = sse2) and pick
+// sse2/avx2/avx512 kernels once at startup, so one binary runs everywhere.
+// a table opts in with -DEMH_CPU_DISPATCH=1, otherwise it stays a single header.
+// kernels: bitmask scanning (scan_ne) and batch integer hashing (hash_keys).
+// FixedHash/FixedEqual serve keys of at most 32 bytes with unrolled loads and sse/avx compares,
+// emhash8 always includes this header for them: its default byte key hash must not depend on
+// whether the kernels are dispatched.
+//
+// export EMH_CPU=scalar|sse2|avx2|avx512 caps the level (testing, old kernels).
+//
+// HwHash is a hasher for any emhash table: aes-ni rounds for strings in
+// [EMH_AES_MIN, EMH_AES_MAX] bytes, crc32c for integers, aes for 128 bit keys and
+// a wyhash style fallback elsewhere. values depend on the cpu, never persist them.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#if __cplusplus >= 201703L || _MSVC_LANG >= 201703L
+    #include <string_view>
+#endif
+
+//aes-ni beats the wyhash multiply chain from about 96-128 bytes on recent x86
+#ifndef EMH_AES_MIN
+    #define EMH_AES_MIN 128
+#endif
+#ifndef EMH_AES_MAX
+    #define EMH_AES_MAX SIZE_MAX
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define EMH_CPU_X64 1
+    #include <immintrin.h>
+    #if _MSC_VER
+    #include <intrin.h>
+    #endif
+#else
+    #define EMH_CPU_X64 0
+#endif
+
+#if EMH_CPU_X64 && (defined(__GNUC__) || defined(__clang__))
+    #define EMH_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define EMH_TARGET(isa)
+#endif
+
+namespace emcpu {
+
+enum Level
+{
+    SCALAR = 0,
+    SSE2   = 1,
+    AVX2   = 2,
+    AVX512 = 3, //f + bw + vl
+};
+
+inline const char* level_name(int level)
+{
+    static const char* const names[] = {"scalar", "sse2", "avx2", "avx512"};
+    return level >= SCALAR && level <= AVX512 ? names[level] : "unknown";
+}
+
+inline int detect()
+{
+    int level = SCALAR;
+#if EMH_CPU_X64
+    level = SSE2;
+    #if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    //also checks the os saves ymm/zmm state (xgetbv)
+    if (__builtin_cpu_supports("avx2"))
+        level = AVX2;
+    if (level == AVX2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))
+        level = AVX512;
+    #elif _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    const int max_id = regs[0];
+    __cpuid(regs, 1);
+    const bool osxsave = (regs[2] >> 27) & 1;
+    const auto xcr0 = osxsave ? _xgetbv(0) : 0;
+    if (max_id >= 7 && (xcr0 & 0x6) == 0x6) {
+        __cpuidex(regs, 7, 0);
+        if ((regs[1] >> 5) & 1)
+            level = AVX2;
+        //f(16) bw(30) vl(31)
+        if (level == AVX2 && (xcr0 & 0xE0) == 0xE0 && ((regs[1] >> 16) & 1) && ((regs[1] >> 30) & 1) && ((regs[1] >> 31) & 1))
+            level = AVX512;
+    }
+    #endif
+#endif
+
+    if (const char* cap = getenv("EMH_CPU")) {
+        for (int l = SCALAR; l <= AVX512; l++) {
+            if (strcmp(cap, level_name(l)) == 0 && l < level)
+                level = l;
+        }
+    }
+    return level;
+}
+
+/// detected once, thread safe static init
+inline int level()
+{
+    static const int cpu_level = detect();
+    return cpu_level;
+}
+
+/// aes-ni + sse4.2 (crc32c), independent of the simd level
+inline bool has_aes()
+{
+    static const bool aes = []() {
+        bool ok = false;
+#if EMH_CPU_X64
+    #if defined(__GNUC__) || defined(__clang__)
+        __builtin_cpu_init();
+        ok = __builtin_cpu_supports("aes") && __builtin_cpu_supports("sse4.2");
+    #elif _MSC_VER
+        int regs[4];
+        __cpuid(regs, 1);
+        ok = ((regs[2] >> 25) & 1) && ((regs[2] >> 20) & 1);
+    #endif
+#endif
+        const char* cap = getenv("EMH_CPU");
+        return ok && !(cap && strcmp(cap, "scalar") == 0);
+    }();
+    return aes;
+}
+
+/// index of the first word in [0, n) not equal to value, n if there is none
+inline size_t scan_ne_scalar(const size_t* words, size_t n, size_t value)
+{
+    size_t i = 0;
+    while (i < n && words[i] == value)
+        i++;
+    return i;
+}
+
+#if EMH_CPU_X64
+EMH_TARGET("sse2")
+inline size_t scan_ne_sse2(const size_t* words, size_t n, size_t value)
+{
+    //32 bit lanes are enough to detect a 64 bit mismatch
+    const auto v = _mm_set1_epi64x((long long)value);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const auto eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(words + i)), v);
+        if (_mm_movemask_epi8(eq) != 0xFFFF)
+            break;
+    }
+    return i + scan_ne_scalar(words + i, n - i, value);
+}
+
+EMH_TARGET("avx2")
+inline size_t scan_ne_avx2(const size_t* words, size_t n, size_t value)
+{
+    const auto v = _mm256_set1_epi64x((long long)value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const auto e0 = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(words + i + 0)), v);
+        const auto e1 = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(words + i + 4)), v);
+        if (_mm256_movemask_epi8(_mm256_and_si256(e0, e1)) != -1)
+            break;
+    }
+    for (; i + 4 <= n; i += 4) {
+        const auto eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(words + i)), v);
+        if (_mm256_movemask_epi8(eq) != -1)
+            break;
+    }
+    return i + scan_ne_scalar(words + i, n - i, value);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+EMH_TARGET("avx512f,avx512bw,avx512vl")
+inline size_t scan_ne_avx512(const size_t* words, size_t n, size_t value)
+{
+    const auto v = _mm512_set1_epi64((long long)value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const auto ne = _mm512_cmpneq_epu64_mask(_mm512_loadu_si512((const void*)(words + i)), v);
+        if (ne != 0)
+            return i + __builtin_ctz((unsigned)ne);
+    }
+    if (i < n) {
+        //masked tail, never touches memory past words + n
+        const auto tail = (__mmask8)((1u << (n - i)) - 1);
+        const auto ne = _mm512_mask_cmpneq_epu64_mask(tail, _mm512_maskz_loadu_epi64(tail, words + i), v);
+        return ne ? i + __builtin_ctz((unsigned)ne) : n;
+    }
+    return n;
+}
+#endif
+#endif
+
+typedef size_t (*scan_ne_fn)(const size_t* words, size_t n, size_t value);
+
+inline scan_ne_fn select_scan_ne(int level)
+{
+#if EMH_CPU_X64
+    #if defined(__GNUC__) || defined(__clang__)
+    if (level >= AVX512)
+        return scan_ne_avx512;
+    #endif
+    if (level >= AVX2)
+        return scan_ne_avx2;
+    if (level >= SSE2)
+        return scan_ne_sse2;
+#endif
+    (void)level;
+    return scan_ne_scalar;
+}
+
+/// bitmask scanning of emhash7/emhash9: skip a run of all empty (or all full) words
+inline size_t scan_ne(const size_t* words, size_t n, size_t value)
+{
+    static const scan_ne_fn fn = select_scan_ne(level());
+    return fn(words, n, value);
+}
+
+/// scalar twins of the emhash hash64() integer mixers:
+/// 1 fibonacci 128 bit mul, 2 murmur3 mixer, 3 ror mix, other splitmix64
+template<int MIX>
+inline uint64_t hash64(uint64_t key)
+{
+    if (MIX == 1) {
+#if __SIZEOF_INT128__
+        __uint128_t r = key; r *= UINT64_C(11400714819323198485);
+        return (uint64_t)(r >> 64) + (uint64_t)r;
+#elif _WIN64
+        uint64_t high;
+        return _umul128(key, UINT64_C(11400714819323198485), &high) + high;
+#else
+        uint64_t r = key * UINT64_C(0xca4bcaa75ec3f625);
+        return (r >> 32) + r;
+#endif
+    } else if (MIX == 2) {
+        uint64_t h = key;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccd;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53;
+        h ^= h >> 33;
+        return h;
+    } else if (MIX == 3) {
+        auto ror = (key >> 32) | (key << 32);
+        return key * 0xA24BAED4963EE407ull + ror * 0x9FB21C651E98DF25ull;
+    }
+    uint64_t x = key;
+    x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return x ^ (x >> 31);
+}
+
+template<int MIX, typename K>
+inline void hash_keys_scalar(const K* in, uint64_t* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = hash64<MIX>((uint64_t)in[i]);
+}
+
+#if EMH_CPU_X64 && (defined(__GNUC__) || defined(__clang__))
+//avx2 and avx512f have no 64x64 bit multiply, both build it from 32x32 mul_epu32.
+//keys widen to 64 bit lanes the way (uint64_t)key does: sign extend signed 32 bit keys.
+EMH_TARGET("avx2")
+inline __m256i mullo64_avx2(__m256i a, __m256i b)
+{
+    const auto cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+template<int MIX>
+EMH_TARGET("avx2")
+inline __m256i mix_avx2(__m256i x)
+{
+    if (MIX == 1) {
+        //hi + lo of the 128 bit product from four partial products
+        const auto m32 = _mm256_set1_epi64x(0xFFFFFFFFll);
+        const auto bl  = _mm256_set1_epi64x((long long)(UINT64_C(11400714819323198485) & 0xFFFFFFFF));
+        const auto bh  = _mm256_set1_epi64x((long long)(UINT64_C(11400714819323198485) >> 32));
+        const auto xh  = _mm256_srli_epi64(x, 32);
+        const auto ll  = _mm256_mul_epu32(x, bl), lh = _mm256_mul_epu32(x, bh);
+        const auto hl  = _mm256_mul_epu32(xh, bl), hh = _mm256_mul_epu32(xh, bh);
+        const auto mid = _mm256_add_epi64(_mm256_add_epi64(_mm256_srli_epi64(ll, 32), _mm256_and_si256(lh, m32)), _mm256_and_si256(hl, m32));
+        const auto lo  = _mm256_or_si256(_mm256_and_si256(ll, m32), _mm256_slli_epi64(mid, 32));
+        const auto hi  = _mm256_add_epi64(_mm256_add_epi64(hh, _mm256_srli_epi64(lh, 32)), _mm256_add_epi64(_mm256_srli_epi64(hl, 32), _mm256_srli_epi64(mid, 32)));
+        return _mm256_add_epi64(hi, lo);
+    } else if (MIX == 2) {
+        x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+        x = mullo64_avx2(x, _mm256_set1_epi64x((long long)0xff51afd7ed558ccdull));
+        x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+        x = mullo64_avx2(x, _mm256_set1_epi64x((long long)0xc4ceb9fe1a85ec53ull));
+        return _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+    } else if (MIX == 3) {
+        const auto ror = _mm256_shuffle_epi32(x, 0xB1);
+        return _mm256_add_epi64(mullo64_avx2(x, _mm256_set1_epi64x((long long)0xA24BAED4963EE407ull)),
+                                mullo64_avx2(ror, _mm256_set1_epi64x((long long)0x9FB21C651E98DF25ull)));
+    }
+    x = mullo64_avx2(_mm256_xor_si256(x, _mm256_srli_epi64(x, 30)), _mm256_set1_epi64x((long long)0xbf58476d1ce4e5b9ull));
+    x = mullo64_avx2(_mm256_xor_si256(x, _mm256_srli_epi64(x, 27)), _mm256_set1_epi64x((long long)0x94d049bb133111ebull));
+    return _mm256_xor_si256(x, _mm256_srli_epi64(x, 31));
+}
+
+template<typename K>
+EMH_TARGET("avx2")
+inline __m256i load4_avx2(const K* p)
+{
+    if (sizeof(K) == 8)
+        return _mm256_loadu_si256((const __m256i*)p);
+    const auto v = _mm_loadu_si128((const __m128i*)p);
+    return std::is_signed<K>::value ? _mm256_cvtepi32_epi64(v) : _mm256_cvtepu32_epi64(v);
+}
+
+template<int MIX, typename K>
+EMH_TARGET("avx2")
+inline void hash_keys_avx2(const K* in, uint64_t* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_si256((__m256i*)(out + i), mix_avx2<MIX>(load4_avx2(in + i)));
+    hash_keys_scalar<MIX>(in + i, out + i, n - i);
+}
+
+EMH_TARGET("avx512f")
+inline __m512i mullo64_avx512(__m512i a, __m512i b)
+{
+    const auto cross = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(a, 32), b), _mm512_mul_epu32(a, _mm512_srli_epi64(b, 32)));
+    return _mm512_add_epi64(_mm512_mul_epu32(a, b), _mm512_slli_epi64(cross, 32));
+}
+
+template<int MIX>
+EMH_TARGET("avx512f")
+inline __m512i mix_avx512(__m512i x)
+{
+    if (MIX == 1) {
+        const auto m32 = _mm512_set1_epi64(0xFFFFFFFFll);
+        const auto bl  = _mm512_set1_epi64((long long)(UINT64_C(11400714819323198485) & 0xFFFFFFFF));
+        const auto bh  = _mm512_set1_epi64((long long)(UINT64_C(11400714819323198485) >> 32));
+        const auto xh  = _mm512_srli_epi64(x, 32);
+        const auto ll  = _mm512_mul_epu32(x, bl), lh = _mm512_mul_epu32(x, bh);
+        const auto hl  = _mm512_mul_epu32(xh, bl), hh = _mm512_mul_epu32(xh, bh);
+        const auto mid = _mm512_add_epi64(_mm512_add_epi64(_mm512_srli_epi64(ll, 32), _mm512_and_si512(lh, m32)), _mm512_and_si512(hl, m32));
+        const auto lo  = _mm512_or_si512(_mm512_and_si512(ll, m32), _mm512_slli_epi64(mid, 32));
+        const auto hi  = _mm512_add_epi64(_mm512_add_epi64(hh, _mm512_srli_epi64(lh, 32)), _mm512_add_epi64(_mm512_srli_epi64(hl, 32), _mm512_srli_epi64(mid, 32)));
+        return _mm512_add_epi64(hi, lo);
+    } else if (MIX == 2) {
+        x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 33));
+        x = mullo64_avx512(x, _mm512_set1_epi64((long long)0xff51afd7ed558ccdull));
+        x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 33));
+        x = mullo64_avx512(x, _mm512_set1_epi64((long long)0xc4ceb9fe1a85ec53ull));
+        return _mm512_xor_si512(x, _mm512_srli_epi64(x, 33));
+    } else if (MIX == 3) {
+        const auto ror = _mm512_shuffle_epi32(x, (_MM_PERM_ENUM)0xB1);
+        return _mm512_add_epi64(mullo64_avx512(x, _mm512_set1_epi64((long long)0xA24BAED4963EE407ull)),
+                                mullo64_avx512(ror, _mm512_set1_epi64((long long)0x9FB21C651E98DF25ull)));
+    }
+    x = mullo64_avx512(_mm512_xor_si512(x, _mm512_srli_epi64(x, 30)), _mm512_set1_epi64((long long)0xbf58476d1ce4e5b9ull));
+    x = mullo64_avx512(_mm512_xor_si512(x, _mm512_srli_epi64(x, 27)), _mm512_set1_epi64((long long)0x94d049bb133111ebull));
+    return _mm512_xor_si512(x, _mm512_srli_epi64(x, 31));
+}
+
+template<typename K>
+EMH_TARGET("avx512f")
+inline __m512i load8_avx512(const K* p)
+{
+    if (sizeof(K) == 8)
+        return _mm512_loadu_si512((const void*)p);
+    const auto v = _mm256_loadu_si256((const __m256i*)p);
+    return std::is_signed<K>::value ? _mm512_cvtepi32_epi64(v) : _mm512_cvtepu32_epi64(v);
+}
+
+template<int MIX, typename K>
+EMH_TARGET("avx512f")
+inline void hash_keys_avx512(const K* in, uint64_t* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm512_storeu_si512((void*)(out + i), mix_avx512<MIX>(load8_avx512(in + i)));
+    hash_keys_scalar<MIX>(in + i, out + i, n - i);
+}
+#endif
+
+template<int MIX, typename K>
+inline void (*select_hash_keys(int level, std::true_type))(const K*, uint64_t*, size_t)
+{
+#if EMH_CPU_X64 && (defined(__GNUC__) || defined(__clang__))
+    if (level >= AVX512)
+        return hash_keys_avx512<MIX, K>;
+    if (level >= AVX2)
+        return hash_keys_avx2<MIX, K>;
+#endif
+    (void)level;
+    return hash_keys_scalar<MIX, K>;
+}
+
+//8 and 16 bit keys, nothing to vectorize
+template<int MIX, typename K>
+inline void (*select_hash_keys(int, std::false_type))(const K*, uint64_t*, size_t)
+{
+    return hash_keys_scalar<MIX, K>;
+}
+
+/// out[i] = hash64<MIX>(in[i]) for 32/64 bit integer keys, 4 (avx2) or 8 (avx512) keys per step.
+/// bit identical to the scalar mixers, emhash5-8 hash_keys() forward here with their EMH_INT_HASH.
+template<int MIX, typename K>
+inline void hash_keys(const K* in, uint64_t* out, size_t n)
+{
+    static_assert(std::is_integral<K>::value || std::is_enum<K>::value, "integer keys only");
+    typedef void (*hash_keys_fn)(const K*, uint64_t*, size_t);
+    static const hash_keys_fn fn = select_hash_keys<MIX, K>(level(),
+            std::integral_constant<bool, sizeof(K) == 4 || sizeof(K) == 8>());
+    fn(in, out, n);
+}
+
+//portable fallback, wyhash final version
+inline uint64_t mum(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = a; r *= b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t hi, lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32); c += lo < t;
+    return lo ^ (rh + (rm0 >> 32) + (rm1 >> 32) + c);
+#endif
+}
+
+inline uint64_t read8(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+inline uint64_t read4(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+static constexpr uint64_t wysecret[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+inline uint64_t wyhash_bytes(const void* key, size_t len, uint64_t seed = 0)
+{
+    const auto* p = (const uint8_t*)key;
+    uint64_t a = 0, b = 0;
+    seed ^= wysecret[0];
+    if (len <= 16) {
+        if (len >= 4) {
+            const auto half = (len >> 3) << 2;
+            a = (read4(p) << 32) | read4(p + half);
+            b = (read4(p + len - 4) << 32) | read4(p + len - 4 - half);
+        } else if (len) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = mum(read8(p +  0) ^ wysecret[1], read8(p +  8) ^ seed);
+                see1 = mum(read8(p + 16) ^ wysecret[2], read8(p + 24) ^ see1);
+                see2 = mum(read8(p + 32) ^ wysecret[3], read8(p + 40) ^ see2);
+                p += 48; i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = mum(read8(p) ^ wysecret[1], read8(p + 8) ^ seed);
+            i -= 16; p += 16;
+        }
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+    return mum(wysecret[1] ^ len, mum(a ^ wysecret[1], b ^ seed));
+}
+
+inline uint64_t mix_u64(uint64_t key)
+{
+    return mum(key ^ wysecret[0], UINT64_C(0x9E3779B97F4A7C15));
+}
+
+#if EMH_CPU_X64
+/// len >= 16: four aes lanes absorb 64 bytes per step, the tail is overlapping loads.
+/// every block passes a full round before the lanes are folded with two more rounds.
+EMH_TARGET("aes,sse4.2")
+inline uint64_t aes_hash_bytes(const void* key, size_t len, uint64_t seed = 0)
+{
+    #define EMH_AES_ROUND(x, off, k) _mm_aesenc_si128(_mm_xor_si128(x, _mm_loadu_si128((const __m128i*)(p + (off)))), k)
+    const auto* p = (const uint8_t*)key;
+    const auto k0 = _mm_set_epi64x((long long)wysecret[1], (long long)(seed ^ len));
+    const auto k1 = _mm_set_epi64x((long long)wysecret[2], (long long)wysecret[3]);
+    auto a = EMH_AES_ROUND(k0, 0, k1), b = EMH_AES_ROUND(k1, len - 16, k0);
+    if (len > 32) {
+        auto c = EMH_AES_ROUND(k1, 16, k0), d = EMH_AES_ROUND(k0, len - 32, k1);
+        if (len > 64) {
+            const auto* last = p + len - 64;
+            for (p += 32; p < last; p += 64) {
+                a = EMH_AES_ROUND(a,  0, k1);
+                b = EMH_AES_ROUND(b, 16, k0);
+                c = EMH_AES_ROUND(c, 32, k1);
+                d = EMH_AES_ROUND(d, 48, k0);
+            }
+            //the last 64 bytes, overlapping what the loop has seen
+            p = last;
+            a = EMH_AES_ROUND(a,  0, k1);
+            b = EMH_AES_ROUND(b, 16, k0);
+            c = EMH_AES_ROUND(c, 32, k1);
+            d = EMH_AES_ROUND(d, 48, k0);
+        }
+        a = _mm_aesenc_si128(a, c);
+        b = _mm_aesenc_si128(b, d);
+    }
+    #undef EMH_AES_ROUND
+
+    auto h = _mm_aesenc_si128(a, b);
+    h = _mm_aesenc_si128(h, k0);
+    h = _mm_aesdec_si128(h, k1);
+    return (uint64_t)_mm_cvtsi128_si64(h) ^ (uint64_t)_mm_extract_epi64(h, 1);
+}
+
+/// two crc32c of the key and its halves swapped, both 32 bit halves stay independent
+EMH_TARGET("sse4.2")
+inline uint64_t crc_hash_u64(uint64_t key)
+{
+    const uint64_t lo = _mm_crc32_u64(0x9E3779B9u, key);
+    const uint64_t hi = _mm_crc32_u64(0x85EBCA6Bu, (key >> 32) | (key << 32));
+    return (hi << 32) | lo;
+}
+
+EMH_TARGET("aes,sse4.2")
+inline uint64_t aes_hash_u128(uint64_t lo, uint64_t hi)
+{
+    const auto k0 = _mm_set_epi64x((long long)wysecret[1], (long long)wysecret[0]);
+    const auto k1 = _mm_set_epi64x((long long)wysecret[2], (long long)wysecret[3]);
+    auto h = _mm_aesenc_si128(_mm_xor_si128(_mm_set_epi64x((long long)hi, (long long)lo), k0), k1);
+    h = _mm_aesenc_si128(h, k0);
+    return (uint64_t)_mm_cvtsi128_si64(h) ^ (uint64_t)_mm_extract_epi64(h, 1);
+}
+#endif
+
+/// aes is used for lengths in [min_len, max_len], bench/bstring.cpp -DHW_HASH measures both
+struct AesRange
+{
+    size_t min_len;
+    size_t max_len;
+};
+
+inline AesRange& aes_range()
+{
+    static AesRange range = {EMH_AES_MIN < 16 ? 16 : EMH_AES_MIN, EMH_AES_MAX};
+    return range;
+}
+
+inline uint64_t hash_bytes(const void* key, size_t len, uint64_t seed = 0)
+{
+#if EMH_CPU_X64
+    const auto& range = aes_range();
+    if (len >= range.min_len && len <= range.max_len && has_aes())
+        return aes_hash_bytes(key, len, seed);
+#endif
+    return wyhash_bytes(key, len, seed);
+}
+
+inline uint64_t hash_u64(uint64_t key)
+{
+#if EMH_CPU_X64
+    if (has_aes())
+        return crc_hash_u64(key);
+#endif
+    return mix_u64(key);
+}
+
+inline uint64_t hash_u128(uint64_t lo, uint64_t hi)
+{
+#if EMH_CPU_X64
+    if (has_aes())
+        return aes_hash_u128(lo, hi);
+#endif
+    return mum(lo ^ wysecret[0], hi ^ wysecret[1]);
+}
+
+// fixed size keys of at most 32 bytes: std::array<uint8_t, N>, std::array<char, N> or a padding
+// free struct around char[N]. the size is a constant, so the loads are unrolled and overlap
+// instead of looping over the tail. comparing is inlined into every probe and can not go through
+// the runtime dispatch, it uses the isa the table is compiled for (sse2 baseline, avx2 with -mavx2).
+template<size_t N>
+inline uint64_t fixed_hash(const void* key)
+{
+    static_assert(N > 0 && N <= 32, "fixed keys are 1-32 bytes");
+    const auto* p = (const uint8_t*)key;
+    if (N < 4) {
+        const uint64_t a = ((uint64_t)p[0] << 16) | ((uint64_t)p[N >> 1] << 8) | p[N - 1];
+        return mum(a ^ wysecret[0], N ^ wysecret[1]);
+    } else if (N <= 8) {
+        const uint64_t a = read4(p), b = read4(p + N - 4);
+        return mum((a << 32 | b) ^ wysecret[0], N ^ wysecret[1]);
+    } else if (N <= 16) {
+        return mum(read8(p) ^ wysecret[0], read8(p + N - 8) ^ wysecret[1] ^ N);
+    }
+
+    //two independent 16 byte lanes, folded by a third multiply
+    const auto lo = mum(read8(p) ^ wysecret[0], read8(p + 8) ^ wysecret[1]);
+    const auto hi = mum(read8(p + N - 16) ^ wysecret[2], read8(p + N - 8) ^ wysecret[3]);
+    return mum(lo ^ N, hi ^ wysecret[0]);
+}
+
+template<size_t N>
+inline bool fixed_equal(const void* lhs, const void* rhs)
+{
+    static_assert(N > 0 && N <= 32, "fixed keys are 1-32 bytes");
+    const auto* a = (const uint8_t*)lhs;
+    const auto* b = (const uint8_t*)rhs;
+#if EMH_CPU_X64
+    #if defined(__AVX2__)
+    if (N == 32) {
+        const auto eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)a), _mm256_loadu_si256((const __m256i*)b));
+        return (uint32_t)_mm256_movemask_epi8(eq) == 0xFFFFFFFFu;
+    }
+    #endif
+    if (N >= 16) {
+        //N in (16, 32): the second load overlaps the first
+        auto eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b));
+        if (N > 16)
+            eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + N - 16)), _mm_loadu_si128((const __m128i*)(b + N - 16))));
+        return _mm_movemask_epi8(eq) == 0xFFFF;
+    }
+#else
+    if (N >= 16) {
+        uint64_t diff = 0;
+        for (size_t i = 0; i + 8 <= N; i += 8)
+            diff |= read8(a + i) ^ read8(b + i);
+        return (diff | (read8(a + N - 8) ^ read8(b + N - 8))) == 0;
+    }
+#endif
+    if (N >= 8)
+        return ((read8(a) ^ read8(b)) | (read8(a + N - 8) ^ read8(b + N - 8))) == 0;
+    return memcmp(a, b, N) == 0;
+}
+
+/// hasher and key_equal for fixed size keys, any table:
+///   emhash7::HashMap<std::array<uint8_t, 16>, int, emcpu::FixedHash, emcpu::FixedEqual>
+struct FixedHash
+{
+    template<typename T>
+    size_t operator()(const T& key) const
+    {
+        static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= 32, "fixed keys are trivially copyable, 1-32 bytes");
+        return (size_t)fixed_hash<sizeof(T)>(&key);
+    }
+};
+
+struct FixedEqual
+{
+    template<typename T>
+    bool operator()(const T& lhs, const T& rhs) const { return fixed_equal<sizeof(T)>(&lhs, &rhs); }
+};
+
+/// hardware hasher, e.g. emhash8::HashMap<std::string, int, emcpu::HwHash>
+struct HwHash
+{
+    size_t operator()(const std::string& key) const { return (size_t)hash_bytes(key.data(), key.size()); }
+#if __cplusplus >= 201703L || _MSVC_LANG >= 201703L
+    size_t operator()(const std::string_view key) const { return (size_t)hash_bytes(key.data(), key.size()); }
+#endif
+
+    template<typename T, typename std::enable_if<(std::is_integral<T>::value || std::is_enum<T>::value) && sizeof(T) <= 8, int>::type = 0>
+    size_t operator()(const T key) const { return (size_t)hash_u64((uint64_t)key); }
+
+#if defined(__SIZEOF_INT128__)
+    size_t operator()(const __uint128_t key) const { return (size_t)hash_u128((uint64_t)key, (uint64_t)(key >> 64)); }
+    size_t operator()(const __int128_t key) const { return operator()((__uint128_t)key); }
+#endif
+};
+
+} // namespace emcpu
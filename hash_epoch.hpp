@@ -0,0 +1,202 @@
+// emepoch::Domain epoch based reclamation for emhash readers for C++11/14/17
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+// a reader takes one of max_readers slots once (Domain::Reader), then pins the current
+// epoch around every access to a published object. the writer swaps in a new object,
+// retire()s the old one and it is freed when no slot is pinned at or before that epoch.
+// pin() is a store + full fence, so hot readers pin once per batch of lookups (Guard).
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace emepoch {
+
+class Domain
+{
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> epoch; //0: not pinned
+        std::atomic<uint32_t> used;
+    };
+
+    struct Retired
+    {
+        void*    ptr;
+        void   (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+public:
+    explicit Domain(uint32_t max_readers = 128) : _num_slots(max_readers)
+    {
+        _alloc = malloc(sizeof(Slot) * (max_readers + 1));
+        if (!_alloc)
+            throw std::bad_alloc();
+        _slots = (Slot*)(((uintptr_t)_alloc + alignof(Slot) - 1) & ~(uintptr_t)(alignof(Slot) - 1));
+        for (uint32_t i = 0; i < _num_slots; i++) {
+            new(&_slots[i].epoch) std::atomic<uint64_t>(0);
+            new(&_slots[i].used) std::atomic<uint32_t>(0);
+        }
+    }
+
+    Domain(const Domain&) = delete;
+    Domain& operator=(const Domain&) = delete;
+
+    ~Domain()
+    {
+        for (auto& r : _retired)
+            r.deleter(r.ptr);
+        free(_alloc);
+    }
+
+    /// a registered reader, owns a slot until destroyed. one thread at a time.
+    class Reader
+    {
+    public:
+        Reader() : _domain(nullptr), _slot(-1), _depth(0) {}
+        explicit Reader(Domain& domain) : _domain(&domain), _slot(domain.acquire_slot()), _depth(0) {}
+        Reader(Reader&& rhs) noexcept : _domain(rhs._domain), _slot(rhs._slot), _depth(rhs._depth) { rhs._slot = -1; }
+        Reader& operator=(Reader&& rhs) noexcept { std::swap(_domain, rhs._domain); std::swap(_slot, rhs._slot); std::swap(_depth, rhs._depth); return *this; }
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        ~Reader() { if (_slot >= 0) { _domain->_slots[_slot].epoch.store(0, std::memory_order_release); _domain->release_slot(_slot); } }
+
+        /// false when the domain ran out of slots
+        bool valid() const { return _slot >= 0; }
+
+        /// nested pins are counted, only the outermost one touches the slot
+        void pin()
+        {
+            if (_depth++ == 0) {
+                auto& slot = _domain->_slots[_slot];
+                slot.epoch.store(_domain->_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        void unpin()
+        {
+            if (--_depth == 0)
+                _domain->_slots[_slot].epoch.store(0, std::memory_order_release);
+        }
+
+        bool pinned() const { return _depth != 0; }
+
+    private:
+        Domain*  _domain;
+        int      _slot;
+        uint32_t _depth;
+    };
+
+    /// scoped pin, every object loaded inside stays alive until it ends
+    class Guard
+    {
+    public:
+        explicit Guard(Reader& reader) : _reader(&reader) { reader.pin(); }
+        Guard(Guard&& rhs) noexcept : _reader(rhs._reader) { rhs._reader = nullptr; }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard() { if (_reader) _reader->unpin(); }
+    private:
+        Reader* _reader;
+    };
+
+    /// writer side: ptr was unpublished before this call, free it once readers moved on.
+    /// not thread safe against other writers.
+    template<typename T>
+    void retire(T* ptr)
+    {
+        retire(ptr, [](void* p) { delete (T*)p; });
+    }
+
+    void retire(void* ptr, void (*deleter)(void*))
+    {
+        _retired.push_back({ptr, deleter, advance()});
+        collect();
+    }
+
+    /// writer side: close the current epoch and return it. an object unpublished before
+    /// this call is out of every reader's hands once quiescent(epoch) returns true.
+    uint64_t advance() { return _epoch.fetch_add(1, std::memory_order_seq_cst); }
+
+    bool quiescent(uint64_t epoch) const { return oldest_pinned() > epoch; }
+
+    /// free what no pinned reader can see, returns the number still waiting
+    size_t collect()
+    {
+        const auto oldest = oldest_pinned();
+        size_t keep = 0;
+        for (auto& r : _retired) {
+            if (r.epoch < oldest)
+                r.deleter(r.ptr);
+            else
+                _retired[keep++] = r;
+        }
+        _retired.resize(keep);
+        return keep;
+    }
+
+    size_t pending() const { return _retired.size(); }
+    uint64_t epoch() const { return _epoch.load(std::memory_order_relaxed); }
+
+private:
+    uint64_t oldest_pinned() const
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t oldest = ~(uint64_t)0;
+        for (uint32_t i = 0; i < _num_slots; i++) {
+            const auto e = _slots[i].epoch.load(std::memory_order_acquire);
+            if (e != 0 && e < oldest)
+                oldest = e;
+        }
+        return oldest;
+    }
+
+    int acquire_slot()
+    {
+        for (uint32_t i = 0; i < _num_slots; i++) {
+            uint32_t expect = 0;
+            if (_slots[i].used.load(std::memory_order_relaxed) == 0 &&
+                _slots[i].used.compare_exchange_strong(expect, 1, std::memory_order_acq_rel))
+                return (int)i;
+        }
+        return -1;
+    }
+
+    void release_slot(int slot) { _slots[slot].used.store(0, std::memory_order_release); }
+
+    void*    _alloc;
+    Slot*    _slots;
+    uint32_t _num_slots;
+    std::atomic<uint64_t> _epoch{1};
+    std::vector<Retired>  _retired;
+};
+
+}
@@ -0,0 +1,190 @@
+// emfront::FrontCache per thread hot key cache in front of a shared map for C++11/14/17
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+// skewed reads: a few keys take most lookups, and every lookup of a shared map takes its
+// lock and pulls its lines. a FrontCache is owned by one thread, a direct mapped array of
+// N entries {full hash, generation, key, value} that answers repeated keys from L1.
+// a miss calls load(key, val), the lookup in the shared map (any emhash map or wrapper,
+// under whatever lock it needs), and keeps a found value in the key's entry unless the
+// key there was hit since it came in: that one only loses its hot bit, so the cold tail
+// of a skewed stream does not keep evicting the hot keys.
+// writers bump the Generation stripe of the key after every change to the map, an entry
+// is only good while it carries the current generation of its stripe: one shared load per
+// lookup, no flush of N entries, and a counter line is only written when the map is.
+// a lookup reads the generation before load(), so a value loaded across a write carries
+// the older generation and is dropped at the next lookup.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#ifndef EMH_FRONT_ENTRIES
+    #define EMH_FRONT_ENTRIES 1024
+#endif
+#ifndef EMH_FRONT_STRIPES
+    #define EMH_FRONT_STRIPES 64    //generation counters, a power of two
+#endif
+
+namespace emfront {
+
+/// bumped by the writers of one shared map, read by every FrontCache in front of it.
+/// striped: a write bumps the stripe of its key and leaves the other entries alone.
+class Generation
+{
+public:
+    explicit Generation(uint32_t stripes = EMH_FRONT_STRIPES) : _mask(stripes - 1), _lines(new Line[stripes])
+    {
+        for (uint32_t i = 0; i < stripes; i++)
+            _lines[i].gen.store(1, std::memory_order_relaxed);
+    }
+
+    Generation(const Generation&) = delete;
+    Generation& operator=(const Generation&) = delete;
+
+    /// after writing the key of key_hash (HashT of the caches), before its lock is released
+    void bump(uint64_t key_hash) { _lines[stripe(key_hash)].gen.fetch_add(1, std::memory_order_release); }
+
+    /// after a change to many keys (clear, bulk load)
+    void bump_all()
+    {
+        for (uint32_t i = 0; i <= _mask; i++)
+            _lines[i].gen.fetch_add(1, std::memory_order_release);
+    }
+
+    uint64_t load(uint64_t key_hash) const { return _lines[stripe(key_hash)].gen.load(std::memory_order_acquire); }
+
+private:
+    struct alignas(64) Line
+    {
+        std::atomic<uint64_t> gen; //a line of its own, 0 marks an empty entry
+    };
+
+    uint32_t stripe(uint64_t key_hash) const
+    {
+        return (uint32_t)((key_hash * UINT64_C(0x9E3779B97F4A7C15)) >> 16) & _mask;
+    }
+
+    uint32_t                _mask;
+    std::unique_ptr<Line[]> _lines;
+};
+
+/// one thread only. N entries, a power of two: 256 of 8 byte keys and values stay in L1
+template <typename KeyT, typename ValueT, uint32_t N = EMH_FRONT_ENTRIES, typename HashT = std::hash<KeyT>, typename EqT = std::equal_to<KeyT>>
+class FrontCache
+{
+    static_assert(N >= 16 && (N & (N - 1)) == 0, "FrontCache entries are a power of two");
+
+public:
+    explicit FrontCache(const Generation& gen, const HashT& hash = HashT(), const EqT& eq = EqT())
+        : _entries(new Entry[N]()), _gen(&gen), _hash(hash), _eq(eq), _hits(0), _misses(0)
+    {
+    }
+
+    FrontCache(const FrontCache&) = delete;
+    FrontCache& operator=(const FrontCache&) = delete;
+
+    /// val of key from the cache, else from load(key, val) -> bool
+    template<typename LoadF>
+    bool find(const KeyT& key, ValueT& val, LoadF&& load)
+    {
+        return find(key, (uint64_t)_hash(key), val, load);
+    }
+
+    /// key_hash is the full 64 bit hash of key, e.g. emhash8::HashMap::hash_of(key)
+    template<typename LoadF>
+    bool find(const KeyT& key, uint64_t key_hash, ValueT& val, LoadF&& load)
+    {
+        const auto gen = _gen->load(key_hash) << 1;
+        auto& e = _entries[slot(key_hash)];
+        if ((e.gen & ~HOT) == gen && e.hash == key_hash && _eq(e.key, key)) {
+            _hits ++;
+            e.gen |= HOT;
+            val = e.val;
+            return true;
+        }
+
+        _misses ++;
+        if (!load(key, val))
+            return false;
+        //second chance: a key hit since it came in keeps its entry against one other key
+        if ((e.gen & HOT) && e.hash != key_hash) {
+            e.gen &= ~HOT;
+            return true;
+        }
+        e.hash = key_hash;
+        e.gen  = gen;
+        e.key  = key;
+        e.val  = val;
+        return true;
+    }
+
+    /// drop key from this cache only
+    void erase(const KeyT& key)
+    {
+        auto& e = _entries[slot((uint64_t)_hash(key))];
+        if (e.gen && _eq(e.key, key))
+            e.gen = 0;
+    }
+
+    void clear()
+    {
+        for (uint32_t i = 0; i < N; i++)
+            _entries[i].gen = 0;
+    }
+
+    static constexpr uint32_t capacity() { return N; }
+    uint64_t hits() const { return _hits; }
+    uint64_t misses() const { return _misses; }
+    double hit_rate() const { return _hits + _misses ? (double)_hits / (_hits + _misses) : 0; }
+    void reset_stats() { _hits = _misses = 0; }
+
+private:
+    constexpr static uint64_t HOT = 1;
+
+    struct Entry
+    {
+        uint64_t hash;
+        uint64_t gen;   //generation << 1 | HOT, 0: empty
+        KeyT     key;
+        ValueT   val;
+    };
+
+    //fibonacci mix: std::hash of integers is the key itself
+    static uint32_t slot(uint64_t key_hash)
+    {
+        return (uint32_t)((key_hash * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (N - 1);
+    }
+
+    std::unique_ptr<Entry[]> _entries;
+    const Generation*        _gen;
+    HashT                    _hash;
+    EqT                      _eq;
+    uint64_t                 _hits;
+    uint64_t                 _misses;
+};
+
+}
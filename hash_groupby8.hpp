@@ -0,0 +1,329 @@
+// emhash8::GroupBy partitioned parallel hash aggregation for C++11/14/17
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+// GROUP BY key: every row is hashed once, its hash picks one of 2^bits partitions (top
+// bits, the tables index with the low ones) and the row is scattered into that
+// partition's run. every partition is then aggregated by one task into its own emhash8
+// table, small enough to stay in L2, with try_emplace_hash() and the index bucket of a
+// row a few rows ahead prefetched. a key lives in one partition only, so the tables never
+// overlap: merge_into() moves them into one map with the hashes kept per partition slot,
+// no key is hashed again.
+// an aggregate is any type with
+//   using result_type = ...;
+//   result_type init(const V& v) const;                     //first row of a group
+//   void update(result_type& acc, const V& v) const;         //next rows
+//   void merge(result_type& acc, const result_type& o) const; //two partial groups
+// agg::Count, agg::Sum, agg::Min and agg::Max are the usual ones.
+// RadixRuns does the hash and scatter passes, hash_join8.hpp partitions with it too.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash_table8.hpp"
+
+#ifndef EMH_GROUPBY_L2
+    #define EMH_GROUPBY_L2 (1 << 20)  //bytes of table a partition aims at
+#endif
+#ifndef EMH_GROUPBY_AHEAD
+    #define EMH_GROUPBY_AHEAD 8       //rows prefetched ahead of the upsert
+#endif
+
+namespace emhash8 {
+
+namespace agg {
+
+struct Count
+{
+    using result_type = uint64_t;
+    template<typename V> uint64_t init(const V&) const { return 1; }
+    template<typename V> void update(uint64_t& acc, const V&) const { acc ++; }
+    void merge(uint64_t& acc, uint64_t o) const { acc += o; }
+};
+
+template<typename T>
+struct Sum
+{
+    using result_type = T;
+    template<typename V> T init(const V& v) const { return T(v); }
+    template<typename V> void update(T& acc, const V& v) const { acc += v; }
+    void merge(T& acc, const T& o) const { acc += o; }
+};
+
+template<typename T>
+struct Min
+{
+    using result_type = T;
+    template<typename V> T init(const V& v) const { return T(v); }
+    template<typename V> void update(T& acc, const V& v) const { if (v < acc) acc = v; }
+    void merge(T& acc, const T& o) const { if (o < acc) acc = o; }
+};
+
+template<typename T>
+struct Max
+{
+    using result_type = T;
+    template<typename V> T init(const V& v) const { return T(v); }
+    template<typename V> void update(T& acc, const V& v) const { if (acc < v) acc = v; }
+    void merge(T& acc, const T& o) const { if (acc < o) acc = o; }
+};
+
+}
+
+/// partition of key_hash among 2^bits: top bits after a fibonacci mix, the tables index
+/// with the low ones and an identity hash leaves the top bits of small keys zero
+inline size_t radix_part(uint64_t key_hash, uint32_t bits)
+{
+    return (size_t)((key_hash * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - bits));
+}
+
+/// log2 of as many partitions as keep bytes of tables in l2 each, 4 .. 10
+inline uint32_t radix_bits(size_t bytes, size_t l2)
+{
+    uint32_t bits = 4;
+    while (bits < 10 && (bytes >> bits) > l2)
+        bits ++;
+    return bits;
+}
+
+/// hash a column of keys the way map does: hash_keys() for integers, one by one else
+template<typename MapT, typename K, typename std::enable_if<std::is_integral<K>::value, int>::type = 0>
+void radix_hash(const MapT& map, const K* keys, uint64_t* out, size_t n)
+{
+    map.hash_keys(keys, out, n);
+}
+
+template<typename MapT, typename K, typename std::enable_if<!std::is_integral<K>::value, int>::type = 0>
+void radix_hash(const MapT& map, const K* keys, uint64_t* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = map.hash_of(keys[i]);
+}
+
+/// n input rows scattered into one run per partition, a run keeps its rows in input order.
+/// chunks of rows are hashed and counted in parallel, prefix sums give every (chunk,
+/// partition) its place and a second parallel pass writes the rows there. the buffers are
+/// kept for the next scatter() of at most as many rows, a block loop faults them in once.
+template<typename RowT>
+struct RadixRuns
+{
+    std::unique_ptr<RowT[]>     rows;   //new[]: trivial rows are written once, not zeroed first
+    std::vector<size_t>         begin;  //run p is rows[begin[p], begin[p + 1])
+    std::unique_ptr<uint64_t[]> hashes;
+    size_t                      cap = 0;
+
+    /// hash(first, n, out) hashes input rows [first, first + n), row(i, key_hash) makes row i
+    template<typename Exec, typename HashF, typename RowF>
+    void scatter(size_t n, uint32_t bits, Exec&& exec, const HashF& hash, const RowF& row)
+    {
+        const auto parts  = size_t(1) << bits;
+        const auto chunk  = std::max<size_t>(EMH_PARALLEL_RANGE, n / 256 + 1);
+        const auto chunks = (n + chunk - 1) / chunk;
+        if (n > cap) {
+            rows.reset(new RowT[n]);
+            hashes.reset(new uint64_t[n]);
+            cap = n;
+        }
+        std::vector<size_t> counts(chunks * parts, 0);
+
+        exec(chunks, [&](size_t c) {
+            const auto first = c * chunk, last = std::min(first + chunk, n);
+            hash(first, last - first, hashes.get() + first);
+            auto count = counts.data() + c * parts;
+            for (auto i = first; i < last; i++)
+                count[radix_part(hashes[i], bits)] ++;
+        });
+
+        begin.resize(parts + 1);
+        size_t sum = 0;
+        for (size_t p = 0; p < parts; p++) {
+            begin[p] = sum;
+            for (size_t c = 0; c < chunks; c++) {
+                const auto k = counts[c * parts + p];
+                counts[c * parts + p] = sum;
+                sum += k;
+            }
+        }
+        begin[parts] = sum;
+
+        exec(chunks, [&](size_t c) {
+            const auto first = c * chunk, last = std::min(first + chunk, n);
+            auto pos = counts.data() + c * parts;
+            for (auto i = first; i < last; i++)
+                rows[pos[radix_part(hashes[i], bits)] ++] = row(i, hashes[i]);
+        });
+    }
+};
+
+/// counters of the last GroupBy::aggregate() call
+struct GroupStats
+{
+    uint64_t rows;
+    uint64_t groups;      //after the call, all calls together
+    uint32_t partitions;
+    double   seconds;
+
+    double rows_per_sec() const { return seconds > 0 ? rows / seconds : 0; }
+};
+
+template <typename KeyT, typename AggT, typename HashT = Hash<KeyT>, typename EqT = EqualTo<KeyT>, typename PolicyT = DefaultPolicy>
+class GroupBy
+{
+public:
+    using result_type = typename AggT::result_type;
+    using map_type    = HashMap<KeyT, result_type, HashT, EqT, PolicyT>;
+
+    /// bits = log2 of the partition count, 0 sizes it on the first aggregate() from the
+    /// rows it sees and l2_bytes, then it stays fixed
+    explicit GroupBy(AggT agg = AggT(), uint32_t bits = 0, size_t l2_bytes = EMH_GROUPBY_L2)
+        : _agg(agg), _bits(bits), _l2(l2_bytes)
+    {
+        if (_bits)
+            _parts.resize(size_t(1) << _bits);
+    }
+
+    /// fold rows into the groups, tasks run on exec(n, task) as HashMap::parallel_rehash()
+    /// does. keys and vals are copied into the partition runs, the arrays are read once.
+    template<typename ValT, typename Exec>
+    const GroupStats& aggregate(const KeyT* keys, const ValT* vals, size_t rows, Exec&& exec)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (_parts.empty())
+            init_parts(rows);
+
+        struct Row { uint64_t hash; KeyT key; ValT val; };
+        const auto parts = _parts.size();
+        const auto& hasher = _parts[0].map;
+        RadixRuns<Row> runs;
+        runs.scatter(rows, _bits, exec,
+            [&](size_t first, size_t n, uint64_t* out) { radix_hash(hasher, keys + first, out, n); },
+            [&](size_t i, uint64_t key_hash) { return Row{key_hash, keys[i], vals[i]}; });
+
+        exec(parts, [&](size_t p) {
+            auto& part = _parts[p];
+            const auto first = runs.begin[p], last = runs.begin[p + 1];
+            for (auto i = first; i < last; i++) {
+                if (i + EMH_GROUPBY_AHEAD < last)
+                    part.map.prefetch(runs.rows[i + EMH_GROUPBY_AHEAD].hash);
+                const auto& row = runs.rows[i];
+                upsert(part, row.key, row.hash, row.val);
+            }
+        });
+
+        _stats.rows = rows;
+        _stats.groups = size();
+        _stats.partitions = (uint32_t)parts;
+        _stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return _stats;
+    }
+
+    /// move every group into out with the hash its partition kept. a group already in out
+    /// is combined with AggT::merge, the others go in without a lookup when out is empty.
+    void merge_into(map_type& out)
+    {
+        const auto fresh = out.empty();
+        out.reserve(out.size() + size());
+        for (auto& part : _parts) {
+            size_t slot = 0;
+            for (auto& kv : part.map) {
+                const auto key_hash = part.hashes[slot++];
+                if (fresh) {
+                    out.insert_unique_hash(std::move(kv.first), std::move(kv.second), key_hash);
+                    continue;
+                }
+                auto it = out.try_emplace_hash(kv.first, key_hash, kv.second);
+                if (!it.second)
+                    _agg.merge(it.first->second, kv.second);
+            }
+        }
+        clear();
+    }
+
+    /// the aggregate of key, false when no row had it
+    bool find(const KeyT& key, result_type& val) const
+    {
+        if (_parts.empty())
+            return false;
+        const auto& part = _parts[radix_part(_parts[0].map.hash_of(key), _bits)];
+        return part.map.try_get(key, val);
+    }
+
+    size_t size() const
+    {
+        size_t groups = 0;
+        for (const auto& part : _parts)
+            groups += part.map.size();
+        return groups;
+    }
+
+    size_t partition_count() const { return _parts.size(); }
+    const map_type& partition(size_t p) const { return _parts[p].map; }
+    const GroupStats& stats() const { return _stats; }
+
+    /// drop the groups, keep the partition count and the tables' memory
+    void clear()
+    {
+        for (auto& part : _parts) {
+            part.map.clear();
+            part.hashes.clear();
+        }
+    }
+
+private:
+    struct Part
+    {
+        map_type map;
+        std::vector<uint64_t> hashes; //hash of the group in every slot of map
+    };
+
+    void init_parts(size_t rows)
+    {
+        _bits = radix_bits(rows * (sizeof(typename map_type::value_type) + 2 * sizeof(uint32_t) + sizeof(uint64_t)), _l2);
+        _parts.resize(size_t(1) << _bits);
+    }
+
+    template<typename ValT>
+    void upsert(Part& part, const KeyT& key, uint64_t key_hash, const ValT& val)
+    {
+        auto it = part.map.try_emplace_hash(key, key_hash, _agg.init(val));
+        if (it.second)
+            part.hashes.push_back(key_hash);
+        else
+            _agg.update(it.first->second, val);
+    }
+
+    AggT              _agg;
+    uint32_t          _bits;
+    size_t            _l2;
+    std::vector<Part> _parts;
+    GroupStats        _stats{};
+};
+
+}
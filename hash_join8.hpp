@@ -0,0 +1,222 @@
+// emhash8::HashJoin radix partitioned hash join for C++11/14/17
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+// build side and probe side are split by the same hash bits (RadixRuns, see
+// hash_groupby8.hpp), so a probe row only ever looks into the small table of its own
+// partition and its index and pairs stay in L2 instead of missing DRAM twice.
+// build(): one emhash8 table per partition maps a key to the last build row with it, the
+// rows of a key before it hang off a next array (multimap semantics, newest first).
+// inner()/semi()/anti(): one task per partition walks its probe run with find_hash() and
+// the index bucket of a row a few rows ahead prefetched. emit is called from the task of
+// the partition, calls for different partitions may run at the same time.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "hash_groupby8.hpp"
+
+#ifndef EMH_JOIN_BLOCK
+    #define EMH_JOIN_BLOCK (1 << 22)  //probe rows partitioned at once, at least
+#endif
+
+namespace emhash8 {
+
+/// counters of the last HashJoin::build() and probe
+struct JoinStats
+{
+    uint64_t build_rows;
+    uint64_t keys;        //distinct build keys
+    uint64_t probe_rows;
+    uint64_t matches;     //pairs for inner(), probe rows emitted for semi()/anti()
+    uint32_t partitions;
+    double   build_seconds;
+    double   probe_seconds;
+
+    double probe_rows_per_sec() const { return probe_seconds > 0 ? probe_rows / probe_seconds : 0; }
+};
+
+template <typename KeyT, typename HashT = Hash<KeyT>, typename EqT = EqualTo<KeyT>, typename PolicyT = DefaultPolicy>
+class HashJoin
+{
+public:
+    using map_type = HashMap<KeyT, uint32_t, HashT, EqT, PolicyT>;
+
+    /// bits = log2 of the partition count, 0 sizes it from the build rows and l2_bytes
+    explicit HashJoin(uint32_t bits = 0, size_t l2_bytes = EMH_GROUPBY_L2)
+        : _fixed(bits), _bits(bits), _l2(l2_bytes)
+    {
+    }
+
+    /// index the build column, replacing the previous one. the probes report build rows as
+    /// their position in keys.
+    template<typename Exec>
+    const JoinStats& build(const KeyT* keys, size_t rows, Exec&& exec)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        _bits = _fixed ? _fixed : radix_bits(rows * (sizeof(typename map_type::value_type) + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t)), _l2);
+        _parts.clear();
+        _parts.resize(size_t(1) << _bits);
+
+        struct Row { uint64_t hash; KeyT key; size_t row; };
+        const auto& hasher = _parts[0];
+        RadixRuns<Row> runs;
+        runs.scatter(rows, _bits, exec,
+            [&](size_t first, size_t n, uint64_t* out) { radix_hash(hasher, keys + first, out, n); },
+            [&](size_t i, uint64_t key_hash) { return Row{key_hash, keys[i], i}; });
+
+        _begin = std::move(runs.begin);
+        _rows.resize(rows);
+        _next.resize(rows);
+        exec(_parts.size(), [&](size_t p) {
+            auto& map = _parts[p];
+            const auto first = _begin[p], last = _begin[p + 1];
+            for (auto i = first; i < last; i++) {
+                if (i + EMH_GROUPBY_AHEAD < last)
+                    map.prefetch(runs.rows[i + EMH_GROUPBY_AHEAD].hash);
+                const auto& row = runs.rows[i];
+                const auto local = (uint32_t)(i - first);
+                auto it = map.try_emplace_hash(row.key, row.hash, local);
+                _next[i] = it.second ? END : it.first->second;
+                it.first->second = local;
+                _rows[i] = row.row;
+            }
+        });
+
+        _stats = JoinStats{};
+        _stats.build_rows = rows;
+        for (const auto& map : _parts)
+            _stats.keys += map.size();
+        _stats.partitions = (uint32_t)_parts.size();
+        _stats.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return _stats;
+    }
+
+    /// emit(build_row, probe_row) for every pair of equal keys, returns the pair count
+    template<typename Exec, typename F>
+    size_t inner(const KeyT* keys, size_t rows, Exec&& exec, const F& emit)
+    {
+        return probe(keys, rows, exec, [&](size_t probe_row, size_t first, uint32_t local) {
+            size_t n = 0;
+            for (; local != END; local = _next[first + local], n++)
+                emit(_rows[first + local], probe_row);
+            return n;
+        });
+    }
+
+    /// emit(probe_row) once for every probe row with at least one equal build key
+    template<typename Exec, typename F>
+    size_t semi(const KeyT* keys, size_t rows, Exec&& exec, const F& emit)
+    {
+        return probe(keys, rows, exec, [&](size_t probe_row, size_t, uint32_t local) {
+            if (local == END)
+                return 0;
+            emit(probe_row);
+            return 1;
+        });
+    }
+
+    /// emit(probe_row) for every probe row whose key is not in the build side
+    template<typename Exec, typename F>
+    size_t anti(const KeyT* keys, size_t rows, Exec&& exec, const F& emit)
+    {
+        return probe(keys, rows, exec, [&](size_t probe_row, size_t, uint32_t local) {
+            if (local != END)
+                return 0;
+            emit(probe_row);
+            return 1;
+        });
+    }
+
+    size_t partition_count() const { return _parts.size(); }
+    const map_type& partition(size_t p) const { return _parts[p]; }
+    const JoinStats& stats() const { return _stats; }
+
+private:
+    constexpr static uint32_t END = 0-1u;
+
+    //match(probe_row, run begin, local head or END) handles one probe row
+    template<typename Exec, typename MatchF>
+    size_t probe(const KeyT* keys, size_t rows, Exec&& exec, const MatchF& match)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const auto parts = _parts.size();
+        std::vector<size_t> matches(parts + 1, 0);
+        if (!parts) {
+            //nothing built: no row matches
+            for (size_t i = 0; i < rows; i++)
+                matches[0] += match(i, 0, END);
+        }
+
+        //the probe side goes in blocks through one set of runs: hash, key and row of every
+        //row of a billions row column would not fit, and a block reuses memory faulted in.
+        //every block pulls all tables through the cache once, so a block is never smaller
+        //than the build side
+        const auto block_rows = std::max<size_t>(EMH_JOIN_BLOCK, _rows.size());
+        for (size_t block = 0; parts && block < rows; block += block_rows) {
+            const auto& hasher = _parts[0];
+            const auto n = std::min<size_t>(block_rows, rows - block);
+            _probe.scatter(n, _bits, exec,
+                [&](size_t first, size_t k, uint64_t* out) { radix_hash(hasher, keys + block + first, out, k); },
+                [&](size_t i, uint64_t key_hash) { return ProbeRow{key_hash, keys[block + i], block + i}; });
+
+            exec(parts, [&](size_t p) {
+                const auto& map = _parts[p];
+                const auto first = _probe.begin[p], last = _probe.begin[p + 1];
+                size_t k = 0;
+                for (auto i = first; i < last; i++) {
+                    if (i + EMH_GROUPBY_AHEAD < last)
+                        map.prefetch(_probe.rows[i + EMH_GROUPBY_AHEAD].hash);
+                    const auto& row = _probe.rows[i];
+                    const auto it = map.find_hash(row.key, row.hash);
+                    k += match(row.row, _begin[p], it == map.end() ? END : it->second);
+                }
+                matches[p] += k;
+            });
+        }
+
+        _stats.probe_rows = rows;
+        _stats.matches = 0;
+        for (auto n : matches)
+            _stats.matches += n;
+        _stats.probe_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return _stats.matches;
+    }
+
+    struct ProbeRow { uint64_t hash; KeyT key; size_t row; };
+
+    uint32_t              _fixed;
+    uint32_t              _bits;
+    size_t                _l2;
+    std::vector<map_type> _parts;
+    std::vector<size_t>   _begin;  //build run of partition p is [_begin[p], _begin[p + 1])
+    std::vector<size_t>   _rows;   //build row of every run position
+    std::vector<uint32_t> _next;   //older run position with the same key, local to the run
+    RadixRuns<ProbeRow>   _probe;
+    JoinStats             _stats{};
+};
+
+}
@@ -0,0 +1,411 @@
+// emhash8::NumaMap node local sharded map over emhash8::HashMap for C++11/14/17
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+// one big table gets its pages spread over the sockets and every other lookup pays a
+// remote hop. a NumaMap splits the keys over shards that each live on one node: the
+// shards are emhash8 maps whose policy allocator (emnuma::NodeAllocator) puts _pairs and
+// _index on the node the NodeScope around the write names.
+//   PARTITIONED - shard by hash, shard s on node s % nodes. memory is split, a lookup is
+//                 local when the key's shard is on the caller's node
+//   REPLICATED  - one full copy per node, a lookup reads the copy of the caller's node and
+//                 a write goes to every copy. read mostly tables that fit once per node
+// build with -DEMH_NUMA=1 and -lnuma. without it, or when the kernel has no numa, the
+// machine is one node and NumaMap is a plain sharded map.
+// same rules as HashMap: const calls from many threads, writes with nobody else inside.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#if _WIN32
+    #include <malloc.h>
+#endif
+#if EMH_NUMA
+    #include <numa.h>
+    #include <sched.h>
+#endif
+
+#include "hash_table8.hpp"
+
+#ifndef EMH_NUMA_MAX_NODES
+    #define EMH_NUMA_MAX_NODES 64
+#endif
+#ifndef EMH_NUMA_MIN_BYTES
+    #define EMH_NUMA_MIN_BYTES (1 << 16)  //smaller blocks come from malloc, numa_alloc maps pages
+#endif
+
+namespace emnuma {
+
+/// numa nodes of the machine, 1 without libnuma
+inline int nodes()
+{
+#if EMH_NUMA
+    static const int n = numa_available() < 0 ? 1 : std::max(1, std::min(numa_num_configured_nodes(), EMH_NUMA_MAX_NODES));
+    return n;
+#else
+    return 1;
+#endif
+}
+
+inline int& thread_node()
+{
+    static thread_local int node = -1;
+    return node;
+}
+
+/// node of the cpu the calling thread runs on, looked up on the first call of the thread:
+/// pin threads, or rebind_thread() after moving one
+inline int current_node()
+{
+    auto& node = thread_node();
+    if (EMH_UNLIKELY(node < 0)) {
+        node = 0;
+#if EMH_NUMA
+        if (nodes() > 1) {
+            const auto cpu = sched_getcpu();
+            const auto n = cpu < 0 ? 0 : numa_node_of_cpu(cpu);
+            node = n < 0 ? 0 : n % nodes();
+        }
+#endif
+    }
+    return node;
+}
+
+inline void rebind_thread() { thread_node() = -1; }
+
+inline int& target_node()
+{
+    static thread_local int node = -1;
+    return node;
+}
+
+/// blocks NodeAllocator hands out on this thread go to node until the scope ends
+class NodeScope
+{
+public:
+    explicit NodeScope(int node) : _prev(target_node()) { target_node() = node; }
+    NodeScope(const NodeScope&) = delete;
+    NodeScope& operator=(const NodeScope&) = delete;
+    ~NodeScope() { target_node() = _prev; }
+
+private:
+    int _prev;
+};
+
+inline std::atomic<uint64_t>* node_bytes()
+{
+    static std::atomic<uint64_t> bytes[EMH_NUMA_MAX_NODES];
+    return bytes;
+}
+
+/// bytes NodeAllocator holds on node, all maps together
+inline uint64_t allocated(int node) { return node_bytes()[node].load(std::memory_order_relaxed); }
+
+/// emhash8 policy allocator: a block remembers its size and node in a header in front of it,
+/// so deallocate() needs no size and a block freed on any thread goes back where it came from
+struct NodeAllocator
+{
+    static void* allocate(size_t bytes)
+    {
+        const auto node = target_node() < 0 ? 0 : target_node();
+        const auto total = bytes + sizeof(Header);
+        void* base = nullptr;
+        bool mapped = false;
+#if EMH_NUMA
+        if (target_node() >= 0 && nodes() > 1 && total >= EMH_NUMA_MIN_BYTES) {
+            base = numa_alloc_onnode(total, node);
+            mapped = base != nullptr;
+        }
+#endif
+        if (!base)
+            base = aligned_malloc(total);
+        if (!base)
+            return nullptr;
+
+        auto header = (Header*)base;
+        header->bytes  = total;
+        header->node   = node;
+        header->mapped = mapped;
+        node_bytes()[node].fetch_add(total, std::memory_order_relaxed);
+        return header + 1;
+    }
+
+    static void deallocate(void* ptr)
+    {
+        if (!ptr)
+            return;
+        auto header = (Header*)ptr - 1;
+        node_bytes()[header->node].fetch_sub(header->bytes, std::memory_order_relaxed);
+#if EMH_NUMA
+        if (header->mapped) {
+            numa_free(header, header->bytes);
+            return;
+        }
+#endif
+        aligned_free(header);
+    }
+
+private:
+    //a cache line, so the table behind it starts on one as well: numa_alloc_onnode
+    //hands out pages, the fallback asks for cache line alignment
+    struct alignas(64) Header
+    {
+        size_t   bytes;
+        int      node;
+        bool     mapped; //numa_alloc_onnode, else aligned_malloc
+    };
+
+    static void* aligned_malloc(size_t bytes)
+    {
+#if _WIN32
+        return _aligned_malloc(bytes, alignof(Header));
+#else
+        void* ptr = nullptr;
+        return posix_memalign(&ptr, alignof(Header), bytes) == 0 ? ptr : nullptr;
+#endif
+    }
+
+    static void aligned_free(void* ptr)
+    {
+#if _WIN32
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+};
+
+}
+
+namespace emhash8 {
+
+struct NumaPolicy : DefaultPolicy
+{
+    using allocator = emnuma::NodeAllocator;
+};
+
+template <typename KeyT, typename ValueT, typename HashT = Hash<KeyT>, typename EqT = EqualTo<KeyT>>
+class NumaMap
+{
+public:
+    using shard_type = HashMap<KeyT, ValueT, HashT, EqT, NumaPolicy>;
+    using size_type  = typename shard_type::size_type;
+
+    enum Mode { PARTITIONED, REPLICATED };
+
+    /// per node counters of stats()
+    struct NodeStats
+    {
+        uint32_t shards;
+        uint64_t entries;
+        uint64_t bytes;          //emnuma::allocated(node), every NodeAllocator map
+        uint64_t local_lookups;  //count_lookups only
+        uint64_t remote_lookups;
+    };
+
+    /// shards_per_node is ignored for REPLICATED, which keeps one copy per node
+    explicit NumaMap(Mode mode = PARTITIONED, uint32_t shards_per_node = 4, bool count_lookups = false)
+        : _mode(mode), _nodes(emnuma::nodes()), _count(count_lookups), _lookups(new Counter[_nodes])
+    {
+        const auto shards = mode == REPLICATED ? (uint32_t)_nodes : _nodes * std::max(1u, shards_per_node);
+        _shards.reserve(shards);
+        for (uint32_t s = 0; s < shards; s++) {
+            const auto node = (int)(s % _nodes);
+            emnuma::NodeScope scope(node);
+            _shards.emplace_back(node);
+        }
+    }
+
+    NumaMap(const NumaMap&) = delete;
+    NumaMap& operator=(const NumaMap&) = delete;
+
+    Mode mode() const { return _mode; }
+    size_t shard_count() const { return _shards.size(); }
+    int shard_node(size_t s) const { return _shards[s].node; }
+    const shard_type& shard(size_t s) const { return _shards[s].map; }
+
+    /// shard that holds key in PARTITIONED mode
+    size_t shard_of(const KeyT& key) const { return route(_shards[0].map.hash_of(key)); }
+
+    size_t size() const { return _mode == REPLICATED ? _shards[0].map.size() : sum_sizes(); }
+    bool empty() const { return size() == 0; }
+
+    // ---------------- reads ----------------
+
+    bool try_get(const KeyT& key, ValueT& val) const
+    {
+        const auto key_hash = _shards[0].map.hash_of(key);
+        const auto& map = read(key_hash);
+        const auto it = map.find_hash(key, key_hash);
+        if (it == map.end())
+            return false;
+        val = it->second;
+        return true;
+    }
+
+    bool contains(const KeyT& key) const
+    {
+        const auto key_hash = _shards[0].map.hash_of(key);
+        const auto& map = read(key_hash);
+        return map.find_hash(key, key_hash) != map.end();
+    }
+
+    size_type count(const KeyT& key) const { return contains(key) ? 1 : 0; }
+
+    /// fn(key, value) for every entry, once even when replicated
+    template<typename F>
+    void for_each(const F& fn) const
+    {
+        const auto shards = _mode == REPLICATED ? 1 : _shards.size();
+        for (size_t s = 0; s < shards; s++)
+            for (const auto& kv : _shards[s].map)
+                fn(kv.first, kv.second);
+    }
+
+    // ---------------- writes ----------------
+
+    /// true when key was new
+    bool insert(const KeyT& key, const ValueT& val)
+    {
+        return write(key, [&](shard_type& map) { return map.try_emplace(key, val).second; });
+    }
+
+    bool insert_or_assign(const KeyT& key, const ValueT& val)
+    {
+        return write(key, [&](shard_type& map) { return map.insert_or_assign(key, ValueT(val)).second; });
+    }
+
+    size_type erase(const KeyT& key)
+    {
+        return write(key, [&](shard_type& map) { return map.erase(key); });
+    }
+
+    /// room for n keys in all, split over the shards of one copy
+    void reserve(size_t n)
+    {
+        const auto per = _mode == REPLICATED ? n : n / _shards.size() + 1;
+        for (auto& shard : _shards) {
+            emnuma::NodeScope scope(shard.node);
+            shard.map.reserve((size_type)per);
+        }
+    }
+
+    void clear()
+    {
+        for (auto& shard : _shards)
+            shard.map.clear();
+    }
+
+    // ---------------- placement ----------------
+
+    std::vector<NodeStats> stats() const
+    {
+        std::vector<NodeStats> out(_nodes);
+        for (const auto& shard : _shards) {
+            auto& st = out[shard.node];
+            st.shards ++;
+            st.entries += shard.map.size();
+        }
+        for (int n = 0; n < _nodes; n++) {
+            out[n].bytes = emnuma::allocated(n);
+            out[n].local_lookups  = _lookups[n].local.load(std::memory_order_relaxed);
+            out[n].remote_lookups = _lookups[n].remote.load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+private:
+    struct Shard
+    {
+        explicit Shard(int n) : node(n) {}
+        shard_type map;
+        int        node;
+    };
+
+    struct alignas(64) Counter
+    {
+        std::atomic<uint64_t> local{0};
+        std::atomic<uint64_t> remote{0};
+    };
+
+    //top bits after a fibonacci mix, the shards index with the low ones
+    size_t route(uint64_t key_hash) const
+    {
+        const auto mixed = (key_hash * UINT64_C(0x9E3779B97F4A7C15)) >> 32;
+        return (size_t)((mixed * _shards.size()) >> 32);
+    }
+
+    //one hash picks the shard and finds the key in it
+    const shard_type& read(uint64_t key_hash) const
+    {
+        const auto node = emnuma::current_node();
+        const auto& shard = _mode == REPLICATED ? _shards[node] : _shards[route(key_hash)];
+        if (_count) {
+            auto& c = _lookups[node];
+            (shard.node == node ? c.local : c.remote).fetch_add(1, std::memory_order_relaxed);
+        }
+        return shard.map;
+    }
+
+    //replicated writes go to every copy and report what the first one saw
+    template<typename F>
+    auto write(const KeyT& key, const F& f) -> decltype(f(std::declval<shard_type&>()))
+    {
+        if (_mode == PARTITIONED) {
+            auto& shard = _shards[shard_of(key)];
+            emnuma::NodeScope scope(shard.node);
+            return f(shard.map);
+        }
+
+        decltype(f(std::declval<shard_type&>())) ret{};
+        for (size_t s = 0; s < _shards.size(); s++) {
+            emnuma::NodeScope scope(_shards[s].node);
+            const auto r = f(_shards[s].map);
+            if (s == 0)
+                ret = r;
+        }
+        return ret;
+    }
+
+    size_t sum_sizes() const
+    {
+        size_t n = 0;
+        for (const auto& shard : _shards)
+            n += shard.map.size();
+        return n;
+    }
+
+    Mode                       _mode;
+    int                        _nodes;
+    bool                       _count;
+    std::unique_ptr<Counter[]> _lookups;
+    std::vector<Shard>         _shards;
+};
+
+}
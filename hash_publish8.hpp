@@ -0,0 +1,222 @@
+// emhash8::Published read mostly snapshot maps with epoch reclamation for C++11/14/17
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+// a published map is immutable: readers pin an epoch, load the current version and use
+// it as a plain const map, no retry and no lock (wait free). the writer keeps two
+// versions, the published one and the one it replaced (double buffer). publish(batch)
+// brings the old version up to date by replaying the previous batch on it, applies the
+// new batch and swaps it in, so a small update on a huge map touches the batch, not the
+// map, and reuses the old version's memory. the replay waits for readers still pinned
+// on the old version; publish() falls back to a full copy rather than wait when asked.
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash_table8.hpp"
+#include "hash_epoch.hpp"
+
+namespace emhash8 {
+
+template <typename MapT>
+class Published
+{
+public:
+    using map_type    = MapT;
+    using key_type    = typename std::remove_const<typename MapT::value_type::first_type>::type;
+    using mapped_type = typename MapT::value_type::second_type;
+
+    /// batched updates, replayed in order
+    class Batch
+    {
+    public:
+        void insert_or_assign(const key_type& key, const mapped_type& val) { _ops.push_back({key, val, false}); }
+        void erase(const key_type& key) { _ops.push_back({key, mapped_type(), true}); }
+        void reserve(size_t n) { _ops.reserve(n); }
+        size_t size() const { return _ops.size(); }
+        bool empty() const { return _ops.empty(); }
+        void clear() { _ops.clear(); }
+
+    private:
+        friend class Published;
+        struct Op
+        {
+            key_type    key;
+            mapped_type val;
+            bool        erase;
+        };
+
+        void apply(MapT& map) const
+        {
+            for (const auto& op : _ops) {
+                if (op.erase)
+                    map.erase(op.key);
+                else
+                    map.insert_or_assign(op.key, mapped_type(op.val));
+            }
+        }
+
+        std::vector<Op> _ops;
+    };
+
+    explicit Published(MapT initial = MapT(), uint32_t max_readers = 128) : _domain(max_readers)
+    {
+        _current.store(new MapT(std::move(initial)), std::memory_order_release);
+    }
+
+    Published(const Published&) = delete;
+    Published& operator=(const Published&) = delete;
+
+    ~Published()
+    {
+        delete _current.load(std::memory_order_relaxed);
+        delete _spare;
+    }
+
+    class Reader;
+
+    /// a pinned, immutable version. keep it short: it holds back reuse of the version before it.
+    class Snapshot
+    {
+    public:
+        Snapshot(Snapshot&& rhs) noexcept : _guard(std::move(rhs._guard)), _map(rhs._map) {}
+        const MapT& operator*() const { return *_map; }
+        const MapT* operator->() const { return _map; }
+        const MapT* get() const { return _map; }
+
+    private:
+        friend class Reader;
+        Snapshot(emepoch::Domain::Reader& reader, const std::atomic<MapT*>& current)
+            : _guard(reader), _map(current.load(std::memory_order_acquire)) {}
+
+        emepoch::Domain::Guard _guard;
+        const MapT* _map;
+    };
+
+    /// one per reader thread, registers an epoch slot
+    class Reader
+    {
+    public:
+        explicit Reader(const Published& pub) : _pub(&pub), _reader(pub._domain) {}
+        bool valid() const { return _reader.valid(); }
+
+        Snapshot snapshot() { return Snapshot(_reader, _pub->_current); }
+
+    private:
+        const Published* _pub;
+        emepoch::Domain::Reader _reader;
+    };
+
+    Reader reader() const { return Reader(*this); }
+
+    // ---------------- writer side, serialized by a mutex ----------------
+
+    /// apply batch to a private version and publish it. the version replaced last time is
+    /// reused when its readers are gone: wait_spins > 0 yields that many times for them,
+    /// then the current version is copied instead. returns true when memory was reused.
+    bool publish(Batch batch, uint32_t wait_spins = 1000)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        auto* current = _current.load(std::memory_order_relaxed);
+        MapT* next = nullptr;
+        const auto reused = _spare && wait_quiescent(wait_spins);
+        if (reused) {
+            next = _spare;
+            _spare = nullptr;
+            _last.apply(*next);
+        } else {
+            delete_spare();
+            next = new MapT(*current);
+            _copies ++;
+        }
+
+        batch.apply(*next);
+        swap_in(next);
+        _last = std::move(batch);
+        _spare_valid = true;
+        return reused;
+    }
+
+    /// publish a map built from scratch (full config reload), the next batch copies it
+    void publish(MapT&& fresh)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        swap_in(new MapT(std::move(fresh)));
+        _last.clear();
+        _spare_valid = false;
+    }
+
+    /// writer side view of the published version
+    const MapT& current() const { return *_current.load(std::memory_order_acquire); }
+
+    uint64_t version() const { return _version; }
+    size_t copies() const { return _copies; }
+
+private:
+    void swap_in(MapT* next)
+    {
+        auto* old = _current.exchange(next, std::memory_order_acq_rel);
+        delete_spare();
+        _spare       = old;
+        _spare_epoch = _domain.advance();
+        _version ++;
+    }
+
+    //the epoch domain frees it once the readers still on it unpin
+    void delete_spare()
+    {
+        if (_spare)
+            _domain.retire(_spare);
+        _spare = nullptr;
+    }
+
+    bool wait_quiescent(uint32_t spins)
+    {
+        if (!_spare_valid)
+            return false;
+        for (uint32_t i = 0; !_domain.quiescent(_spare_epoch); i++) {
+            if (i >= spins)
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    std::atomic<MapT*>      _current;
+    MapT*                   _spare = nullptr;
+    uint64_t                _spare_epoch = 0;
+    bool                    _spare_valid = false;
+    Batch                   _last;
+    uint64_t                _version = 0;
+    size_t                  _copies = 0;
+    std::mutex              _writer;
+    mutable emepoch::Domain _domain;
+};
+
+}
@@ -49,6 +49,7 @@
 #include <cstdint>
 #include <functional>
 #include <iterator>
+#include <vector>
 
 #ifdef __has_include
     #if __has_include("wyhash.h")
@@ -94,6 +95,9 @@ public:
     typedef std::pair<KeyT, size_type> PairT;
     static constexpr bool bInCacheLine = sizeof(PairT) < 64 * 2 / 3;
     static constexpr float default_load_factor = 0.95f;
+#ifndef EMH_PARALLEL_RANGE
+    constexpr static uint32_t EMH_PARALLEL_RANGE   = 1 << 16; //least buckets per task of parallel_*()
+#endif
 
     typedef KeyT     value_type;
     typedef KeyT&    reference;
@@ -902,6 +906,80 @@ public:
         erase_bucket(it._bucket);
     }
 
+    /// fn(key) for every element, fixed ranges of buckets run as tasks of exec(n, task),
+    /// which calls task(0) .. task(n - 1) on any threads and returns when all are done
+    /// (emhash8::SerialExecutor, a thread pool). fn must not insert or erase.
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn) const
+    {
+        parallel_buckets(exec, [&](size_t, size_type bucket) { fn((const KeyT&)_pairs[bucket].first); });
+    }
+
+    /// combine(init, map(key)) over all elements: every range folds its own, then the
+    /// ranges are folded into init in bucket order, so any executor gives the same result
+    template<typename Exec, typename T, typename M, typename C>
+    T parallel_reduce(Exec&& exec, T init, M map, C combine) const
+    {
+        std::vector<T> parts(parallel_tasks(), init);
+        std::vector<uint8_t> used(parts.size(), 0);
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            T part = init;
+            bool any = false;
+            visit_buckets(first, last, [&](size_type bucket) {
+                part = any ? combine(std::move(part), map((const KeyT&)_pairs[bucket].first)) : map((const KeyT&)_pairs[bucket].first);
+                any = true;
+            });
+            if (any)
+                parts[task] = std::move(part), used[task] = 1;
+        });
+        for (size_t task = 0; task < parts.size(); task++) {
+            if (used[task])
+                init = combine(std::move(init), std::move(parts[task]));
+        }
+        return init;
+    }
+
+    /// erase_if() with pred run in parallel: pred only marks, then the calling thread sweeps
+    /// the marks once. an element pulled back into an erased bucket takes its mark along.
+    template<typename Exec, typename Pred>
+    size_type parallel_erase_if(Exec&& exec, Pred pred)
+    {
+        const auto old_size = size();
+        const size_type num_buckets = _num_buckets;
+        auto marks = (uint64_t*)calloc(num_buckets / 64 + 1, sizeof(uint64_t));
+        parallel_buckets(exec, [&](size_t, size_type bucket) {
+            if (pred((const KeyT&)_pairs[bucket].first))
+                marks[bucket / 64] |= 1ull << (bucket % 64);
+        });
+
+        //a refill from the collision tail (EMH_HIGH_LOAD) may land behind the sweep
+        for (bool rescan = true; rescan; ) {
+            rescan = false;
+            for (size_type word = 0; word <= num_buckets / 64; word++) {
+                for (size_type bit = 0; marks[word] != 0 && bit < 64; bit++) {
+                    const size_type bucket = word * 64 + bit;
+                    while (marks[word] >> bit & 1) {
+                        marks[word] ^= 1ull << bit;
+                        const auto ebucket = erase_bucket(bucket);
+                        if (ebucket != bucket && (marks[ebucket / 64] >> (ebucket % 64) & 1)) {
+                            marks[ebucket / 64] ^= 1ull << (ebucket % 64);
+                            marks[word] |= 1ull << bit;
+                        }
+#if EMH_HIGH_LOAD
+                        if (_pairs[ebucket].second != INACTIVE && (marks[_last_colls / 64] >> (_last_colls % 64) & 1)) {
+                            marks[_last_colls / 64] ^= 1ull << (_last_colls % 64);
+                            marks[ebucket / 64] |= 1ull << (ebucket % 64);
+                            rescan |= ebucket < bucket;
+                        }
+#endif
+                    }
+                }
+            }
+        }
+        free(marks);
+        return old_size - size();
+    }
+
     void clearkv()
     {
         for (size_type bucket = 0; _num_filled > 0; ++bucket) {
@@ -1075,6 +1153,37 @@ private:
         return INACTIVE;
     }
 
+    //fixed ranges of 64 buckets multiples (whole mask words), the same with every executor
+    size_t parallel_tasks() const { return ((size_t)_num_buckets + parallel_range() - 1) / parallel_range(); }
+    size_t parallel_range() const { return (std::max<size_t>(EMH_PARALLEL_RANGE, (size_t)_num_buckets / 256) + 63) / 64 * 64; }
+
+    template<typename F>
+    void visit_buckets(size_type first, size_type last, const F& f) const
+    {
+        for (auto bucket = first; bucket < last; bucket++) {
+            if (_pairs[bucket].second != INACTIVE)
+                f(bucket);
+        }
+    }
+
+    //f(task, first, last) for every range
+    template<typename Exec, typename F>
+    void parallel_ranges(Exec& exec, const F& f) const
+    {
+        const auto range = parallel_range(), num_buckets = (size_t)_num_buckets;
+        exec(parallel_tasks(), [&](size_t task) {
+            f(task, (size_type)(task * range), (size_type)std::min(num_buckets, (task + 1) * range));
+        });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_buckets(Exec& exec, const F& f) const
+    {
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            visit_buckets(first, last, [&](size_type bucket) { f(task, bucket); });
+        });
+    }
+
     //return the real erased bucket
     size_type erase_bucket(const size_type bucket)
     {
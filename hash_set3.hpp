@@ -48,6 +48,7 @@
 #include <cstdint>
 #include <functional>
 #include <iterator>
+#include <vector>
 
 #ifdef  EMH_KEY
     #undef  EMH_BUCKET
@@ -92,6 +93,9 @@ template <typename KeyT, typename HashT = std::hash<KeyT>, typename EqT = std::e
 class HashSet
 {
     constexpr static uint32_t INACTIVE = 0xFFFFFFFF;
+#ifndef EMH_PARALLEL_RANGE
+    constexpr static uint32_t EMH_PARALLEL_RANGE   = 1 << 16; //least buckets per task of parallel_*()
+#endif
 
 private:
     typedef  HashSet<KeyT, HashT, EqT> htype;
@@ -586,7 +590,7 @@ public:
             if (bucket_size == INACTIVE) {
                 new_key(key, main_bucket, main_bucket);
                 return { {this, main_bucket}, true };
-            } else if (_eq(key, EMH_KEY(_pairs, main_bucket)) && bucket_size % 2 > 0) {
+            } else if (bucket_size % 2 > 0 && _eq(key, EMH_KEY(_pairs, main_bucket))) {
                 return { {this, main_bucket}, false };
             } else if (bucket_size % 2 == 0) {
                 auto next_bucket = find_colls_bucket(key);
@@ -614,8 +618,9 @@ public:
     {
         auto& bucket_size = EMH_BUCKET(_pairs, main_bucket);
         if (bucket < _mains_buckets) {
-            bucket_size += 1 + bucket_size % 2;
-            new(_pairs + bucket) PairT(key, bucket_size);
+            //pass the word by value, constructing the pair ends the life of the old one
+            const uint32_t main_size = bucket_size + 1 + bucket_size % 2;
+            new(_pairs + bucket) PairT(key, main_size);
             _num_mains += 1;
         } else {
             bucket_size += 2;
@@ -643,12 +648,13 @@ public:
     {
         //assert (bucket_size % 2 > 0 && bucket_size != INACTIVE);
         //assert (main_bucket < _mains_buckets);
+        //destroy first: stores into the slot word before ~PairT() are dead to the compiler
+        _pairs[main_bucket].~PairT();
         bucket_size -= 1;
         _num_mains -= 1;
 
         if ((int)bucket_size == 0)
             bucket_size = INACTIVE;
-        _pairs[main_bucket].~PairT();
     }
 
 #if 0
@@ -753,9 +759,7 @@ public:
         if (bucket_size == INACTIVE) {
             new_key(key, main_bucket, main_bucket);
             return main_bucket;
-        } else if (_eq(key, EMH_KEY(_pairs, main_bucket))) {
-            if (bucket_size % 2 == 0)
-                new_key(key, main_bucket, main_bucket);
+        } else if (bucket_size % 2 > 0 && _eq(key, EMH_KEY(_pairs, main_bucket))) {
             return main_bucket;
         } else if (bucket_size % 2 == 0) {
             auto next_bucket = find_colls_bucket(key);
@@ -787,7 +791,7 @@ public:
             return 0;
 
         const auto& bucket_key = EMH_KEY(_pairs, main_bucket);
-        if (_eq(key, bucket_key) && bucket_size % 2 > 0) {
+        if (bucket_size % 2 > 0 && _eq(key, bucket_key)) {
             del_main(main_bucket, bucket_size);
             return 1;
         } else if (bucket_size <= 1)
@@ -826,6 +830,75 @@ public:
         return it;
     }
 
+    /// fn(key) for every element, fixed ranges of buckets run as tasks of exec(n, task),
+    /// which calls task(0) .. task(n - 1) on any threads and returns when all are done
+    /// (emhash8::SerialExecutor, a thread pool). fn must not insert or erase.
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn) const
+    {
+        parallel_buckets(exec, [&](size_t, uint32_t bucket) { fn((const KeyT&)EMH_KEY(_pairs, bucket)); });
+    }
+
+    /// combine(init, map(key)) over all elements: every range folds its own, then the
+    /// ranges are folded into init in bucket order, so any executor gives the same result
+    template<typename Exec, typename T, typename M, typename C>
+    T parallel_reduce(Exec&& exec, T init, M map, C combine) const
+    {
+        std::vector<T> parts(parallel_tasks(), init);
+        std::vector<uint8_t> used(parts.size(), 0);
+        parallel_ranges(exec, [&](size_t task, uint32_t first, uint32_t last) {
+            T part = init;
+            bool any = false;
+            visit_buckets(first, last, [&](uint32_t bucket) {
+                part = any ? combine(std::move(part), map((const KeyT&)EMH_KEY(_pairs, bucket))) : map((const KeyT&)EMH_KEY(_pairs, bucket));
+                any = true;
+            });
+            if (any)
+                parts[task] = std::move(part), used[task] = 1;
+        });
+        for (size_t task = 0; task < parts.size(); task++) {
+            if (used[task])
+                init = combine(std::move(init), std::move(parts[task]));
+        }
+        return init;
+    }
+
+    /// erase_if() with pred run in parallel: pred only marks, then the calling thread sweeps
+    /// the marks once. an element pulled back into an erased bucket takes its mark along.
+    template<typename Exec, typename Pred>
+    size_type parallel_erase_if(Exec&& exec, Pred pred)
+    {
+        const auto old_size = size();
+        const uint32_t num_buckets = _total_buckets;
+        auto marks = (uint64_t*)calloc(num_buckets / 64 + 1, sizeof(uint64_t));
+        parallel_buckets(exec, [&](size_t, uint32_t bucket) {
+            if (pred((const KeyT&)EMH_KEY(_pairs, bucket)))
+                marks[bucket / 64] |= 1ull << (bucket % 64);
+        });
+
+        for (uint32_t word = 0; word <= num_buckets / 64; word++) {
+            for (uint32_t bit = 0; marks[word] != 0 && bit < 64; bit++) {
+                const uint32_t bucket = word * 64 + bit;
+                while (marks[word] >> bit & 1) {
+                    marks[word] ^= 1ull << bit;
+                    uint32_t ebucket = bucket;
+                    if (bucket < _mains_buckets)
+                        del_main(bucket, EMH_BUCKET(_pairs, bucket));
+                    else {
+                        ebucket = erase_bucket(bucket);
+                        del_key(ebucket, EMH_KEY(_pairs, ebucket));
+                    }
+                    if (ebucket != bucket && (marks[ebucket / 64] >> (ebucket % 64) & 1)) {
+                        marks[ebucket / 64] ^= 1ull << (ebucket % 64);
+                        marks[word] |= 1ull << bit;
+                    }
+                }
+            }
+        }
+        free(marks);
+        return old_size - size();
+    }
+
     void clearkv()
     {
         for (uint32_t bucket = _mains_buckets; bucket < _total_buckets && _num_colls > 0; ++bucket) {
@@ -929,7 +1002,7 @@ public:
             next_bucket += 2;
 
             if (next_bucket == 1) {
-                new(_pairs + main_bucket) PairT(std::move(key), next_bucket); old_pair.~PairT();
+                new(_pairs + main_bucket) PairT(std::move(key), 1u); old_pair.~PairT();
                 _num_mains ++;
             } else {
                 const auto bucket = hash_coll_bucket(key);
@@ -1033,6 +1106,37 @@ private:
         return INACTIVE;
     }
 
+    //fixed ranges of 64 buckets multiples (whole mask words), the same with every executor
+    size_t parallel_tasks() const { return ((size_t)_total_buckets + parallel_range() - 1) / parallel_range(); }
+    size_t parallel_range() const { return (std::max<size_t>(EMH_PARALLEL_RANGE, (size_t)_total_buckets / 256) + 63) / 64 * 64; }
+
+    template<typename F>
+    void visit_buckets(uint32_t first, uint32_t last, const F& f) const
+    {
+        for (auto bucket = first; bucket < last; bucket++) {
+            if (EMH_BUCKET(_pairs, bucket) != INACTIVE && (bucket >= _mains_buckets || EMH_BUCKET(_pairs, bucket) % 2 > 0))
+                f(bucket);
+        }
+    }
+
+    //f(task, first, last) for every range
+    template<typename Exec, typename F>
+    void parallel_ranges(Exec& exec, const F& f) const
+    {
+        const auto range = parallel_range(), num_buckets = (size_t)_total_buckets;
+        exec(parallel_tasks(), [&](size_t task) {
+            f(task, (uint32_t)(task * range), (uint32_t)std::min(num_buckets, (task + 1) * range));
+        });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_buckets(Exec& exec, const F& f) const
+    {
+        parallel_ranges(exec, [&](size_t task, uint32_t first, uint32_t last) {
+            visit_buckets(first, last, [&](uint32_t bucket) { f(task, bucket); });
+        });
+    }
+
     uint32_t erase_bucket(const uint32_t bucket)
     {
         const auto next_bucket = EMH_BUCKET(_pairs, bucket);
@@ -1063,7 +1167,7 @@ private:
         {
             if (bucket_size == INACTIVE)
                 return _total_buckets;
-            else if (_eq(key, EMH_KEY(_pairs, main_bucket)) && bucket_size % 2 > 0)
+            else if (bucket_size % 2 > 0 && _eq(key, EMH_KEY(_pairs, main_bucket)))
                 return main_bucket;
             else if (bucket_size == 1)
                 return _total_buckets;
@@ -34,6 +34,7 @@
 #include <cstdint>
 #include <functional>
 #include <iterator>
+#include <vector>
 
 #ifdef __has_include
     #if __has_include("wyhash.h")
@@ -43,6 +44,10 @@
     #include "wyhash.h"
 #endif
 
+#if EMH_CPU_DISPATCH
+    #include "hash_cpu.hpp"
+#endif
+
 // likely/unlikely
 #if defined(__GNUC__) || defined(__INTEL_COMPILER) || defined(__clang__)
 #    define EMH_LIKELY(condition) __builtin_expect(condition, 1)
@@ -110,6 +115,9 @@ public:
     typedef  HashSet<KeyT, HashT, EqT> htype;
     typedef  std::pair<KeyT, uint32_t> PairT;
     static constexpr bool bInCacheLine = sizeof(PairT) < 64 * 2 / 3;
+#ifndef EMH_PARALLEL_RANGE
+    constexpr static uint32_t EMH_PARALLEL_RANGE   = 1 << 16; //least buckets per task of parallel_*()
+#endif
 
     typedef size_t   size_type;
     typedef KeyT     value_type;
@@ -204,9 +212,20 @@ public:
                 return;
             }
 
+#if EMH_CPU_DISPATCH
+            _bmask = ~*(size_t*)((size_t*)_set->_bitmask + (_from += SIZE_BIT) / SIZE_BIT);
+            if (_bmask == 0) {
+                //a run of empty words (sparse set), the sentinel word stops the scan
+                const auto word = _from / SIZE_BIT + 1;
+                const auto skip = emcpu::scan_ne((size_t*)_set->_bitmask + word, _set->_num_buckets / SIZE_BIT + 1 - word, ~(size_t)0);
+                _from = (size_type)((word + skip) * SIZE_BIT);
+                _bmask = ~*((size_t*)_set->_bitmask + word + skip);
+            }
+#else
             do
                 _bmask = ~*(size_t*)((size_t*)_set->_bitmask + (_from += SIZE_BIT) / SIZE_BIT);
             while (_bmask == 0);
+#endif
 
             _bucket = _from + CTZ(_bmask);
         }
@@ -290,9 +309,20 @@ public:
                 return;
             }
 
+#if EMH_CPU_DISPATCH
+            _bmask = ~*(size_t*)((size_t*)_set->_bitmask + (_from += SIZE_BIT) / SIZE_BIT);
+            if (_bmask == 0) {
+                //a run of empty words (sparse set), the sentinel word stops the scan
+                const auto word = _from / SIZE_BIT + 1;
+                const auto skip = emcpu::scan_ne((size_t*)_set->_bitmask + word, _set->_num_buckets / SIZE_BIT + 1 - word, ~(size_t)0);
+                _from = (size_type)((word + skip) * SIZE_BIT);
+                _bmask = ~*((size_t*)_set->_bitmask + word + skip);
+            }
+#else
             do
                 _bmask = ~*(size_t*)((size_t*)_set->_bitmask + (_from += SIZE_BIT) / SIZE_BIT);
             while (_bmask == 0);
+#endif
 
             _bucket = _from + CTZ(_bmask);
         }
@@ -892,6 +922,70 @@ public:
         clear_bucket(bucket);
     }
 
+    /// fn(key) for every element, fixed ranges of buckets run as tasks of exec(n, task),
+    /// which calls task(0) .. task(n - 1) on any threads and returns when all are done
+    /// (emhash8::SerialExecutor, a thread pool). fn must not insert or erase.
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn) const
+    {
+        parallel_buckets(exec, [&](size_t, uint32_t bucket) { fn((const KeyT&)_pairs[bucket].first); });
+    }
+
+    /// combine(init, map(key)) over all elements: every range folds its own, then the
+    /// ranges are folded into init in bucket order, so any executor gives the same result
+    template<typename Exec, typename T, typename M, typename C>
+    T parallel_reduce(Exec&& exec, T init, M map, C combine) const
+    {
+        std::vector<T> parts(parallel_tasks(), init);
+        std::vector<uint8_t> used(parts.size(), 0);
+        parallel_ranges(exec, [&](size_t task, uint32_t first, uint32_t last) {
+            T part = init;
+            bool any = false;
+            visit_buckets(first, last, [&](uint32_t bucket) {
+                part = any ? combine(std::move(part), map((const KeyT&)_pairs[bucket].first)) : map((const KeyT&)_pairs[bucket].first);
+                any = true;
+            });
+            if (any)
+                parts[task] = std::move(part), used[task] = 1;
+        });
+        for (size_t task = 0; task < parts.size(); task++) {
+            if (used[task])
+                init = combine(std::move(init), std::move(parts[task]));
+        }
+        return init;
+    }
+
+    /// erase_if() with pred run in parallel: pred only marks, then the calling thread sweeps
+    /// the marks once. an element pulled back into an erased bucket takes its mark along.
+    template<typename Exec, typename Pred>
+    size_type parallel_erase_if(Exec&& exec, Pred pred)
+    {
+        const auto old_size = size();
+        const uint32_t num_buckets = _num_buckets;
+        auto marks = (uint64_t*)calloc(num_buckets / 64 + 1, sizeof(uint64_t));
+        parallel_buckets(exec, [&](size_t, uint32_t bucket) {
+            if (pred((const KeyT&)_pairs[bucket].first))
+                marks[bucket / 64] |= 1ull << (bucket % 64);
+        });
+
+        for (uint32_t word = 0; word <= num_buckets / 64; word++) {
+            for (uint32_t bit = 0; marks[word] != 0 && bit < 64; bit++) {
+                const uint32_t bucket = word * 64 + bit;
+                while (marks[word] >> bit & 1) {
+                    marks[word] ^= 1ull << bit;
+                    const auto ebucket = erase_bucket(bucket);
+                    clear_bucket(ebucket);
+                    if (ebucket != bucket && (marks[ebucket / 64] >> (ebucket % 64) & 1)) {
+                        marks[ebucket / 64] ^= 1ull << (ebucket % 64);
+                        marks[word] |= 1ull << bit;
+                    }
+                }
+            }
+        }
+        free(marks);
+        return old_size - size();
+    }
+
     static constexpr bool isno_triviall_destructable()
     {
 #if __cplusplus > 201103L || _MSC_VER > 1600 || __clang__
@@ -1051,6 +1145,37 @@ private:
         return INACTIVE;
     }
 
+    //fixed ranges of 64 buckets multiples (whole mask words), the same with every executor
+    size_t parallel_tasks() const { return ((size_t)_num_buckets + parallel_range() - 1) / parallel_range(); }
+    size_t parallel_range() const { return (std::max<size_t>(EMH_PARALLEL_RANGE, (size_t)_num_buckets / 256) + 63) / 64 * 64; }
+
+    template<typename F>
+    void visit_buckets(uint32_t first, uint32_t last, const F& f) const
+    {
+        for (auto bucket = first; bucket < last; bucket++) {
+            if (_pairs[bucket].second != INACTIVE)
+                f(bucket);
+        }
+    }
+
+    //f(task, first, last) for every range
+    template<typename Exec, typename F>
+    void parallel_ranges(Exec& exec, const F& f) const
+    {
+        const auto range = parallel_range(), num_buckets = (size_t)_num_buckets;
+        exec(parallel_tasks(), [&](size_t task) {
+            f(task, (uint32_t)(task * range), (uint32_t)std::min(num_buckets, (task + 1) * range));
+        });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_buckets(Exec& exec, const F& f) const
+    {
+        parallel_ranges(exec, [&](size_t task, uint32_t first, uint32_t last) {
+            visit_buckets(first, last, [&](uint32_t bucket) { f(task, bucket); });
+        });
+    }
+
     uint32_t erase_bucket(const uint32_t bucket)
     {
         const auto next_bucket = _pairs[bucket].second;
@@ -35,6 +35,7 @@
 #include <functional>
 #include <iterator>
 #include <algorithm>
+#include <vector>
 
 #ifdef EMH_KEY
     #undef  EMH_KEY
@@ -42,6 +43,8 @@
     #undef  EMH_NEW
     #undef  EMH_EMPTY
     #undef  EMH_PREVET
+    #undef  EMH_KEYMASK
+    #undef  EMH_EQHASH
 #endif
 
 // likely/unlikely
@@ -73,17 +76,20 @@ constexpr uint32_t INACTIVE = 0xAAAAAAAA;
 constexpr uint32_t END      = 0-0x1u;
 constexpr uint32_t EAD      = 2;
 
+/// A cache-friendly hash table with open addressing, linear/quadratic probing and power-of-two capacity
+template <typename KeyT, typename HashT = std::hash<KeyT>, typename EqT = std::equal_to<KeyT>>
+class HashSet
+{
 #ifndef EMH_DEFAULT_LOAD_FACTOR
     constexpr static float EMH_DEFAULT_LOAD_FACTOR = 0.80f;
 #endif
 #if EMH_CACHE_LINE_SIZE < 32
     constexpr static uint32_t EMH_CACHE_LINE_SIZE  = 64;
 #endif
+#ifndef EMH_PARALLEL_RANGE
+    constexpr static uint32_t EMH_PARALLEL_RANGE   = 1 << 16; //least slots per task of parallel_*()
+#endif
 
-/// A cache-friendly hash table with open addressing, linear/quadratic probing and power-of-two capacity
-template <typename KeyT, typename HashT = std::hash<KeyT>, typename EqT = std::equal_to<KeyT>>
-class HashSet
-{
 public:
     using htype = HashSet<KeyT, HashT, EqT>;
     using value_type = KeyT;
@@ -803,7 +809,7 @@ public:
     void shrink_to_fit(const float min_factor = EMH_DEFAULT_LOAD_FACTOR / 4)
     {
         if (load_factor() < min_factor && bucket_count() > 10) //safe guard
-            rehash(_num_filled);
+            rehash((_num_filled * (uint64_t)_mlf >> 27) + 2); //_pairs only holds bucket_count() * max_load_factor()
     }
 
     /// Make room for this many elements
@@ -952,7 +958,102 @@ public:
 #endif
     }
 
+    /// fn(key) for every key, fixed ranges of slots run as tasks of exec(n, task), which
+    /// calls task(0) .. task(n - 1) on any threads and returns when all are done
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn) const
+    {
+        parallel_slots(exec, [&](size_t, size_type slot) { fn(_pairs[slot]); });
+    }
+
+    /// combine(init, map(key)) over all keys, the ranges folded into init in slot order
+    template<typename Exec, typename T, typename M, typename C>
+    T parallel_reduce(Exec&& exec, T init, M map, C combine) const
+    {
+        std::vector<T> parts(parallel_tasks(), init);
+        std::vector<uint8_t> used(parts.size(), 0);
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            T part = map(_pairs[first]);
+            for (auto slot = first + 1; slot < last; slot++)
+                part = combine(std::move(part), map(_pairs[slot]));
+            parts[task] = std::move(part), used[task] = 1;
+        });
+        for (size_t task = 0; task < parts.size(); task++) {
+            if (used[task])
+                init = combine(std::move(init), std::move(parts[task]));
+        }
+        return init;
+    }
+
+    /// pred marks in parallel, then a few victims are erased from the tail down, or past a
+    /// quarter of the set the keys are compacted in one pass and the index is rebuilt
+    template<typename Exec, typename Pred>
+    size_type parallel_erase_if(Exec&& exec, Pred pred)
+    {
+        auto marks = (uint64_t*)calloc(_num_filled / 64 + 1, sizeof(uint64_t));
+        std::vector<size_type> victims(parallel_tasks(), 0);
+        parallel_slots(exec, [&](size_t task, size_type slot) {
+            if (pred(_pairs[slot])) {
+                marks[slot / 64] |= 1ull << (slot % 64);
+                victims[task] ++;
+            }
+        });
+
+        size_type erased = 0;
+        for (auto n : victims) erased += n;
+        if (erased > _num_filled / 4) {
+            size_type keep = 0;
+            for (size_type slot = 0; slot < _num_filled; slot++) {
+                if (marks[slot / 64] >> (slot % 64) & 1)
+                    continue;
+                else if (keep != slot)
+                    EMH_KEY(_pairs, keep) = std::move(EMH_KEY(_pairs, slot));
+                keep ++;
+            }
+            if (is_triviall_destructable()) {
+                for (auto slot = keep; slot < _num_filled; slot++)
+                    _pairs[slot].~value_type();
+            }
+            _num_filled = keep;
+            rehash(_mask + 1);
+        } else if (erased > 0) {
+            for (auto slot = _num_filled; slot-- > 0; ) {
+                if (marks[slot / 64] >> (slot % 64) & 1) {
+                    size_type main_bucket;
+                    const auto sbucket = find_slot_bucket(slot, main_bucket);
+                    erase_slot(sbucket, main_bucket);
+                }
+            }
+        }
+        free(marks);
+        return erased;
+    }
+
 private:
+    //fixed ranges of 64 slots multiples, the same with every executor
+    size_t parallel_tasks() const { return (_num_filled + parallel_range() - 1) / parallel_range(); }
+    size_type parallel_range() const { return (std::max<size_type>(EMH_PARALLEL_RANGE, _num_filled / 256) + 63) / 64 * 64; }
+
+    //f(task, first, last) for every range, never empty
+    template<typename Exec, typename F>
+    void parallel_ranges(Exec& exec, const F& f) const
+    {
+        const auto range = parallel_range();
+        exec(parallel_tasks(), [&](size_t task) {
+            const auto first = (size_type)task * range;
+            f(task, first, std::min<size_type>(_num_filled, first + range));
+        });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_slots(Exec& exec, const F& f) const
+    {
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            for (auto slot = first; slot < last; slot++)
+                f(task, slot);
+        });
+    }
+
     // Can we fit another element?
     inline bool check_expand_need()
     {
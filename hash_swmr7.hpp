@@ -0,0 +1,321 @@
+// emhash7::SwmrMap single writer, lock free readers over emhash7::HashMap for C++11/14/17
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2019-2022 Huang Yuanbing & bailuzhou AT 163.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+// read mostly maps: one writer thread (a few hundred updates/s) and many readers that
+// never lock. an emhash7 chain lives in its main bucket and in buckets only it links to,
+// and an insert or erase rewrites at most two chains: the key's own and the chain of an
+// entry kicked out of the key's main bucket, plus the empty bucket an insert fills (the
+// main bucket of keys not in the table yet). every bucket maps to a stripe version; the
+// writer makes the stripes of those up to three buckets odd, edits the table in place,
+// then even. a reader copies the value out and retries if its stripe was odd or moved,
+// its walk never leaves the table even over half written links.
+// size() is a copy the writer keeps, the table's own count is not read by readers.
+// growing never happens in place: the writer builds a bigger table, publishes it with an
+// atomic pointer swap and retires the old one to an emepoch::Domain, readers pin the
+// epoch while they hold a table pointer.
+// keys and values must be trivially copyable, a torn copy is thrown away, never used.
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "hash_table7.hpp"
+#include "hash_epoch.hpp"
+
+#ifndef EMH_SWMR_STRIPES
+    #define EMH_SWMR_STRIPES 1024
+#endif
+
+namespace emhash7 {
+
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>, typename EqT = std::equal_to<KeyT>>
+class SwmrMap
+{
+    static_assert(std::is_trivially_copyable<KeyT>::value && std::is_trivially_copyable<ValueT>::value,
+                  "SwmrMap readers copy entries while they may change");
+    static_assert((EMH_SWMR_STRIPES & (EMH_SWMR_STRIPES - 1)) == 0, "EMH_SWMR_STRIPES is a power of two");
+
+public:
+    using Table     = HashMap<KeyT, ValueT, HashT, EqT>;
+    using size_type = emhash7::size_type;
+
+    explicit SwmrMap(size_type bucket = 16, uint32_t max_readers = 128, float mlf = 0.80f)
+        : _domain(max_readers), _mlf(mlf)
+    {
+        auto* table = new Table(bucket, mlf);
+        _table.store(table, std::memory_order_relaxed);
+        for (auto& v : _stripes)
+            v.store(0, std::memory_order_relaxed);
+    }
+
+    SwmrMap(const SwmrMap&) = delete;
+    SwmrMap& operator=(const SwmrMap&) = delete;
+
+    ~SwmrMap() { delete _table.load(std::memory_order_relaxed); }
+
+    /// one per reader thread, registers an epoch slot
+    class Reader
+    {
+    public:
+        explicit Reader(const SwmrMap& map) : _map(&map), _reader(map._domain) {}
+
+        /// false when all max_readers slots are taken
+        bool valid() const { return _reader.valid(); }
+
+        /// copy the value of key to val. pins the epoch for the call unless a Guard is held.
+        bool find(const KeyT& key, ValueT& val)
+        {
+            if (EMH_LIKELY(_reader.pinned()))
+                return _map->read(key, val);
+            emepoch::Domain::Guard guard(_reader);
+            return _map->read(key, val);
+        }
+
+        bool contains(const KeyT& key)
+        {
+            ValueT val;
+            return find(key, val);
+        }
+
+        /// pin once for a batch of lookups: find() inside skips the fence
+        emepoch::Domain::Guard pin() { return emepoch::Domain::Guard(_reader); }
+
+    private:
+        const SwmrMap* _map;
+        emepoch::Domain::Reader _reader;
+    };
+
+    Reader reader() const { return Reader(*this); }
+
+    // ---------------- writer side, serialized by a mutex ----------------
+
+    /// true when key was new
+    bool insert_or_assign(const KeyT& key, const ValueT& val)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        auto* table = _table.load(std::memory_order_relaxed);
+        auto it = table->find(key);
+        if (it == table->end())
+            return insert_new(table, key, val);
+
+        Touched touched;
+        touched.add(table->main_bucket(key));
+        write_begin(touched);
+        it->second = val;
+        write_end(touched);
+        return false;
+    }
+
+    /// false and no change when key exists
+    bool insert(const KeyT& key, const ValueT& val)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        auto* table = _table.load(std::memory_order_relaxed);
+        if (table->contains(key))
+            return false;
+        return insert_new(table, key, val);
+    }
+
+    /// erase only relinks the chain of key
+    size_type erase(const KeyT& key)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        auto* table = _table.load(std::memory_order_relaxed);
+        if (!table->contains(key))
+            return 0;
+
+        Touched touched;
+        touched.add(table->main_bucket(key));
+        write_begin(touched);
+        const auto erased = table->erase(key);
+        write_end(touched);
+        _size.store(table->size(), std::memory_order_relaxed);
+        return erased;
+    }
+
+    /// publishes an empty table, readers still holding the old one finish on it
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        publish(new Table(16, _mlf));
+    }
+
+    /// publishes a table sized for num_elems if the current one is smaller
+    void reserve(size_type num_elems)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        auto* table = _table.load(std::memory_order_relaxed);
+        if (num_elems >= table->bucket_count() * _mlf)
+            publish(rebuild(table, num_elems));
+    }
+
+    /// writer side read, no retry needed
+    template<typename F>
+    void for_each(F f) const
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        for (const auto& kv : *_table.load(std::memory_order_relaxed))
+            f(kv.first, kv.second);
+    }
+
+    /// safe from any thread: a copy of the writer's count, never the table's own
+    size_type size() const { return _size.load(std::memory_order_relaxed); }
+    size_type bucket_count() const { return _table.load(std::memory_order_acquire)->bucket_count(); }
+
+    /// tables published by growth/clear, retired tables not yet freed, reads that retried
+    size_type publish_count() const { return _publish; }
+    size_t pending_reclaim() const { return _domain.pending(); }
+    size_t read_retries() const { return _retries.load(std::memory_order_relaxed); }
+
+    /// writer: free retired tables no reader can see any more
+    size_t collect()
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+        return _domain.collect();
+    }
+
+private:
+    inline std::atomic<uint32_t>& stripe(size_type bucket) const { return _stripes[bucket & (EMH_SWMR_STRIPES - 1)]; }
+
+    //caller holds an epoch pin, so the table can not be freed under us
+    bool read(const KeyT& key, ValueT& val) const
+    {
+        for (uint32_t spin = 0; ; spin++) {
+            const auto* table = _table.load(std::memory_order_acquire);
+            const auto bucket = table->main_bucket(key);
+            auto& version = stripe(bucket);
+            const auto v1 = version.load(std::memory_order_acquire);
+            if (EMH_UNLIKELY(v1 & 1)) {
+                backoff(spin);
+                continue;
+            }
+
+            const auto found = table->find_racy(key, bucket, val);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (EMH_LIKELY(version.load(std::memory_order_relaxed) == v1))
+                return found;
+            _retries.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static void backoff(uint32_t spin)
+    {
+        if (spin > 64)
+            std::this_thread::yield();
+    }
+
+    //distinct stripes of the buckets one write touches
+    struct Touched
+    {
+        size_type stripe[3];
+        int n = 0;
+
+        void add(size_type bucket)
+        {
+            bucket &= EMH_SWMR_STRIPES - 1;
+            for (int i = 0; i < n; i++)
+                if (stripe[i] == bucket)
+                    return;
+            stripe[n++] = bucket;
+        }
+    };
+
+    void write_begin(const Touched& touched)
+    {
+        for (int i = 0; i < touched.n; i++)
+            _stripes[touched.stripe[i]].fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void write_end(const Touched& touched)
+    {
+        for (int i = 0; i < touched.n; i++)
+            _stripes[touched.stripe[i]].fetch_add(1, std::memory_order_release);
+        if (EMH_UNLIKELY(_domain.pending() != 0))
+            _domain.collect();
+    }
+
+    //key is not in table: the table picks its buckets, their stripes go odd before it writes
+    bool insert_new(Table* table, const KeyT& key, const ValueT& val)
+    {
+        if (need_grow(table))
+            return grow_insert(table, key, val);
+
+        Touched touched;
+        table->insert_unique_racy(key, val, [&](size_type bucket, size_type kicked, size_type fill) {
+            touched.add(bucket);
+            touched.add(kicked);
+            touched.add(fill);
+            write_begin(touched);
+        });
+        write_end(touched);
+        _size.store(table->size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    //one insert away from emhash7 rehashing in place (reserve() grows at size >= buckets * mlf)
+    bool need_grow(const Table* table) const
+    {
+        return table->size() + 2 >= table->bucket_count() * table->max_load_factor();
+    }
+
+    Table* rebuild(const Table* table, size_type num_elems) const
+    {
+        auto* next = new Table(16, _mlf);
+        next->reserve(num_elems);
+        for (const auto& kv : *table)
+            next->insert_unique(kv.first, kv.second);
+        return next;
+    }
+
+    bool grow_insert(const Table* table, const KeyT& key, const ValueT& val)
+    {
+        auto* next = rebuild(table, table->size() * 2 + 2);
+        const auto inserted = next->insert_or_assign(key, ValueT(val)).second;
+        publish(next);
+        return inserted;
+    }
+
+    void publish(Table* next)
+    {
+        auto* old = _table.exchange(next, std::memory_order_acq_rel);
+        _size.store(next->size(), std::memory_order_relaxed);
+        _publish ++;
+        _domain.retire(old);
+    }
+
+    std::atomic<Table*>           _table;
+    mutable std::atomic<uint32_t> _stripes[EMH_SWMR_STRIPES];
+    mutable std::atomic<size_t>   _retries{0};
+    std::atomic<size_type>        _size{0};
+    mutable std::mutex            _writer;
+    mutable emepoch::Domain       _domain;
+    float                         _mlf;
+    size_type                     _publish = 0;
+};
+
+}
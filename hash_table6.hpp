@@ -37,11 +37,18 @@
 #include <functional>
 #include <iterator>
 #include <algorithm>
+#include <vector>
+#include <random>
+#include <chrono>
 
 #if EMH_WY_HASH
     #include "wyhash.h"
 #endif
 
+#if EMH_CPU_DISPATCH
+    #include "hash_cpu.hpp"
+#endif
+
 #ifdef EMH_KEY
     #undef  EMH_KEY
     #undef  EMH_VAL
@@ -156,6 +163,25 @@ static size_type CTZ(size_t n)
     return (size_type)index;
 }
 
+/// table health snapshot returned by HashMap::stats(), probes are counted in visited buckets
+struct HashStats
+{
+    constexpr static uint32_t CHAIN_SLOTS = 16;
+
+    uint64_t size;           //number of elements
+    uint64_t buckets;        //bucket_count()
+    uint64_t sampled;        //buckets walked, less than buckets in sampled mode
+    float    load_factor;
+    float    main_ratio;     //occupied buckets holding an element in its main bucket
+    float    avg_hit_probe;  //successful find
+    float    avg_miss_probe; //unsuccessful find with a uniform hash: a chain head costs its chain, other buckets 1
+    float    avg_link_dist;  //buckets between neighbours of a chain, the distance the empty bucket search went
+    uint32_t max_hit_probe;  //longest chain
+    uint32_t max_miss_probe;
+    uint32_t max_link_dist;
+    uint64_t chain_len[CHAIN_SLOTS]; //chains by length, the last slot counts all longer ones
+};
+
 template <typename First, typename Second>
 struct entry {
     using first_type =  First;
@@ -227,6 +253,15 @@ class HashMap
     constexpr static float EMH_DEFAULT_LOAD_FACTOR = 0.80f;
     constexpr static float EMH_MIN_LOAD_FACTOR     = 0.25f; //< 0.5
 #endif
+#ifndef EMH_FLOOD_CHAIN
+    constexpr static uint32_t EMH_FLOOD_CHAIN  = 32; //chain length seen as a flood sample
+#endif
+#ifndef EMH_FLOOD_CHAINS
+    constexpr static uint32_t EMH_FLOOD_CHAINS = 4;  //samples before switching to the seeded hash
+#endif
+#ifndef EMH_PARALLEL_RANGE
+    constexpr static uint32_t EMH_PARALLEL_RANGE   = 1 << 16; //least buckets per task of parallel_*()
+#endif
 
 public:
     typedef HashMap<KeyT, ValueT, HashT, EqT> htype;
@@ -438,9 +473,8 @@ public:
 
     void init(size_type bucket, float lf = EMH_DEFAULT_LOAD_FACTOR)
     {
-#if EMH_SAFE_HASH
-        _num_main = _hash_inter = 0;
-#endif
+        _hash_seed = 0;
+        _long_chains = _flood_rehash = 0;
         _mask = 0;
         _pairs = nullptr;
         _bitmask = nullptr;
@@ -563,10 +597,9 @@ public:
     {
         _hasher      = rhs._hasher;
 //        _eq          = rhs._eq;
-#if EMH_SAFE_HASH
-        _num_main    = rhs._num_main;
-        _hash_inter  = rhs._hash_inter;
-#endif
+        _hash_seed   = rhs._hash_seed;
+        _long_chains = rhs._long_chains;
+        _flood_rehash= rhs._flood_rehash;
         _num_filled  = rhs._num_filled;
         _mask        = rhs._mask;
         _mlf         = rhs._mlf;
@@ -591,10 +624,9 @@ public:
         std::swap(_hasher, rhs._hasher);
 //      std::swap(_eq, rhs._eq);
         std::swap(_pairs, rhs._pairs);
-#if EMH_SAFE_HASH
-        std::swap(_num_main, rhs._num_main);
-        std::swap(_hash_inter, rhs._hash_inter);
-#endif
+        std::swap(_hash_seed, rhs._hash_seed);
+        std::swap(_long_chains, rhs._long_chains);
+        std::swap(_flood_rehash, rhs._flood_rehash);
         std::swap(_num_filled, rhs._num_filled);
         std::swap(_mask, rhs._mask);
         std::swap(_mlf, rhs._mlf);
@@ -668,6 +700,92 @@ public:
     constexpr size_type max_size() const { return 1ull << ((sizeof(size_type) * 8) - 1); }
     constexpr size_type max_bucket_count() const { return max_size(); }
 
+    /// number of times this map detected a hash flood and rehashed with its seeded hash,
+    /// once it is 1 all keys go through the seeded hash instead of HashT.
+    size_type flood_rehash() const { return _flood_rehash; }
+
+    /// hash values of n integer keys as this map computes them (hash64 with EMH_INT_HASH),
+    /// 4-8 keys per instruction through emcpu::hash_keys when EMH_CPU_DISPATCH is on.
+    template<typename K = KeyT, typename std::enable_if<std::is_integral<K>::value, int>::type = 0>
+    void hash_keys(const K* in, uint64_t* out, size_t n) const
+    {
+        if (EMH_UNLIKELY(_hash_seed != 0)) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = hash_key(in[i]);
+            return;
+        }
+#if EMH_INT_HASH && EMH_CPU_DISPATCH && !EMH_WYHASH64
+        emcpu::hash_keys<EMH_INT_HASH>(in, out, n);
+#elif EMH_INT_HASH
+        for (size_t i = 0; i < n; i++)
+            out[i] = hash64((uint64_t)in[i]);
+#else
+        for (size_t i = 0; i < n; i++)
+            out[i] = hash_key(in[i]);
+#endif
+    }
+
+    /// Returns a health snapshot of the table, always compiled and read only.
+    /// sample_step > 1 for huge tables looks at every sample_step-th bucket and walks only the
+    /// chains headed there, about 1/sample_step of the work.
+    HashStats stats(size_type sample_step = 1) const
+    {
+        HashStats st;
+        memset(&st, 0, sizeof(st));
+        st.size        = _num_filled;
+        st.buckets     = bucket_count();
+        st.load_factor = load_factor();
+        if (sample_step == 0)
+            sample_step = 1;
+
+        uint64_t occupied = 0, mains = 0, hits = 0, hit_sum = 0, miss_sum = 0, links = 0, link_sum = 0;
+        for (size_type bucket = 0; bucket < _mask + 1; bucket += sample_step) {
+            st.sampled ++;
+            //a miss ends at an empty bucket or at one holding an element of another chain
+            if (EMH_EMPTY(_pairs, bucket)) {
+                miss_sum ++;
+                continue;
+            }
+            occupied ++;
+            if (hash_main(bucket) != bucket) {
+                miss_sum ++;
+                continue;
+            }
+
+            //only chain heads are walked: the i-th element is found after visiting i buckets, a
+            //miss visits all of them and every link spans what the empty bucket search crossed
+            uint32_t probe = 1;
+            for (auto next_bucket = bucket; EMH_BUCKET(_pairs, next_bucket) != next_bucket; probe ++) {
+                const auto nbucket = EMH_BUCKET(_pairs, next_bucket);
+                const auto forward = (nbucket - next_bucket) & _mask, backward = (next_bucket - nbucket) & _mask;
+                const auto distance = (uint32_t)(forward < backward ? forward : backward);
+                links ++;
+                link_sum += distance;
+                if (distance > st.max_link_dist)
+                    st.max_link_dist = distance;
+                next_bucket = nbucket;
+            }
+
+            mains ++;
+            hits    += probe;
+            hit_sum += (uint64_t)probe * (probe + 1) / 2;
+            st.chain_len[probe < HashStats::CHAIN_SLOTS ? probe : HashStats::CHAIN_SLOTS - 1] ++;
+            if (probe > st.max_hit_probe)
+                st.max_hit_probe = probe;
+            miss_sum += probe;
+            if (probe > st.max_miss_probe)
+                st.max_miss_probe = probe;
+        }
+
+        st.main_ratio     = occupied ? (float)mains / occupied : 0;
+        st.avg_hit_probe  = hits ? (float)hit_sum / hits : 0;
+        st.avg_miss_probe = st.sampled ? (float)miss_sum / st.sampled : 0;
+        st.avg_link_dist  = links ? (float)link_sum / links : 0;
+        if (st.max_miss_probe == 0 && st.sampled > 0)
+            st.max_miss_probe = 1;
+        return st;
+    }
+
 #if EMH_STATIS
     //Returns the bucket number where the element with key k is located.
     size_type bucket(const KeyT& key) const
@@ -1151,6 +1269,76 @@ public:
         return old_size - size();
     }
 
+    /// fn(pair) for every element, fixed ranges of buckets run as tasks of exec(n, task),
+    /// which calls task(0) .. task(n - 1) on any threads and returns when all are done
+    /// (emhash8::SerialExecutor, a thread pool). fn must not insert or erase.
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn)
+    {
+        parallel_buckets(exec, [&](size_t, size_type bucket) { fn(EMH_PKV(_pairs, bucket)); });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn) const
+    {
+        parallel_buckets(exec, [&](size_t, size_type bucket) { fn((const value_pair&)EMH_PKV(_pairs, bucket)); });
+    }
+
+    /// combine(init, map(pair)) over all elements: every range folds its own, then the
+    /// ranges are folded into init in bucket order, so any executor gives the same result
+    template<typename Exec, typename T, typename M, typename C>
+    T parallel_reduce(Exec&& exec, T init, M map, C combine) const
+    {
+        std::vector<T> parts(parallel_tasks(), init);
+        std::vector<uint8_t> used(parts.size(), 0);
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            T part = init;
+            bool any = false;
+            visit_buckets(first, last, [&](size_type bucket) {
+                part = any ? combine(std::move(part), map((const value_pair&)EMH_PKV(_pairs, bucket))) : map((const value_pair&)EMH_PKV(_pairs, bucket));
+                any = true;
+            });
+            if (any)
+                parts[task] = std::move(part), used[task] = 1;
+        });
+        for (size_t task = 0; task < parts.size(); task++) {
+            if (used[task])
+                init = combine(std::move(init), std::move(parts[task]));
+        }
+        return init;
+    }
+
+    /// erase_if() with pred run in parallel: pred only marks, then the calling thread sweeps
+    /// the marks once. an element pulled back into an erased bucket takes its mark along.
+    template<typename Exec, typename Pred>
+    size_type parallel_erase_if(Exec&& exec, Pred pred)
+    {
+        const auto old_size = size();
+        const size_type num_buckets = _mask + 1;
+        auto marks = (uint64_t*)calloc(num_buckets / 64 + 1, sizeof(uint64_t));
+        parallel_buckets(exec, [&](size_t, size_type bucket) {
+            if (pred((const value_pair&)EMH_PKV(_pairs, bucket)))
+                marks[bucket / 64] |= 1ull << (bucket % 64);
+        });
+
+        for (size_type word = 0; word <= num_buckets / 64; word++) {
+            for (size_type bit = 0; marks[word] != 0 && bit < 64; bit++) {
+                const size_type bucket = word * 64 + bit;
+                while (marks[word] >> bit & 1) {
+                    marks[word] ^= 1ull << bit;
+                    const auto ebucket = erase_bucket(bucket);
+                    clear_bucket(ebucket);
+                    if (ebucket != bucket && (marks[ebucket / 64] >> (ebucket % 64) & 1)) {
+                        marks[ebucket / 64] ^= 1ull << (ebucket % 64);
+                        marks[word] |= 1ull << bit;
+                    }
+                }
+            }
+        }
+        free(marks);
+        return old_size - size();
+    }
+
     static constexpr bool is_triviall_destructable()
     {
 #if __cplusplus >= 201402L || _MSC_VER > 1600
@@ -1190,10 +1378,7 @@ public:
         }
 
         _num_filled = 0;
-
-#if EMH_SAFE_HASH
-        _num_main = _hash_inter = 0;
-#endif
+        _long_chains = 0;
     }
 
     void shrink_to_fit()
@@ -1262,11 +1447,7 @@ public:
         _mask        = num_buckets - 1;
         _pairs       = new_pairs;
 
-#if EMH_SAFE_HASH
-        if (old_num_filled > 100 && _hash_inter == 0)
-            _hash_inter = old_num_filled / (_num_main * 3);
-        _num_main = 0;
-#endif
+        _long_chains = 0;
 
         memset(_pairs, -1, sizeof(_pairs[0]) * num_buckets);
 
@@ -1308,9 +1489,7 @@ public:
 
 #if EMH_REHASH_LOG
         if (_num_filled > EMH_REHASH_LOG) {
-#ifndef EMH_SAFE_HASH
             auto _num_main = old_num_filled - collision;
-#endif
             const auto num_buckets = _mask + 1;
             auto last = EMH_ADDR(_pairs, num_buckets);
             char buff[255] = {0};
@@ -1333,15 +1512,34 @@ private:
     // Can we fit another element?
     inline bool check_expand_need()
     {
-#if EMH_SAFE_HASH > 1
-        if (EMH_UNLIKELY(_num_main * 3 < _num_filled) && _num_filled > 100 && _hash_inter == 0) {
-            rehash(_num_filled);
+        if (EMH_UNLIKELY(_long_chains >= EMH_FLOOD_CHAINS) && _hash_seed == 0) {
+            reseed_hash();
             return true;
         }
-#endif
         return reserve(_num_filled);
     }
 
+    //drawn once per process, so a leaked pointer alone does not give a map's seed away
+    static uint64_t process_seed()
+    {
+        static const uint64_t seed = []() {
+            std::random_device rd;
+            const auto now = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+            return ((uint64_t)rd() << 32 | rd()) ^ now;
+        }();
+        return seed;
+    }
+
+    //long chains keep showing up: HashT is broken for these keys or under attack.
+    //switch this map to a hash keyed by a per-instance seed and rebuild every chain.
+    void reseed_hash()
+    {
+        auto seed = process_seed() ^ (uint64_t)(size_t)this ^ ((uint64_t)(size_t)_pairs << 17) ^ (uint64_t)_num_filled;
+        _hash_seed = seed_mix(seed + UINT64_C(0x9E3779B97F4A7C15)) | 1;
+        _flood_rehash ++;
+        rehash(_mask + 1);
+    }
+
 #if EMH_FIND_HIT
     void reset_bucket(size_type bucket)
     {
@@ -1375,11 +1573,7 @@ private:
 
         if (next_bucket == bucket * 2) {
             const auto eqkey = _eq(key, EMH_KEY(_pairs, bucket));
-#if EMH_SAFE_HASH
-            return eqkey ? (_num_main --, bucket) : empty_bucket;
-#else
             return eqkey ? bucket : empty_bucket;
-#endif
         }
         else if (next_bucket % 2 > 0)
             return empty_bucket;
@@ -1418,11 +1612,7 @@ private:
 
         if (next_bucket == bucket * 2) { //only one main bucket
             const auto eqkey = _eq(key, EMH_KEY(_pairs, bucket));
-#if EMH_SAFE_HASH
-            return eqkey ? (_num_main --, bucket) : empty_bucket;
-#else
             return eqkey ? bucket : empty_bucket;
-#endif
         }
         else if (next_bucket % 2 > 0)
             return empty_bucket;
@@ -1455,15 +1645,42 @@ private:
         return find_bucket;
     }
 
+    //fixed ranges of 64 buckets multiples (whole mask words), the same with every executor
+    size_t parallel_tasks() const { return ((size_t)_mask + 1 + parallel_range() - 1) / parallel_range(); }
+    size_t parallel_range() const { return (std::max<size_t>(EMH_PARALLEL_RANGE, ((size_t)_mask + 1) / 256) + 63) / 64 * 64; }
+
+    template<typename F>
+    void visit_buckets(size_type first, size_type last, const F& f) const
+    {
+        for (auto bucket = first; bucket < last; bucket++) {
+            if (!EMH_EMPTY(_pairs, bucket))
+                f(bucket);
+        }
+    }
+
+    //f(task, first, last) for every range
+    template<typename Exec, typename F>
+    void parallel_ranges(Exec& exec, const F& f) const
+    {
+        const auto range = parallel_range(), num_buckets = (size_t)_mask + 1;
+        exec(parallel_tasks(), [&](size_t task) {
+            f(task, (size_type)(task * range), (size_type)std::min(num_buckets, (task + 1) * range));
+        });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_buckets(Exec& exec, const F& f) const
+    {
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            visit_buckets(first, last, [&](size_type bucket) { f(task, bucket); });
+        });
+    }
+
     size_type erase_bucket(const size_type bucket)
     {
         auto next_bucket = EMH_ADDR(_pairs, bucket);
-        if (next_bucket == bucket * 2) {
-#if EMH_SAFE_HASH
-            _num_main--;
-#endif
+        if (next_bucket == bucket * 2)
             return bucket;
-        }
         else if (next_bucket % 2 == 0) {
             next_bucket /= 2;
             const auto nbucket = EMH_BUCKET(_pairs, next_bucket);
@@ -1557,9 +1774,6 @@ private:
             EMH_ADDR(_pairs, new_bucket) = new_bucket * 2 + 1;
 
         EMH_ADDR(_pairs, prev_bucket) += (new_bucket - bucket) * 2;
-#if EMH_SAFE_HASH
-        _num_main ++;
-#endif
         clear_bucket(bucket); _num_filled ++;
         return bucket * 2;
     }
@@ -1575,15 +1789,8 @@ private:
     {
         const auto bucket = hash_key(key) & _mask;
         auto next_bucket = EMH_ADDR(_pairs, bucket);
-#if EMH_SAFE_HASH
-        if ((int)next_bucket < 0)
-            return _num_main ++, bucket * 2;
-        else if (_eq(key, EMH_KEY(_pairs, bucket)))
-            return bucket * 2;
-#else
         if ((int)next_bucket < 0 || _eq(key, EMH_KEY(_pairs, bucket)))
             return bucket * 2;
-#endif
 
         //check current bucket_key is in main bucket or not
         if (next_bucket == bucket * 2)
@@ -1591,7 +1798,7 @@ private:
         else if (next_bucket % 2 > 0)
             return kickout_bucket(bucket);
 
-        //int collisions = 2;
+        size_type collisions = 2;
         next_bucket /= 2;
         //find next linked bucket and check key
         while (true) {
@@ -1608,9 +1815,13 @@ private:
             if (nbucket == next_bucket)
                 break;
             next_bucket = nbucket;
-            //collisions++;
+            collisions++;
         }
 
+        //a chain this long is near impossible with a fair hash, check_expand_need() counts them
+        if (EMH_UNLIKELY(collisions > EMH_FLOOD_CHAIN))
+            _long_chains ++;
+
         //find a new empty and link it to tail
         const auto new_bucket = find_empty_bucket(bucket);
         return EMH_ADDR(_pairs, next_bucket) = new_bucket * 2 + 1;
@@ -1693,12 +1904,8 @@ private:
     {
         const auto bucket = size_type(hash_key(key) & _mask);
         const auto next_bucket = EMH_ADDR(_pairs, bucket);
-        if ((int)next_bucket < 0) {
-#if EMH_SAFE_HASH
-            _num_main ++;
-#endif
+        if ((int)next_bucket < 0)
             return bucket * 2;
-        }
 
         //check current bucket_key is in main bucket or not
         if (next_bucket == bucket * 2)
@@ -1713,7 +1920,7 @@ private:
 
 #if EMH_INT_HASH
     static constexpr uint64_t KC = UINT64_C(11400714819323198485);
-    inline uint64_t hash64(uint64_t key)
+    static inline uint64_t hash64(uint64_t key)
     {
 #if __SIZEOF_INT128__ && EMH_INT_HASH == 1
         __uint128_t r = key; r *= KC;
@@ -1751,6 +1958,46 @@ private:
     }
 #endif
 
+    static inline uint64_t seed_mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+        x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+        return x ^ (x >> 31);
+    }
+
+    template<typename UType, typename std::enable_if<std::is_integral<UType>::value, size_type>::type = 0>
+    inline size_type seeded_hash(const UType key) const
+    {
+        return (size_type)seed_mix((uint64_t)key ^ _hash_seed);
+    }
+
+    //every 8 bytes are folded in with the secret seed, so colliding keys can not be precomputed
+    template<typename UType, typename std::enable_if<std::is_same<UType, std::string>::value, size_type>::type = 0>
+    inline size_type seeded_hash(const UType& key) const
+    {
+#if EMH_WY_HASH
+        return (size_type)wyhash(key.data(), key.size(), _hash_seed);
+#else
+        const auto* p = key.data();
+        auto h = _hash_seed ^ (uint64_t)key.size();
+        size_t i = 0;
+        for (; i + 8 <= key.size(); i += 8) {
+            uint64_t v; memcpy(&v, p + i, 8);
+            h = seed_mix(h ^ v);
+        }
+        uint64_t v = 0; memcpy(&v, p + i, key.size() - i);
+        return (size_type)seed_mix(h ^ v ^ _hash_seed);
+#endif
+    }
+
+    //only the output of HashT is known here: this breaks up keys that share the low (bucket)
+    //bits of their hash, keys with fully equal HashT values still share a chain
+    template<typename UType, typename std::enable_if<!std::is_integral<UType>::value && !std::is_same<UType, std::string>::value, size_type>::type = 0>
+    inline size_type seeded_hash(const UType& key) const
+    {
+        return (size_type)seed_mix((uint64_t)_hasher(key) ^ _hash_seed);
+    }
+
     inline size_type hash_main(const size_type bucket) const
     {
         return hash_key(EMH_KEY(_pairs, bucket)) & _mask;
@@ -1759,10 +2006,10 @@ private:
     template<typename UType, typename std::enable_if<std::is_integral<UType>::value, size_type>::type = 0>
     inline size_type hash_key(const UType key) const
     {
+        if (EMH_UNLIKELY(_hash_seed != 0))
+            return seeded_hash(key);
 #if EMH_INT_HASH
         return hash64(key);
-#elif EMH_SAFE_HASH
-        return _hash_inter == 0 ? _hasher(key) : hash64(key);
 #elif EMH_IDENTITY_HASH
         return key + (key >> 24);
 #else
@@ -1773,6 +2020,8 @@ private:
     template<typename UType, typename std::enable_if<std::is_same<UType, std::string>::value, size_type>::type = 0>
     inline size_type hash_key(const UType& key) const
     {
+        if (EMH_UNLIKELY(_hash_seed != 0))
+            return seeded_hash(key);
 #if EMH_WY_HASH
         return wyhash(key.data(), key.size(), 0);
 #else
@@ -1783,6 +2032,8 @@ private:
     template<typename UType, typename std::enable_if<!std::is_integral<UType>::value && !std::is_same<UType, std::string>::value, size_type>::type = 0>
     inline size_type hash_key(const UType& key) const
     {
+        if (EMH_UNLIKELY(_hash_seed != 0))
+            return seeded_hash(key);
         return (size_type)_hasher(key);
     }
 
@@ -1800,10 +2051,9 @@ private:
 //    size_type _zero_index;
 #endif
 
-#if EMH_SAFE_HASH
-    size_type _num_main;
-    size_type _hash_inter;
-#endif
+    uint64_t  _hash_seed;    //0: user hasher, else the seed of the flood fallback hash
+    size_type _long_chains;  //inserts that walked a chain over EMH_FLOOD_CHAIN since last rehash
+    size_type _flood_rehash;
 
     static constexpr uint32_t BIT_PACK = sizeof(_bitmask[0]) * 2;
     static constexpr uint32_t MASK_BIT = sizeof(_bitmask[0]) * 8;
@@ -87,11 +87,16 @@ of resizing granularity. Ignoring variance, the expected occurrences of list siz
 #include <functional>
 #include <iterator>
 #include <algorithm>
+#include <vector>
 
 #if EMH_WY_HASH
     #include "wyhash.h"
 #endif
 
+#if EMH_CPU_DISPATCH
+    #include "hash_cpu.hpp"
+#endif
+
 #ifdef EMH_KEY
     #undef  EMH_KEY
     #undef  EMH_VAL
@@ -208,6 +213,25 @@ static int CTZ(size_t n)
     return (int)index;
 }
 
+/// table health snapshot returned by HashMap::stats(), probes are counted in visited buckets
+struct HashStats
+{
+    constexpr static uint32_t CHAIN_SLOTS = 16;
+
+    uint64_t size;           //number of elements
+    uint64_t buckets;        //bucket_count()
+    uint64_t sampled;        //buckets walked, less than buckets in sampled mode
+    float    load_factor;
+    float    main_ratio;     //occupied buckets holding an element in its main bucket
+    float    avg_hit_probe;  //successful find
+    float    avg_miss_probe; //unsuccessful find with a uniform hash: a chain head costs its chain, other buckets 1
+    float    avg_link_dist;  //buckets between neighbours of a chain, the distance the empty bucket search went
+    uint32_t max_hit_probe;  //longest chain
+    uint32_t max_miss_probe;
+    uint32_t max_link_dist;
+    uint64_t chain_len[CHAIN_SLOTS]; //chains by length, the last slot counts all longer ones
+};
+
 template <typename First, typename Second>
 struct entry {
     using first_type =  First;
@@ -312,6 +336,9 @@ class HashMap
     constexpr static float EMH_DEFAULT_LOAD_FACTOR = 0.80f;
     constexpr static float EMH_MIN_LOAD_FACTOR     = 0.25f; //< 0.5
 #endif
+#ifndef EMH_PARALLEL_RANGE
+    constexpr static uint32_t EMH_PARALLEL_RANGE   = 1 << 16; //least buckets per task of parallel_*()
+#endif
 
 public:
     typedef HashMap<KeyT, ValueT, HashT, EqT> htype;
@@ -423,9 +450,20 @@ public:
                 return;
             }
 
+#if EMH_CPU_DISPATCH
+            _bmask = ~*(size_t*)((size_t*)_map->_bitmask + (_from += SIZE_BIT) / SIZE_BIT);
+            if (_bmask == 0) {
+                //a run of empty words (sparse table), the sentinel word stops the scan
+                const auto word = _from / SIZE_BIT + 1;
+                const auto skip = emcpu::scan_ne((size_t*)_map->_bitmask + word, _map->_num_buckets / SIZE_BIT + 1 - word, ~(size_t)0);
+                _from = (size_type)((word + skip) * SIZE_BIT);
+                _bmask = ~*((size_t*)_map->_bitmask + word + skip);
+            }
+#else
             do {
                 _bmask = ~*(size_t*)((size_t*)_map->_bitmask + (_from += SIZE_BIT) / SIZE_BIT);
             } while (_bmask == 0);
+#endif
 
             _bucket = _from + CTZ(_bmask);
         }
@@ -507,9 +545,20 @@ public:
                 return;
             }
 
+#if EMH_CPU_DISPATCH
+            _bmask = ~*(size_t*)((size_t*)_map->_bitmask + (_from += SIZE_BIT) / SIZE_BIT);
+            if (_bmask == 0) {
+                //a run of empty words (sparse table), the sentinel word stops the scan
+                const auto word = _from / SIZE_BIT + 1;
+                const auto skip = emcpu::scan_ne((size_t*)_map->_bitmask + word, _map->_num_buckets / SIZE_BIT + 1 - word, ~(size_t)0);
+                _from = (size_type)((word + skip) * SIZE_BIT);
+                _bmask = ~*((size_t*)_map->_bitmask + word + skip);
+            }
+#else
             do {
                 _bmask = ~*(size_t*)((size_t*)_map->_bitmask + (_from += SIZE_BIT) / SIZE_BIT);
             } while (_bmask == 0);
+#endif
 
             _bucket = _from + CTZ(_bmask);
         }
@@ -753,6 +802,144 @@ public:
         return main_size;
     }
 
+    /// hash values of n integer keys as this map computes them (hash64 with EMH_INT_HASH),
+    /// 4-8 keys per instruction through emcpu::hash_keys when EMH_CPU_DISPATCH is on.
+    template<typename K = KeyT, typename std::enable_if<std::is_integral<K>::value, int>::type = 0>
+    void hash_keys(const K* in, uint64_t* out, size_t n) const
+    {
+#if EMH_INT_HASH && EMH_CPU_DISPATCH && !EMH_WYHASH64
+        emcpu::hash_keys<EMH_INT_HASH>(in, out, n);
+#elif EMH_INT_HASH
+        for (size_t i = 0; i < n; i++)
+            out[i] = hash64((uint64_t)in[i]);
+#else
+        for (size_t i = 0; i < n; i++)
+            out[i] = hash_key(in[i]);
+#endif
+    }
+
+    /// main bucket of key: every entry of its chain hashes there
+    template<typename K = KeyT>
+    size_type main_bucket(const K& key) const { return hash_key(key) & _mask; }
+
+    /// copy out the value of key (main_bucket(key)) while one writer may change this table
+    /// in place (emhash7::SwmrMap). links read mid write can be garbage: a link outside the
+    /// table ends the walk and at most bucket_count() hops are taken, so every read stays
+    /// inside _pairs. the result means nothing until the caller's version check passes.
+    template<typename K = KeyT>
+    bool find_racy(const K& key, size_type main_bucket, ValueT& val) const
+    {
+        auto next_bucket = main_bucket;
+        if (EMH_EMPTY(_pairs, next_bucket))
+            return false;
+
+        for (auto probe = _num_buckets; probe > 0; probe--) {
+            if (_eq(key, EMH_KEY(_pairs, next_bucket))) {
+                val = EMH_VAL(_pairs, next_bucket);
+                return true;
+            }
+            const auto nbucket = EMH_BUCKET(_pairs, next_bucket);
+            if (nbucket == next_bucket || nbucket >= _num_buckets)
+                break;
+            next_bucket = nbucket;
+        }
+        return false;
+    }
+
+    /// insert_unique for a table readers walk while it changes (emhash7::SwmrMap). all buckets
+    /// are chosen first, then guard(main, kicked, fill) runs before anything is written: the
+    /// key's main bucket, the main bucket of an entry kicked out of it (else main) and the
+    /// empty bucket that gets filled. never rehashes, the caller keeps the load below
+    /// max_load_factor().
+    template<typename F>
+    size_type insert_unique_racy(const KeyT& key, const ValueT& val, const F& guard)
+    {
+        const auto bucket = hash_key(key) & _mask;
+        if (EMH_EMPTY(_pairs, bucket)) {
+            guard(bucket, bucket, bucket);
+            EMH_NEW(key, val, bucket);
+            return bucket;
+        }
+
+        const auto kmain = hash_key(EMH_KEY(_pairs, bucket)) & _mask;
+        if (kmain != bucket) {
+            const auto fill = find_empty_bucket(EMH_BUCKET(_pairs, bucket), bucket);
+            guard(bucket, kmain, fill);
+            kickout_to(kmain, bucket, fill);
+            EMH_NEW(key, val, bucket);
+            return bucket;
+        }
+
+        const auto tail = find_last_bucket(bucket);
+        const auto fill = find_unique_empty(tail, bucket);
+        guard(bucket, bucket, fill);
+        //entry before link: the chain never reaches an unwritten bucket
+        EMH_NEW(key, val, fill);
+        EMH_BUCKET(_pairs, tail) = fill;
+        return fill;
+    }
+
+    /// Returns a health snapshot of the table, always compiled and read only.
+    /// sample_step > 1 for huge tables looks at every sample_step-th bucket and walks only the
+    /// chains headed there, about 1/sample_step of the work.
+    HashStats stats(size_type sample_step = 1) const
+    {
+        HashStats st;
+        memset(&st, 0, sizeof(st));
+        st.size        = _num_filled;
+        st.buckets     = bucket_count();
+        st.load_factor = load_factor();
+        if (sample_step == 0)
+            sample_step = 1;
+
+        uint64_t occupied = 0, mains = 0, hits = 0, hit_sum = 0, miss_sum = 0, links = 0, link_sum = 0;
+        for (size_type bucket = 0; bucket < _num_buckets; bucket += sample_step) {
+            st.sampled ++;
+            //a miss ends at an empty bucket or at one holding an element of another chain
+            if (EMH_EMPTY(_pairs, bucket)) {
+                miss_sum ++;
+                continue;
+            }
+            occupied ++;
+            if (size_type(hash_key(EMH_KEY(_pairs, bucket)) & _mask) != bucket) {
+                miss_sum ++;
+                continue;
+            }
+
+            //only chain heads are walked: the i-th element is found after visiting i buckets, a
+            //miss visits all of them and every link spans what the empty bucket search crossed
+            uint32_t probe = 1;
+            for (auto next_bucket = bucket; EMH_BUCKET(_pairs, next_bucket) != next_bucket; probe ++) {
+                const auto nbucket = EMH_BUCKET(_pairs, next_bucket);
+                const auto forward = (nbucket - next_bucket) & _mask, backward = (next_bucket - nbucket) & _mask;
+                const auto distance = (uint32_t)(forward < backward ? forward : backward);
+                links ++;
+                link_sum += distance;
+                if (distance > st.max_link_dist)
+                    st.max_link_dist = distance;
+                next_bucket = nbucket;
+            }
+
+            mains ++;
+            hits    += probe;
+            hit_sum += (uint64_t)probe * (probe + 1) / 2;
+            st.chain_len[probe < HashStats::CHAIN_SLOTS ? probe : HashStats::CHAIN_SLOTS - 1] ++;
+            if (probe > st.max_hit_probe)
+                st.max_hit_probe = probe;
+            miss_sum += probe;
+            if (probe > st.max_miss_probe)
+                st.max_miss_probe = probe;
+        }
+
+        st.main_ratio     = occupied ? (float)mains / occupied : 0;
+        st.avg_hit_probe  = hits ? (float)hit_sum / hits : 0;
+        st.avg_miss_probe = st.sampled ? (float)miss_sum / st.sampled : 0;
+        st.avg_link_dist  = links ? (float)link_sum / links : 0;
+        if (st.max_miss_probe == 0 && st.sampled > 0)
+            st.max_miss_probe = 1;
+        return st;
+    }
+
 #if EMH_STATIS
     //Returns the bucket number where the element with key k is located.
     size_type bucket(const KeyT& key) const
@@ -1265,6 +1452,76 @@ public:
         return old_size - size();
     }
 
+    /// fn(pair) for every element, fixed ranges of buckets run as tasks of exec(n, task),
+    /// which calls task(0) .. task(n - 1) on any threads and returns when all are done
+    /// (emhash8::SerialExecutor, a thread pool). fn must not insert or erase.
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn)
+    {
+        parallel_buckets(exec, [&](size_t, size_type bucket) { fn(EMH_PKV(_pairs, bucket)); });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn) const
+    {
+        parallel_buckets(exec, [&](size_t, size_type bucket) { fn((const value_pair&)EMH_PKV(_pairs, bucket)); });
+    }
+
+    /// combine(init, map(pair)) over all elements: every range folds its own, then the
+    /// ranges are folded into init in bucket order, so any executor gives the same result
+    template<typename Exec, typename T, typename M, typename C>
+    T parallel_reduce(Exec&& exec, T init, M map, C combine) const
+    {
+        std::vector<T> parts(parallel_tasks(), init);
+        std::vector<uint8_t> used(parts.size(), 0);
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            T part = init;
+            bool any = false;
+            visit_buckets(first, last, [&](size_type bucket) {
+                part = any ? combine(std::move(part), map((const value_pair&)EMH_PKV(_pairs, bucket))) : map((const value_pair&)EMH_PKV(_pairs, bucket));
+                any = true;
+            });
+            if (any)
+                parts[task] = std::move(part), used[task] = 1;
+        });
+        for (size_t task = 0; task < parts.size(); task++) {
+            if (used[task])
+                init = combine(std::move(init), std::move(parts[task]));
+        }
+        return init;
+    }
+
+    /// erase_if() with pred run in parallel: pred only marks, then the calling thread sweeps
+    /// the marks once. an element pulled back into an erased bucket takes its mark along.
+    template<typename Exec, typename Pred>
+    size_type parallel_erase_if(Exec&& exec, Pred pred)
+    {
+        const auto old_size = size();
+        const size_type num_buckets = _num_buckets;
+        auto marks = (uint64_t*)calloc(num_buckets / 64 + 1, sizeof(uint64_t));
+        parallel_buckets(exec, [&](size_t, size_type bucket) {
+            if (pred((const value_pair&)EMH_PKV(_pairs, bucket)))
+                marks[bucket / 64] |= 1ull << (bucket % 64);
+        });
+
+        for (size_type word = 0; word <= num_buckets / 64; word++) {
+            for (size_type bit = 0; marks[word] != 0 && bit < 64; bit++) {
+                const size_type bucket = word * 64 + bit;
+                while (marks[word] >> bit & 1) {
+                    marks[word] ^= 1ull << bit;
+                    const auto ebucket = erase_bucket(bucket);
+                    clear_bucket(ebucket);
+                    if (ebucket != bucket && (marks[ebucket / 64] >> (ebucket % 64) & 1)) {
+                        marks[ebucket / 64] ^= 1ull << (ebucket % 64);
+                        marks[word] |= 1ull << bit;
+                    }
+                }
+            }
+        }
+        free(marks);
+        return old_size - size();
+    }
+
     static constexpr bool is_triviall_destructable()
     {
 #if __cplusplus >= 201402L || _MSC_VER > 1600
@@ -1501,6 +1758,43 @@ private:
     }
 #endif
 
+    //fixed ranges of 64 buckets multiples (whole mask words), the same with every executor
+    size_t parallel_tasks() const { return ((size_t)_num_buckets + parallel_range() - 1) / parallel_range(); }
+    size_t parallel_range() const { return (std::max<size_t>(EMH_PARALLEL_RANGE, (size_t)_num_buckets / 256) + 63) / 64 * 64; }
+
+    //f(bucket) for the filled buckets of [first, last), first on a mask word
+    template<typename F>
+    void visit_buckets(size_type first, size_type last, const F& f) const
+    {
+        for (auto from = first; from < last; from += SIZE_BIT) {
+            auto bmask = ~*((size_t*)_bitmask + from / SIZE_BIT);
+            for (; bmask != 0; bmask &= bmask - 1) {
+                const auto bucket = from + CTZ(bmask);
+                if (bucket >= last)
+                    break;
+                f(bucket);
+            }
+        }
+    }
+
+    //f(task, first, last) for every range
+    template<typename Exec, typename F>
+    void parallel_ranges(Exec& exec, const F& f) const
+    {
+        const auto range = parallel_range(), num_buckets = (size_t)_num_buckets;
+        exec(parallel_tasks(), [&](size_t task) {
+            f(task, (size_type)(task * range), (size_type)std::min(num_buckets, (task + 1) * range));
+        });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_buckets(Exec& exec, const F& f) const
+    {
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            visit_buckets(first, last, [&](size_type bucket) { f(task, bucket); });
+        });
+    }
+
     size_type erase_bucket(const size_type bucket)
     {
         const auto next_bucket = EMH_BUCKET(_pairs, bucket);
@@ -1574,9 +1868,14 @@ private:
     //before: main_bucket-->prev_bucket --> bucket   --> next_bucket
     //atfer : main_bucket-->prev_bucket --> (removed)--> new_bucket--> next_bucket
     size_type kickout_bucket(const size_type kmain, const size_type kbucket)
+    {
+        const auto new_bucket = find_empty_bucket(EMH_BUCKET(_pairs, kbucket), kbucket);
+        return kickout_to(kmain, kbucket, new_bucket);
+    }
+
+    size_type kickout_to(const size_type kmain, const size_type kbucket, const size_type new_bucket)
     {
         const auto next_bucket = EMH_BUCKET(_pairs, kbucket);
-        const auto new_bucket  = find_empty_bucket(next_bucket, kbucket);
         const auto prev_bucket = find_prev_bucket(kmain, kbucket);
         new(_pairs + new_bucket) PairT(std::move(_pairs[kbucket]));
         if (is_triviall_destructable())
@@ -1720,6 +2019,17 @@ private:
             return bucket_from + CTZ(bmask);
 
         const auto qmask = _mask / SIZE_BIT;
+#if EMH_CPU_DISPATCH
+        if (_num_buckets >= SIZE_BIT) {
+            //qmask + 1 words, wrap once: the load factor guarantees an empty bucket
+            const auto* words = (const size_t*)_bitmask;
+            const size_t last = (bucket_from + _mask) & qmask;
+            auto word = last + emcpu::scan_ne(words + last, qmask + 1 - last, 0);
+            if (word > qmask)
+                word = emcpu::scan_ne(words, last, 0);
+            return (size_type)(word * SIZE_BIT + CTZ(words[word]));
+        }
+#endif
         for (auto last = (bucket_from + _mask) & qmask; ;) {
             const auto bmask2 = *((size_t*)_bitmask + last);// & 0xF0F0F0F0FF0FF0FFull;
             if (EMH_LIKELY(bmask2 != 0))
@@ -1779,7 +2089,7 @@ private:
 
 #if EMH_INT_HASH
     static constexpr uint64_t KC = UINT64_C(11400714819323198485);
-    inline uint64_t hash64(uint64_t key)
+    static inline uint64_t hash64(uint64_t key)
     {
 #if __SIZEOF_INT128__ && EMH_INT_HASH == 1
         __uint128_t r = key; r *= KC;
@@ -35,6 +35,15 @@
 #include <functional>
 #include <iterator>
 #include <algorithm>
+#include <chrono>
+#include <tuple>
+#include <vector>
+
+#if __cplusplus >= 201703L || _MSVC_LANG >= 201703L
+    #include <string_view>
+#endif
+
+#include "hash_cpu.hpp" //emcpu::fixed_hash/fixed_equal for byte keys, dispatched kernels with EMH_CPU_DISPATCH
 
 #ifdef EMH_KEY
     #undef  EMH_KEY
@@ -44,6 +53,8 @@
     #undef  EMH_NEW
     #undef  EMH_EMPTY
     #undef  EMH_PREVET
+    #undef  EMH_KEYMASK
+    #undef  EMH_EQHASH
     #undef  EMH_LIKELY
     #undef  EMH_UNLIKELY
 #endif
@@ -68,11 +79,13 @@
 #define EMH_PREVET(i, n)  i[n].slot
 
 #define EMH_KEYMASK(key, mask)  ((size_type)(key) & ~mask)
-#define EMH_EQHASH(n, key_hash) (EMH_KEYMASK(key_hash, _mask) == (_index[n].slot & ~_mask))
+#define EMH_EQHASH(n, key_hash, key) \
+    (EMH_KEYMASK(key_hash, _mask) == (_index[n].slot & ~_mask) && match_fp(_index[n], key_hash, key, 0))
 #define EMH_NEW(key, val, bucket, key_hash) \
     new(_pairs + _num_filled) value_type(key, val); \
     _etail = bucket; \
-    _index[bucket] = {bucket, _num_filled++ | EMH_KEYMASK(key_hash, _mask)}
+    _index[bucket] = {bucket, _num_filled | EMH_KEYMASK(key_hash, _mask)}; \
+    set_fp(_index[bucket], key_hash, EMH_KEY(_pairs, _num_filled++))
 
 #define EMH_EMPTY(i, n) (0 > (int)i[n].bucket)
 
@@ -85,12 +98,326 @@ namespace emhash8 {
 #if EMH_CACHE_LINE_SIZE < 32
     constexpr static uint32_t EMH_CACHE_LINE_SIZE  = 64;
 #endif
+#ifndef EMH_HASH_BATCH
+    constexpr static uint32_t EMH_HASH_BATCH       = 64; //keys hashed at once by rehash()
+#endif
+#ifndef EMH_PARALLEL_RANGE
+    constexpr static uint32_t EMH_PARALLEL_RANGE   = 1 << 16; //least buckets/slots per task of parallel_rehash()
+#endif
+
+/// runs the tasks of HashMap::parallel_rehash() on the calling thread. any callable of the
+/// same shape fits a thread pool in: exec(n, task) calls task(0) .. task(n - 1) in any order
+/// and on any threads, and returns once all of them are done.
+struct SerialExecutor
+{
+    template<typename F>
+    void operator()(size_t tasks, const F& task) const
+    {
+        for (size_t i = 0; i < tasks; i++)
+            task(i);
+    }
+};
+
+/// table health snapshot returned by HashMap::stats(), probes are counted in visited buckets
+struct HashStats
+{
+    constexpr static uint32_t CHAIN_SLOTS = 16;
+
+    uint64_t size;           //number of elements
+    uint64_t buckets;        //bucket_count()
+    uint64_t sampled;        //buckets walked, less than buckets in sampled mode
+    float    load_factor;
+    float    main_ratio;     //occupied buckets holding an element in its main bucket
+    float    avg_hit_probe;  //successful find
+    float    avg_miss_probe; //unsuccessful find with a uniform hash: a chain head costs its chain, other buckets 1
+    float    avg_link_dist;  //buckets between neighbours of a chain, the distance the empty bucket search went
+    uint32_t max_hit_probe;  //longest chain
+    uint32_t max_miss_probe;
+    uint32_t max_link_dist;
+    uint64_t chain_len[CHAIN_SLOTS]; //chains by length, the last slot counts all longer ones
+};
+
+/// table events reported to the observer of a HashMap policy
+enum EventType : uint8_t
+{
+    EVENT_REHASH_BEGIN,
+    EVENT_REHASH_END,
+    EVENT_SHRINK,
+    EVENT_CLEAR,
+    EVENT_HIGH_LOAD_ON,  //set_empty() built the empty bucket list
+    EVENT_HIGH_LOAD_OFF, //clear_empty() dropped it
+};
+
+struct TableEvent
+{
+    const void* table;
+    EventType   type;
+    uint64_t    old_buckets;
+    uint64_t    new_buckets;
+    uint64_t    size;
+    uint64_t    elapsed_ns;  //0 for EVENT_REHASH_BEGIN
+};
+
+/// default observer: enabled is false, so no clock is read and every hook compiles away.
+/// a custom one provides the same two static members, on_event() runs on the mutating thread.
+struct NullObserver
+{
+    constexpr static bool enabled = false;
+    static void on_event(const TableEvent&) {}
+};
+
+/// default allocator of _pairs and _index. a custom one provides the same two static
+/// members, deallocate() gets every pointer allocate() returned and nullptr.
+struct MallocAllocator
+{
+    static void* allocate(size_t bytes) { return malloc(bytes); }
+    static void deallocate(void* ptr) { free(ptr); }
+};
+
+//mum mix shared by the composite key hashers below
+inline uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = a; r *= b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t hi, lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#else
+    const uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+    const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+    const uint64_t lo = t + (rm1 << 32), c = (t < rl) + (lo < t);
+    return lo ^ (rh + (rm0 >> 32) + (rm1 >> 32) + c);
+#endif
+}
+
+inline uint64_t hash_combine(uint64_t seed, uint64_t value)
+{
+    return hash_mix(seed ^ value ^ UINT64_C(0xa0761d6478bd642f), UINT64_C(0xe7037ed1a0b428db));
+}
+
+//wyhash style over a small padding free object, 8 bytes per step
+inline uint64_t hash_bytes(const void* data, size_t len)
+{
+    const auto* p = (const uint8_t*)data;
+    uint64_t h = len, word;
+    for (; len >= 16; len -= 16, p += 16) {
+        uint64_t w2;
+        memcpy(&word, p, 8); memcpy(&w2, p + 8, 8);
+        h = hash_mix(word ^ h ^ UINT64_C(0xa0761d6478bd642f), w2 ^ UINT64_C(0xe7037ed1a0b428db));
+    }
+    word = 0;
+    if (len >= 8) {
+        memcpy(&word, p, 8);
+        h = hash_combine(h, word);
+        p += 8; len -= 8; word = 0;
+    }
+    memcpy(&word, p, len);
+    return hash_combine(h, word);
+}
+
+template<typename T> class has_std_hash
+{
+    template<typename U> static auto test(int) -> decltype(std::hash<U>()(std::declval<const U&>()), std::true_type());
+    template<typename U> static std::false_type test(...);
+public:
+    constexpr static bool value = decltype(test<T>(0))::value;
+};
+
+/// class keys without std::hash whose bytes are their value: hashed over the bytes, compared by memcmp
+template<typename T> struct is_bytes_key
+{
+#if __cplusplus >= 201703L || _MSVC_LANG >= 201703L
+    constexpr static bool value = std::is_class<T>::value && !has_std_hash<T>::value && std::has_unique_object_representations<T>::value;
+#else
+    constexpr static bool value = false;
+#endif
+};
+
+/// default HashT: std::hash where it exists, otherwise pairs and tuples by hash_combine,
+/// enums by their underlying type, 128 bit integers by a two lane mix and padding free
+/// structs by their bytes. pointers are mixed: std::hash of a pointer is the address,
+/// its zero alignment bits would leave most buckets empty.
+template<typename T, typename Enable = void>
+struct Hash : std::hash<T> { };
+
+template<typename T>
+struct Hash<T*, void>
+{
+    size_t operator()(const T* ptr) const
+    {
+        return (size_t)hash_mix((uint64_t)(uintptr_t)ptr, UINT64_C(0x9E3779B97F4A7C15));
+    }
+};
+
+template<typename T>
+struct Hash<T, typename std::enable_if<std::is_enum<T>::value>::type>
+{
+    size_t operator()(const T key) const { return Hash<typename std::underlying_type<T>::type>()((typename std::underlying_type<T>::type)key); }
+};
+
+template<typename A, typename B>
+struct Hash<std::pair<A, B>, void>
+{
+    size_t operator()(const std::pair<A, B>& key) const
+    {
+        return (size_t)hash_combine(hash_combine(0, Hash<typename std::decay<A>::type>()(key.first)), Hash<typename std::decay<B>::type>()(key.second));
+    }
+};
+
+template<typename... Args>
+struct Hash<std::tuple<Args...>, void>
+{
+    size_t operator()(const std::tuple<Args...>& key) const { return (size_t)combine(key, std::integral_constant<size_t, 0>()); }
+
+private:
+    template<size_t I>
+    static uint64_t combine(const std::tuple<Args...>& key, std::integral_constant<size_t, I>)
+    {
+        using E = typename std::decay<typename std::tuple_element<I, std::tuple<Args...>>::type>::type;
+        return hash_combine(combine(key, std::integral_constant<size_t, I + 1>()), Hash<E>()(std::get<I>(key)));
+    }
+    static uint64_t combine(const std::tuple<Args...>&, std::integral_constant<size_t, sizeof...(Args)>) { return 0; }
+};
+
+#if defined(__SIZEOF_INT128__)
+template<>
+struct Hash<__uint128_t, void>
+{
+    size_t operator()(const __uint128_t key) const
+    {
+        return (size_t)hash_mix((uint64_t)key ^ UINT64_C(0xa0761d6478bd642f), (uint64_t)(key >> 64) ^ UINT64_C(0xe7037ed1a0b428db));
+    }
+};
+
+template<>
+struct Hash<__int128_t, void>
+{
+    size_t operator()(const __int128_t key) const { return Hash<__uint128_t>()((__uint128_t)key); }
+};
+#endif
+
+template<typename T>
+struct Hash<T, typename std::enable_if<is_bytes_key<T>::value>::type>
+{
+    size_t operator()(const T& key) const
+    {
+        if (sizeof(T) <= 32)
+            return (size_t)emcpu::fixed_hash<sizeof(T) <= 32 ? sizeof(T) : 32>(&key);
+        return (size_t)hash_bytes(&key, sizeof(T));
+    }
+};
+
+/// default EqT: std::equal_to, memcmp for the keys Hash reads as bytes (emcpu::fixed_equal up to 32)
+template<typename T, typename Enable = void>
+struct EqualTo : std::equal_to<T> { };
 
-template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>, typename EqT = std::equal_to<KeyT>>
+template<typename T>
+struct EqualTo<T, typename std::enable_if<is_bytes_key<T>::value>::type>
+{
+    bool operator()(const T& lhs, const T& rhs) const
+    {
+        if (sizeof(T) <= 32)
+            return emcpu::fixed_equal<sizeof(T) <= 32 ? sizeof(T) : 32>(&lhs, &rhs);
+        return memcmp(&lhs, &rhs, sizeof(T)) == 0;
+    }
+};
+
+/// one bucket of HashMap::_index. with a fingerprint the entry also keeps 24 more hash bits and
+/// the low byte of the key length, so a colliding string is nearly always rejected before its
+/// (usually heap allocated) characters are read
+template<typename size_type, bool fingerprint>
+struct IndexEntry
+{
+    size_type bucket;
+    size_type slot;
+};
+
+template<typename size_type>
+struct IndexEntry<size_type, true>
+{
+    IndexEntry() = default;
+    IndexEntry(size_type b, size_type s, uint32_t f = 0) : bucket(b), slot(s), fp(f) { }
+
+    size_type bucket;
+    size_type slot;
+    uint32_t  fp;     //0 until set_fp(), an inactive entry never compares it
+};
+
+/// compile time behaviour of HashMap. every member is a constant, so the branches on it fold
+/// away and maps with different policies coexist in one binary. the EMH_* macros only pick the
+/// defaults here, derive from DefaultPolicy and override what differs:
+///   struct DenseIndex : emhash8::DefaultPolicy { constexpr static uint32_t high_load = 1 << 16; };
+///   emhash8::HashMap<uint64_t, uint32_t, std::hash<uint64_t>, std::equal_to<uint64_t>, DenseIndex> index;
+struct DefaultPolicy
+{
+    //hashing: int_hash 1 fibonacci 128 bit mul, 2 murmur3 mixer, 3 ror mix, other splitmix64, 0 HashT
+#ifdef EMH_INT_HASH
+    constexpr static int      int_hash      = EMH_INT_HASH;
+#else
+    constexpr static int      int_hash      = 0;
+#endif
+#ifdef EMH_IDENTITY_HASH
+    constexpr static bool     identity_hash = EMH_IDENTITY_HASH;
+#else
+    constexpr static bool     identity_hash = false;
+#endif
+#ifdef EMH_WYHASH_HASH
+    constexpr static bool     wyhash_str    = EMH_WYHASH_HASH;  //wyhashstr() for std::string keys
+#else
+    constexpr static bool     wyhash_str    = false;
+#endif
+
+    //std::string keys keep a fingerprint next to every Index entry (12 instead of 8 bytes). the slot
+    //already holds the hash bits above the mask, so this pays off for weak hashers or huge tables
+#ifdef EMH_STR_FINGERPRINT
+    constexpr static bool     str_fingerprint = EMH_STR_FINGERPRINT;
+#else
+    constexpr static bool     str_fingerprint = false;
+#endif
+
+    //probing: quadratic steps inside two cache lines before the 3-way linear search
+#ifdef EMH_QUADRATIC
+    constexpr static bool     quadratic     = true;
+#else
+    constexpr static bool     quadratic     = false;
+#endif
+
+    //growth
+    constexpr static float    load_factor   = EMH_DEFAULT_LOAD_FACTOR;
+#ifdef EMH_PACK_TAIL
+    constexpr static uint32_t pack_tail     = EMH_PACK_TAIL;    //extra buckets past the mask in percent
+#else
+    constexpr static uint32_t pack_tail     = 0;
+#endif
+#ifdef EMH_SORT
+    constexpr static bool     sort_rehash   = EMH_SORT;         //group _pairs by main bucket on rehash
+#else
+    constexpr static bool     sort_rehash   = false;
+#endif
+
+    //high load: tables over this many buckets keep a free bucket list and fill up past the load factor, 0 off
+#ifdef EMH_HIGH_LOAD
+    constexpr static uint32_t high_load     = EMH_HIGH_LOAD;
+#else
+    constexpr static uint32_t high_load     = 0;
+#endif
+
+    //instrumentation
+    using observer = NullObserver;
+
+    //memory of _pairs and _index, one block each
+    using allocator = MallocAllocator;
+};
+
+template <typename KeyT, typename ValueT, typename HashT = Hash<KeyT>, typename EqT = EqualTo<KeyT>, typename PolicyT = DefaultPolicy>
 class HashMap
 {
+    using ObserverT = typename PolicyT::observer;
+    using AllocT    = typename PolicyT::allocator;
+
 public:
-    using htype = HashMap<KeyT, ValueT, HashT, EqT>;
+    using htype = HashMap<KeyT, ValueT, HashT, EqT, PolicyT>;
     using value_type = std::pair<KeyT, ValueT>;
     using key_type = KeyT;
     using mapped_type = ValueT;
@@ -110,11 +437,7 @@ public:
     //constexpr uint32_t END      = 0-0x1u;
     constexpr static size_type EAD      = 2;
 
-    struct Index
-    {
-        size_type bucket;
-        size_type slot;
-    };
+    using Index = IndexEntry<size_type, PolicyT::str_fingerprint && std::is_same<KeyT, std::string>::value>;
 
     class const_iterator;
     class iterator
@@ -227,7 +550,7 @@ public:
         const value_type* kv_;
     };
 
-    void init(size_type bucket, float mlf = EMH_DEFAULT_LOAD_FACTOR)
+    void init(size_type bucket, float mlf = PolicyT::load_factor)
     {
         _pairs = nullptr;
         _index = nullptr;
@@ -237,7 +560,7 @@ public:
         rehash(bucket);
     }
 
-    HashMap(size_type bucket = 2, float mlf = EMH_DEFAULT_LOAD_FACTOR)
+    HashMap(size_type bucket = 2, float mlf = PolicyT::load_factor)
     {
         init(bucket, mlf);
     }
@@ -245,11 +568,11 @@ public:
     HashMap(const HashMap& rhs)
     {
         if (rhs.load_factor() > EMH_MIN_LOAD_FACTOR) {
-            _pairs = alloc_bucket((size_type)(rhs._num_buckets * rhs.max_load_factor()) + 4);
+            _pairs = alloc_bucket(rhs.slot_capacity(rhs._num_buckets));
             _index = alloc_index(rhs._num_buckets);
             clone(rhs);
         } else {
-            init(rhs._num_filled + 2, EMH_DEFAULT_LOAD_FACTOR);
+            init(rhs._num_filled + 2, PolicyT::load_factor);
             for (auto it = rhs.begin(); it != rhs.end(); ++it)
                 insert_unique(it->first, it->second);
         }
@@ -282,7 +605,7 @@ public:
             return *this;
 
         if (rhs.load_factor() < EMH_MIN_LOAD_FACTOR) {
-            clear(); free(_pairs); _pairs = nullptr;
+            clear(); AllocT::deallocate(_pairs); _pairs = nullptr;
             rehash(rhs._num_filled + 2);
             for (auto it = rhs.begin(); it != rhs.end(); ++it)
                 insert_unique(it->first, it->second);
@@ -292,9 +615,9 @@ public:
         clearkv();
 
         if (_num_buckets != rhs._num_buckets) {
-            free(_pairs); free(_index);
+            AllocT::deallocate(_pairs); AllocT::deallocate(_index);
             _index = alloc_index(rhs._num_buckets);
-            _pairs = alloc_bucket((size_type)(rhs._num_buckets * rhs.max_load_factor()) + 4);
+            _pairs = alloc_bucket(rhs.slot_capacity(rhs._num_buckets));
         }
 
         clone(rhs);
@@ -330,8 +653,8 @@ public:
     ~HashMap() noexcept
     {
         clearkv();
-        free(_pairs);
-        free(_index);
+        AllocT::deallocate(_pairs);
+        AllocT::deallocate(_index);
     }
 
     void clone(const HashMap& rhs)
@@ -343,9 +666,7 @@ public:
         _mlf         = rhs._mlf;
         _last        = rhs._last;
         _mask        = rhs._mask;
-#if EMH_HIGH_LOAD
         _ehead       = rhs._ehead;
-#endif
         _etail       = rhs._etail;
 
         auto opairs  = rhs._pairs;
@@ -371,9 +692,7 @@ public:
         std::swap(_mask, rhs._mask);
         std::swap(_mlf, rhs._mlf);
         std::swap(_last, rhs._last);
-#if EMH_HIGH_LOAD
         std::swap(_ehead, rhs._ehead);
-#endif
         std::swap(_etail, rhs._etail);
     }
 
@@ -414,6 +733,82 @@ public:
     inline constexpr size_type max_size() const { return (1ull << (sizeof(size_type) * 8 - 1)); }
     inline constexpr size_type max_bucket_count() const { return max_size(); }
 
+    /// hash values of n integer keys as this map computes them (hash_key),
+    /// 4-8 keys per instruction through emcpu::hash_keys when EMH_CPU_DISPATCH is on.
+    template<typename K = KeyT, typename std::enable_if<std::is_integral<K>::value, int>::type = 0>
+    void hash_keys(const K* in, uint64_t* out, size_t n) const
+    {
+#if EMH_CPU_DISPATCH && !EMH_WYHASH64
+        if (PolicyT::int_hash) {
+            emcpu::hash_keys<PolicyT::int_hash>(in, out, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; i++)
+            out[i] = hash_key(in[i]);
+    }
+
+    /// Returns a health snapshot of the table, always compiled and read only.
+    /// sample_step > 1 for huge tables looks at every sample_step-th bucket and walks only the
+    /// chains headed there, about 1/sample_step of the work.
+    HashStats stats(size_type sample_step = 1) const
+    {
+        HashStats st;
+        memset(&st, 0, sizeof(st));
+        st.size        = _num_filled;
+        st.buckets     = bucket_count();
+        st.load_factor = load_factor();
+        if (sample_step == 0)
+            sample_step = 1;
+
+        uint64_t occupied = 0, mains = 0, hits = 0, hit_sum = 0, miss_sum = 0, links = 0, link_sum = 0;
+        for (size_type bucket = 0; bucket < _num_buckets; bucket += sample_step) {
+            st.sampled ++;
+            //a miss ends at an empty bucket or at one holding an element of another chain
+            if (EMH_EMPTY(_index, bucket)) {
+                miss_sum ++;
+                continue;
+            }
+            occupied ++;
+            if (hash_main(bucket) != bucket) {
+                miss_sum ++;
+                continue;
+            }
+
+            //only chain heads are walked: the i-th element is found after visiting i buckets, a
+            //miss visits all of them and every link spans what the empty bucket search crossed
+            uint32_t probe = 1;
+            for (auto next_bucket = bucket; EMH_BUCKET(_index, next_bucket) != next_bucket; probe ++) {
+                const auto nbucket = EMH_BUCKET(_index, next_bucket);
+                const auto forward = (nbucket - next_bucket) & _mask, backward = (next_bucket - nbucket) & _mask;
+                const auto distance = (uint32_t)(forward < backward ? forward : backward);
+                links ++;
+                link_sum += distance;
+                if (distance > st.max_link_dist)
+                    st.max_link_dist = distance;
+                next_bucket = nbucket;
+            }
+
+            mains ++;
+            hits    += probe;
+            hit_sum += (uint64_t)probe * (probe + 1) / 2;
+            st.chain_len[probe < HashStats::CHAIN_SLOTS ? probe : HashStats::CHAIN_SLOTS - 1] ++;
+            if (probe > st.max_hit_probe)
+                st.max_hit_probe = probe;
+            miss_sum += probe;
+            if (probe > st.max_miss_probe)
+                st.max_miss_probe = probe;
+        }
+
+        st.main_ratio     = occupied ? (float)mains / occupied : 0;
+        st.avg_hit_probe  = hits ? (float)hit_sum / hits : 0;
+        st.avg_miss_probe = st.sampled ? (float)miss_sum / st.sampled : 0;
+        st.avg_link_dist  = links ? (float)link_sum / links : 0;
+        if (st.max_miss_probe == 0 && st.sampled > 0)
+            st.max_miss_probe = 1;
+        return st;
+    }
+
 #if EMH_STATIS
     //Returns the bucket number where the element with key k is located.
     size_type bucket(const KeyT& key) const
@@ -836,6 +1231,55 @@ public:
         }
     }
 
+    /// index bucket that holds key, INACTIVE when it is missing. two maps with the same slot
+    /// order and the same index_bucket() for every key share one layout.
+    size_type index_bucket(const KeyT& key) const { return find_filled_bucket(key, hash_key(key)); }
+
+    /// hash of key as this map computes it, for the *_hash() calls and prefetch()
+    uint64_t hash_of(const KeyT& key) const { return hash_key(key); }
+
+    /// pull the index bucket of key_hash into cache ahead of a *_hash() call
+    void prefetch(uint64_t key_hash) const
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(static_cast<const void*>(_index + (key_hash & _mask)), 0, 1);
+#else
+        (void)key_hash;
+#endif
+    }
+
+    /// find() with key_hash = hash_of(key) known by the caller
+    const_iterator find_hash(const KeyT& key, uint64_t key_hash) const noexcept
+    {
+        const auto bucket = find_filled_bucket(key, key_hash);
+        return {this, bucket == INACTIVE ? _num_filled : EMH_SLOT(_index, bucket)};
+    }
+
+    /// try_emplace() with key_hash = hash_of(key) known by the caller, no hashing
+    template<typename K, typename V>
+    std::pair<iterator, bool> try_emplace_hash(K&& key, uint64_t key_hash, V&& val)
+    {
+        check_expand_need();
+        const auto bucket = find_or_allocate(key, key_hash);
+        const auto bempty = EMH_EMPTY(_index, bucket);
+        if (bempty) {
+            EMH_NEW(std::forward<K>(key), std::forward<V>(val), bucket, key_hash);
+        }
+
+        const auto slot = EMH_SLOT(_index, bucket);
+        return { {this, slot}, bempty };
+    }
+
+    /// insert_unique() with key_hash = hash_of(key) known by the caller: key must be absent
+    template<typename K, typename V>
+    size_type insert_unique_hash(K&& key, V&& val, uint64_t key_hash)
+    {
+        check_expand_need();
+        const auto bucket = find_unique_bucket(key_hash);
+        EMH_NEW(std::forward<K>(key), std::forward<V>(val), bucket, key_hash);
+        return bucket;
+    }
+
     /// Like std::map<KeyT, ValueT>::operator[].
     ValueT& operator[](const KeyT& key) noexcept
     {
@@ -950,6 +1394,7 @@ public:
     /// Remove all elements, keeping full capacity.
     void clear() noexcept
     {
+        const auto start = event_clock();
         clearkv();
 
         if (_num_filled > 0)
@@ -958,22 +1403,25 @@ public:
         _last = _num_filled = 0;
         _etail = INACTIVE;
 
-#if EMH_HIGH_LOAD
         _ehead = 0;
-#endif
+        notify(EVENT_CLEAR, _num_buckets, _num_buckets, start);
     }
 
-    void shrink_to_fit(const float min_factor = EMH_DEFAULT_LOAD_FACTOR / 4)
+    void shrink_to_fit(const float min_factor = PolicyT::load_factor / 4)
     {
-        if (load_factor() < min_factor && bucket_count() > 10) //safe guard
-            rehash(_num_filled + 1);
+        if (load_factor() < min_factor && bucket_count() > 10) { //safe guard
+            const auto old_buckets = _num_buckets;
+            const auto start = event_clock();
+            rehash((_num_filled * (uint64_t)_mlf >> 27) + 2); //_pairs only holds bucket_count() * max_load_factor()
+            notify(EVENT_SHRINK, old_buckets, _num_buckets, start);
+        }
     }
 
-#if EMH_HIGH_LOAD
     void set_empty()
     {
+        const auto start = event_clock();
         auto prev = 0;
-        for (int32_t bucket = 1; bucket < _num_buckets; ++bucket) {
+        for (int32_t bucket = 1; bucket < (int32_t)_num_buckets; ++bucket) {
             if (EMH_EMPTY(_index, bucket)) {
                 if (prev != 0) {
                     EMH_PREVET(_index, bucket) = prev;
@@ -988,10 +1436,12 @@ public:
         EMH_PREVET(_index, _ehead) = prev;
         EMH_BUCKET(_index, prev) = 0-_ehead;
         _ehead = 0-EMH_BUCKET(_index, _ehead);
+        notify(EVENT_HIGH_LOAD_ON, _num_buckets, _num_buckets, start);
     }
 
     void clear_empty()
     {
+        const auto start = event_clock();
         auto prev = EMH_PREVET(_index, _ehead);
         while (prev != _ehead) {
             EMH_BUCKET(_index, prev) = INACTIVE;
@@ -999,6 +1449,7 @@ public:
         }
         EMH_BUCKET(_index, _ehead) = INACTIVE;
         _ehead = 0;
+        notify(EVENT_HIGH_LOAD_OFF, _num_buckets, _num_buckets, start);
     }
 
     //prev-ehead->next
@@ -1027,34 +1478,33 @@ public:
         EMH_BUCKET(_index, _ehead) = -bucket;
         //        _ehead = bucket;
     }
-#endif
 
     /// Make room for this many elements
     bool reserve(uint64_t num_elems, bool force)
     {
         (void)force;
-#if EMH_HIGH_LOAD == 0
-        const auto required_buckets = num_elems * _mlf >> 27;
-        if (EMH_LIKELY(required_buckets < _mask)) // && !force
-            return false;
-
-#elif EMH_HIGH_LOAD
-        const auto required_buckets = num_elems + num_elems * 1 / 9;
-        if (EMH_LIKELY(required_buckets < _mask))
-            return false;
-
-        else if (_num_buckets < 16 && _num_filled < _num_buckets)
-            return false;
-
-        else if (_num_buckets > EMH_HIGH_LOAD) {
-            if (_ehead == 0) {
-                set_empty();
+        uint64_t required_buckets;
+        if (PolicyT::high_load == 0) {
+            required_buckets = num_elems * _mlf >> 27;
+            if (EMH_LIKELY(required_buckets < _mask)) // && !force
+                return false;
+        } else {
+            required_buckets = num_elems + num_elems * 1 / 9;
+            if (EMH_LIKELY(required_buckets < _mask))
                 return false;
-            } else if (/*_num_filled + 100 < _num_buckets && */EMH_BUCKET(_index, _ehead) != 0-_ehead) {
+
+            else if (_num_buckets < 16 && _num_filled < _num_buckets)
                 return false;
+
+            else if (_num_buckets > PolicyT::high_load) {
+                if (_ehead == 0) {
+                    set_empty();
+                    return false;
+                } else if (/*_num_filled + 100 < _num_buckets && */EMH_BUCKET(_index, _ehead) != 0-_ehead) {
+                    return false;
+                }
             }
         }
-#endif
 #if EMH_STATIS
         if (_num_filled > EMH_STATIS) dump_statics();
 #endif
@@ -1064,15 +1514,23 @@ public:
         return true;
     }
 
+    //_pairs capacity for num_buckets, the high load mode fills buckets past max_load_factor()
+    size_type slot_capacity(size_type num_buckets) const
+    {
+        if (PolicyT::high_load)
+            return num_buckets + 4;
+        return (size_type)(num_buckets * max_load_factor()) + 4;
+    }
+
     static value_type* alloc_bucket(size_type num_buckets)
     {
-        auto new_pairs = (char*)malloc((uint64_t)num_buckets * sizeof(value_type));
+        auto new_pairs = (char*)AllocT::allocate((uint64_t)num_buckets * sizeof(value_type));
         return (value_type *)(new_pairs);
     }
 
     static Index* alloc_index(size_type num_buckets)
     {
-        auto new_index = (char*)malloc((uint64_t)(EAD + num_buckets) * sizeof(Index));
+        auto new_index = (char*)AllocT::allocate((uint64_t)(EAD + num_buckets) * sizeof(Index));
         return (Index *)(new_index);
     }
 
@@ -1082,17 +1540,15 @@ public:
             return reserve(required_buckets, true);
 
         _last = 0;
-#if EMH_HIGH_LOAD
         _ehead = 0;
-#endif
 
-#if EMH_SORT
-        std::sort(_pairs, _pairs + _num_filled, [this](const value_type & l, const value_type & r) {
-            const auto hashl = (size_type)hash_key(l.first) & _mask, hashr = (size_type)hash_key(r.first) & _mask;
-            return hashl < hashr;
-            //return l.first < r.first;
-        });
-#endif
+        if (PolicyT::sort_rehash) {
+            std::sort(_pairs, _pairs + _num_filled, [this](const value_type & l, const value_type & r) {
+                const auto hashl = (size_type)hash_key(l.first) & _mask, hashr = (size_type)hash_key(r.first) & _mask;
+                return hashl < hashr;
+                //return l.first < r.first;
+            });
+        }
 
         memset((char*)_index, INACTIVE, sizeof(_index[0]) * _num_buckets);
         for (size_type slot = 0; slot < _num_filled; slot++) {
@@ -1100,9 +1556,10 @@ public:
             const auto key_hash = hash_key(key);
             const auto bucket = size_type(key_hash & _mask);
             auto& next_bucket = EMH_BUCKET(_index, bucket);
-            if ((int)next_bucket < 0)
+            if ((int)next_bucket < 0) {
                 EMH_INDEX(_index, bucket) = {1, slot | EMH_KEYMASK(key_hash, _mask)};
-            else {
+                set_fp(EMH_INDEX(_index, bucket), key_hash, key);
+            } else {
                 EMH_HSLOT(_index, bucket) |= EMH_KEYMASK(key_hash, _mask);
                 next_bucket ++;
             }
@@ -1112,8 +1569,8 @@ public:
 
     void rebuild(size_type num_buckets) noexcept
     {
-        free(_index);
-        auto new_pairs = (value_type*)alloc_bucket((size_type)(num_buckets * max_load_factor()) + 4);
+        AllocT::deallocate(_index);
+        auto new_pairs = (value_type*)alloc_bucket(slot_capacity(num_buckets));
         if (is_copy_trivially()) {
             memcpy((char*)new_pairs, (char*)_pairs, _num_filled * sizeof(value_type));
         } else {
@@ -1123,7 +1580,7 @@ public:
                     _pairs[slot].~value_type();
             }
         }
-        free(_pairs);
+        AllocT::deallocate(_pairs);
         _pairs = new_pairs;
         _index = (Index*)alloc_index (num_buckets);
 
@@ -1140,42 +1597,47 @@ public:
         auto num_buckets = _num_filled > (1u << 16) ? (1u << 16) : 4u;
         while (num_buckets < required_buckets) { num_buckets *= 2; }
 
+        const auto old_buckets = _num_buckets;
+        const auto start = event_clock();
+        notify(EVENT_REHASH_BEGIN, old_buckets, num_buckets, 0);
+
 #if EMH_REHASH_LOG
         auto last = _last;
         size_type collision = 0;
 #endif
 
-#if EMH_HIGH_LOAD
         _ehead = 0;
-#endif
-        _last = _mask / 4;
-
         _mask        = num_buckets - 1;
-#if EMH_PACK_TAIL > 1
-        _last = _mask;
-        num_buckets += num_buckets * EMH_PACK_TAIL / 100; //add more 5-10%
-#endif
+        _last        = _mask / 4; //after _mask, a shrink must not leave _last past the new table
+        if (PolicyT::pack_tail > 1) {
+            _last = _mask;
+            num_buckets += num_buckets * PolicyT::pack_tail / 100; //add more 5-10%
+        }
         _num_buckets = num_buckets;
 
         rebuild(num_buckets);
 
-#ifdef EMH_SORT
-        std::sort(_pairs, _pairs + _num_filled, [this](const value_type & l, const value_type & r) {
-            const auto hashl = hash_key(l.first), hashr = hash_key(r.first);
-            auto diff = int64_t((hashl & _mask) - (hashr & _mask));
-            if (diff != 0)
-                return diff < 0;
-            return hashl < hashr;
-//          return l.first < r.first;
-        });
-#endif
+        if (PolicyT::sort_rehash) {
+            std::sort(_pairs, _pairs + _num_filled, [this](const value_type & l, const value_type & r) {
+                const auto hashl = hash_key(l.first), hashr = hash_key(r.first);
+                auto diff = int64_t((hashl & _mask) - (hashr & _mask));
+                if (diff != 0)
+                    return diff < 0;
+                return hashl < hashr;
+//              return l.first < r.first;
+            });
+        }
 
         _etail = INACTIVE;
+        uint64_t slot_hash[EMH_HASH_BATCH];
         for (size_type slot = 0; slot < _num_filled; ++slot) {
             const auto& key = EMH_KEY(_pairs, slot);
-            const auto key_hash = hash_key(key);
+            if (batch_hash() && slot % EMH_HASH_BATCH == 0)
+                hash_slots(slot, std::min<size_type>(EMH_HASH_BATCH, _num_filled - slot), slot_hash);
+            const auto key_hash = batch_hash() ? slot_hash[slot % EMH_HASH_BATCH] : hash_key(key);
             const auto bucket = find_unique_bucket(key_hash);
             EMH_INDEX(_index, bucket) = {bucket, slot | EMH_KEYMASK(key_hash, _mask)};
+            set_fp(EMH_INDEX(_index, bucket), key_hash, key);
 
 #if EMH_REHASH_LOG
             if (bucket != hash_main(bucket))
@@ -1196,9 +1658,239 @@ public:
 #endif
         }
 #endif
+        notify(EVENT_REHASH_END, old_buckets, _num_buckets, start);
+    }
+
+    /// rehash() with the work that does not decide the layout run as tasks of exec (see
+    /// SerialExecutor): _pairs is copied, the index cleared and every key hashed in parallel,
+    /// then the calling thread places the keys exactly as rehash() does, reading the hashes
+    /// instead of hashing kicked out keys again. the layout is the one rehash() builds, with
+    /// every executor. SerialExecutor and small tables go straight to rehash().
+    template<typename Exec>
+    void parallel_rehash(uint64_t required_buckets, Exec&& exec)
+    {
+        if (required_buckets < _num_filled)
+            return;
+        else if (PolicyT::high_load || PolicyT::sort_rehash || _num_filled < EMH_PARALLEL_RANGE
+                || std::is_same<typename std::decay<Exec>::type, SerialExecutor>::value) {
+            rehash(required_buckets);
+            return;
+        }
+
+        assert(required_buckets < max_size());
+        auto num_buckets = _num_filled > (1u << 16) ? (1u << 16) : 4u;
+        while (num_buckets < required_buckets) { num_buckets *= 2; }
+
+        const auto old_buckets = _num_buckets;
+        const auto start = event_clock();
+        notify(EVENT_REHASH_BEGIN, old_buckets, num_buckets, 0);
+
+        _ehead = 0;
+        _mask        = num_buckets - 1;
+        _last        = _mask / 4;
+        if (PolicyT::pack_tail > 1) {
+            _last = _mask;
+            num_buckets += num_buckets * PolicyT::pack_tail / 100;
+        }
+        _num_buckets = num_buckets;
+        _etail       = INACTIVE;
+
+        const auto filled = _num_filled;
+        const auto chunk  = std::max<size_type>(EMH_PARALLEL_RANGE, filled / 256 + 1);
+        const auto chunks = (filled + chunk - 1) / chunk;
+        rebuild(num_buckets, exec, chunk, chunks);
+
+        auto hashes = (uint64_t*)malloc(sizeof(uint64_t) * filled);
+        exec((size_t)chunks, [&](size_t c) {
+            const auto first = (size_type)c * chunk, last = std::min(first + chunk, filled);
+            for (auto slot = first; slot < last; slot += EMH_HASH_BATCH) {
+                const auto n = std::min<size_type>(EMH_HASH_BATCH, last - slot);
+                if (batch_hash())
+                    hash_slots(slot, n, hashes + slot);
+                else for (size_type i = 0; i < n; i++)
+                    hashes[slot + i] = hash_key(EMH_KEY(_pairs, slot + i));
+            }
+        });
+
+        for (size_type slot = 0; slot < filled; ++slot) {
+            const auto key_hash = hashes[slot];
+            const auto bucket = find_unique_bucket(key_hash, hashes);
+            EMH_INDEX(_index, bucket) = {bucket, slot | EMH_KEYMASK(key_hash, _mask)};
+            set_fp(EMH_INDEX(_index, bucket), key_hash, EMH_KEY(_pairs, slot));
+        }
+
+        free(hashes);
+        notify(EVENT_REHASH_END, old_buckets, _num_buckets, start);
+    }
+
+    /// fn(pair) for every element, fixed ranges of slots run as tasks of exec (see
+    /// SerialExecutor). fn may change values, never insert or erase.
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn)
+    {
+        parallel_slots(exec, [&](size_t, size_type slot) { fn(_pairs[slot]); });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_for_each(Exec&& exec, F fn) const
+    {
+        parallel_slots(exec, [&](size_t, size_type slot) { fn((const value_type&)_pairs[slot]); });
+    }
+
+    /// combine(init, map(pair)) over all elements: every range folds its own elements, then
+    /// the ranges are folded into init in slot order, so any executor gives the same result.
+    template<typename Exec, typename T, typename M, typename C>
+    T parallel_reduce(Exec&& exec, T init, M map, C combine) const
+    {
+        std::vector<T> parts(parallel_tasks(), init);
+        std::vector<uint8_t> used(parts.size(), 0);
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            T part = map((const value_type&)_pairs[first]);
+            for (auto slot = first + 1; slot < last; slot++)
+                part = combine(std::move(part), map((const value_type&)_pairs[slot]));
+            parts[task] = std::move(part), used[task] = 1;
+        });
+        for (size_t task = 0; task < parts.size(); task++) {
+            if (used[task])
+                init = combine(std::move(init), std::move(parts[task]));
+        }
+        return init;
+    }
+
+    /// erase_if() with pred run in parallel. pred only marks, then the calling thread either
+    /// erases the few victims from the tail down, or, past a quarter of the table, compacts
+    /// _pairs in one pass keeping the slot order and rebuilds the index with parallel_rehash().
+    template<typename Exec, typename Pred>
+    size_type parallel_erase_if(Exec&& exec, Pred pred)
+    {
+        auto marks = (uint64_t*)calloc(_num_filled / 64 + 1, sizeof(uint64_t));
+        std::vector<size_type> victims(parallel_tasks(), 0);
+        parallel_slots(exec, [&](size_t task, size_type slot) {
+            if (pred((const value_type&)_pairs[slot])) {
+                marks[slot / 64] |= 1ull << (slot % 64);
+                victims[task] ++;
+            }
+        });
+
+        size_type erased = 0;
+        for (auto n : victims) erased += n;
+        if (erased > _num_filled / 4) {
+            size_type keep = 0;
+            for (size_type slot = 0; slot < _num_filled; slot++) {
+                if (marks[slot / 64] >> (slot % 64) & 1)
+                    continue;
+                else if (keep != slot)
+                    EMH_KV(_pairs, keep) = std::move(EMH_KV(_pairs, slot));
+                keep ++;
+            }
+            if (is_triviall_destructable()) {
+                for (auto slot = keep; slot < _num_filled; slot++)
+                    _pairs[slot].~value_type();
+            }
+            _num_filled = keep;
+            parallel_rehash(_mask + 1, exec);
+        } else if (erased > 0) {
+            //the last slot moved into an erased one is always a survivor
+            for (auto slot = _num_filled; slot-- > 0; ) {
+                if (marks[slot / 64] >> (slot % 64) & 1) {
+                    size_type main_bucket;
+                    const auto sbucket = find_slot_bucket(slot, main_bucket);
+                    erase_slot(sbucket, main_bucket);
+                }
+            }
+        }
+        free(marks);
+        return erased;
     }
 
 private:
+    //fixed ranges of 64 slots multiples, the same with every executor
+    size_t parallel_tasks() const { return (_num_filled + parallel_range() - 1) / parallel_range(); }
+    size_type parallel_range() const { return (std::max<size_type>(EMH_PARALLEL_RANGE, _num_filled / 256) + 63) / 64 * 64; }
+
+    //f(task, first, last) for every range, never empty
+    template<typename Exec, typename F>
+    void parallel_ranges(Exec& exec, const F& f) const
+    {
+        const auto range = parallel_range();
+        exec(parallel_tasks(), [&](size_t task) {
+            const auto first = (size_type)task * range;
+            f(task, first, std::min<size_type>(_num_filled, first + range));
+        });
+    }
+
+    template<typename Exec, typename F>
+    void parallel_slots(Exec& exec, const F& f) const
+    {
+        parallel_ranges(exec, [&](size_t task, size_type first, size_type last) {
+            for (auto slot = first; slot < last; slot++)
+                f(task, slot);
+        });
+    }
+
+    template<typename Exec>
+    void rebuild(size_type num_buckets, Exec& exec, size_type chunk, size_type chunks)
+    {
+        AllocT::deallocate(_index);
+        auto new_pairs = (value_type*)alloc_bucket(slot_capacity(num_buckets));
+        exec((size_t)chunks, [&](size_t c) {
+            const auto first = (size_type)c * chunk, last = std::min(first + chunk, _num_filled);
+            if (is_copy_trivially()) {
+                memcpy((char*)(new_pairs + first), (char*)(_pairs + first), (last - first) * sizeof(value_type));
+            } else {
+                for (auto slot = first; slot < last; slot++) {
+                    new(new_pairs + slot) value_type(std::move(_pairs[slot]));
+                    if (is_triviall_destructable())
+                        _pairs[slot].~value_type();
+                }
+            }
+        });
+        AllocT::deallocate(_pairs);
+        _pairs = new_pairs;
+        _index = (Index*)alloc_index (num_buckets);
+
+        exec((size_t)chunks, [&](size_t c) {
+            const auto first = (uint64_t)num_buckets * c / chunks, last = (uint64_t)num_buckets * (c + 1) / chunks;
+            memset((char*)(_index + first), INACTIVE, sizeof(_index[0]) * (last - first));
+        });
+        memset((char*)(_index + num_buckets), 0, sizeof(_index[0]) * EAD);
+    }
+
+    //integer keys with a policy mixer are hashed EMH_HASH_BATCH at a time by rehash()
+    static constexpr bool batch_hash()
+    {
+#if EMH_CPU_DISPATCH && !EMH_WYHASH64
+        return std::is_integral<KeyT>::value && PolicyT::int_hash != 0;
+#else
+        return false;
+#endif
+    }
+
+    template<typename K = KeyT, typename std::enable_if<std::is_integral<K>::value, int>::type = 0>
+    void hash_slots(size_type from, size_type n, uint64_t* out) const
+    {
+        K keys[EMH_HASH_BATCH];
+        for (size_type i = 0; i < n; i++)
+            keys[i] = EMH_KEY(_pairs, from + i);
+        hash_keys(keys, out, n);
+    }
+
+    template<typename K = KeyT, typename std::enable_if<!std::is_integral<K>::value, int>::type = 0>
+    void hash_slots(size_type, size_type, uint64_t*) const { }
+
+    static uint64_t event_clock()
+    {
+        if (!ObserverT::enabled)
+            return 0;
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void notify(EventType type, uint64_t old_buckets, uint64_t new_buckets, uint64_t start) const
+    {
+        if (ObserverT::enabled)
+            ObserverT::on_event({this, type, old_buckets, new_buckets, _num_filled, start ? event_clock() - start : 0});
+    }
+
     // Can we fit another element?
     inline bool check_expand_need()
     {
@@ -1230,14 +1922,12 @@ private:
 
         _etail = INACTIVE;
         EMH_INDEX(_index, ebucket) = {INACTIVE, 0};
-#if EMH_HIGH_LOAD
-        if (_ehead) {
+        if (PolicyT::high_load && _ehead) {
             if (10 * _num_filled < 8 * _num_buckets)
                 clear_empty();
             else if (ebucket)
                 push_empty(ebucket);
         }
-#endif
     }
 
     size_type erase_bucket(const size_type bucket, const size_type main_bucket) noexcept
@@ -1246,10 +1936,8 @@ private:
         if (bucket == main_bucket) {
             if (main_bucket != next_bucket) {
                 const auto nbucket = EMH_BUCKET(_index, next_bucket);
-                EMH_INDEX(_index, main_bucket) = {
-                    (nbucket == next_bucket) ? main_bucket : nbucket,
-                    EMH_HSLOT(_index, next_bucket)
-                };
+                EMH_INDEX(_index, main_bucket) = EMH_INDEX(_index, next_bucket);
+                EMH_BUCKET(_index, main_bucket) = (nbucket == next_bucket) ? main_bucket : nbucket;
             }
             return next_bucket;
         }
@@ -1285,7 +1973,7 @@ private:
         if (EMH_UNLIKELY((int)next_bucket < 0))
             return INACTIVE;
 
-        if (EMH_EQHASH(bucket, key_hash)) {
+        if (EMH_EQHASH(bucket, key_hash, key)) {
             const auto slot = EMH_SLOT(_index, bucket);
             if (EMH_LIKELY(_eq(key, EMH_KEY(_pairs, slot))))
                 return bucket;
@@ -1294,7 +1982,7 @@ private:
             return INACTIVE;
 
         while (true) {
-            if (EMH_EQHASH(next_bucket, key_hash)) {
+            if (EMH_EQHASH(next_bucket, key_hash, key)) {
                 const auto slot = EMH_SLOT(_index, next_bucket);
                 if (EMH_LIKELY(_eq(key, EMH_KEY(_pairs, slot))))
                     return next_bucket;
@@ -1319,7 +2007,7 @@ private:
         if ((int)next_bucket < 0)
             return _num_filled;
 
-        if (EMH_EQHASH(bucket, key_hash)) {
+        if (EMH_EQHASH(bucket, key_hash, key)) {
             const auto slot = EMH_SLOT(_index, bucket);
             if (EMH_LIKELY(_eq(key, EMH_KEY(_pairs, slot))))
                 return slot;
@@ -1328,7 +2016,7 @@ private:
             return _num_filled;
 
         while (true) {
-            if (EMH_EQHASH(next_bucket, key_hash)) {
+            if (EMH_EQHASH(next_bucket, key_hash, key)) {
                 const auto slot = EMH_SLOT(_index, next_bucket);
                 if (EMH_LIKELY(_eq(key, EMH_KEY(_pairs, slot))))
                     return slot;
@@ -1423,7 +2111,8 @@ private:
         const auto prev_bucket = find_prev_bucket(kmain, bucket);
 
         const auto last = next_bucket == bucket ? new_bucket : next_bucket;
-        EMH_INDEX(_index, new_bucket) = {last, EMH_HSLOT(_index, bucket)};
+        EMH_INDEX(_index, new_bucket) = EMH_INDEX(_index, bucket);
+        EMH_BUCKET(_index, new_bucket) = last;
 
         EMH_BUCKET(_index, prev_bucket) = new_bucket;
         EMH_BUCKET(_index, bucket) = INACTIVE;
@@ -1444,15 +2133,13 @@ private:
         const auto bucket = size_type(key_hash & _mask);
         auto next_bucket = EMH_BUCKET(_index, bucket);
         if ((int)next_bucket < 0) {
-#if EMH_HIGH_LOAD
-            if (next_bucket != INACTIVE)
+            if (PolicyT::high_load && next_bucket != INACTIVE)
                 pop_empty(bucket);
-#endif
             return bucket;
         }
 
         const auto slot = EMH_SLOT(_index, bucket);
-        if (EMH_EQHASH(bucket, key_hash))
+        if (EMH_EQHASH(bucket, key_hash, key))
             if (EMH_LIKELY(_eq(key, EMH_KEY(_pairs, slot))))
             return bucket;
 
@@ -1467,7 +2154,7 @@ private:
         //find next linked bucket and check key
         while (true) {
             const auto eslot = EMH_SLOT(_index, next_bucket);
-            if (EMH_EQHASH(next_bucket, key_hash)) {
+            if (EMH_EQHASH(next_bucket, key_hash, key)) {
                 if (EMH_LIKELY(_eq(key, EMH_KEY(_pairs, eslot))))
                 return next_bucket;
             }
@@ -1489,10 +2176,8 @@ private:
         const auto bucket = size_type(key_hash & _mask);
         auto next_bucket = EMH_BUCKET(_index, bucket);
         if ((int)next_bucket < 0) {
-#if EMH_HIGH_LOAD
-            if (next_bucket != INACTIVE)
+            if (PolicyT::high_load && next_bucket != INACTIVE)
                 pop_empty(bucket);
-#endif
             return bucket;
         }
 
@@ -1506,6 +2191,23 @@ private:
         return EMH_BUCKET(_index, next_bucket) = find_empty_bucket(next_bucket, 2);
     }
 
+    //find_unique_bucket() of parallel_rehash(): main buckets come from the hashes of the slots
+    size_type find_unique_bucket(uint64_t key_hash, const uint64_t* hashes) noexcept
+    {
+        const auto bucket = size_type(key_hash & _mask);
+        auto next_bucket = EMH_BUCKET(_index, bucket);
+        if ((int)next_bucket < 0)
+            return bucket;
+
+        const auto kmain = size_type(hashes[EMH_SLOT(_index, bucket)] & _mask);
+        if (EMH_UNLIKELY(kmain != bucket))
+            return kickout_bucket(kmain, bucket);
+        else if (EMH_UNLIKELY(next_bucket != bucket))
+            next_bucket = find_last_bucket(next_bucket);
+
+        return EMH_BUCKET(_index, next_bucket) = find_empty_bucket(next_bucket, 2);
+    }
+
 /***
   Different probing techniques usually provide a trade-off between memory locality and avoidance of clustering.
 Since Robin Hood hashing is relatively resilient to clustering (both primary and secondary), linear probing is the most cache friendly alternativeis typically used.
@@ -1522,58 +2224,56 @@ one-way search strategy.
     // key is not in this mavalue. Find a place to put it.
     size_type find_empty_bucket(const size_type bucket_from, uint32_t csize) noexcept
     {
-#if EMH_HIGH_LOAD
-        if (_ehead)
+        if (PolicyT::high_load && _ehead)
             return pop_empty(_ehead);
-#endif
 
         auto bucket = bucket_from;
         if (EMH_EMPTY(_index, ++bucket) || EMH_EMPTY(_index, ++bucket))
             return bucket;
 
-#ifdef EMH_QUADRATIC
-        constexpr size_type linear_probe_length = 2 * EMH_CACHE_LINE_SIZE / sizeof(Index);//16
-        for (size_type offset = csize + 2, step = 4; offset <= linear_probe_length; ) {
-            bucket = (bucket_from + offset) & _mask;
-            if (EMH_EMPTY(_index, bucket) || EMH_EMPTY(_index, ++bucket))
-                return bucket;
-            offset += step; //7/8. 12. 16
-        }
-#else
-        constexpr size_type quadratic_probe_length = 6u;
-        for (size_type offset = 4u, step = 3u; step < quadratic_probe_length; ) {
-            bucket = (bucket_from + offset) & _mask;
-            if (EMH_EMPTY(_index, bucket) || EMH_EMPTY(_index, ++bucket))
-                return bucket;
-            offset += step++;//3.4.5
+        if (PolicyT::quadratic) {
+            constexpr size_type linear_probe_length = 2 * EMH_CACHE_LINE_SIZE / sizeof(Index);//16
+            for (size_type offset = csize + 2, step = 4; offset <= linear_probe_length; ) {
+                bucket = (bucket_from + offset) & _mask;
+                if (EMH_EMPTY(_index, bucket) || EMH_EMPTY(_index, ++bucket))
+                    return bucket;
+                offset += step; //7/8. 12. 16
+            }
+        } else {
+            constexpr size_type quadratic_probe_length = 6u;
+            for (size_type offset = 4u, step = 3u; step < quadratic_probe_length; ) {
+                bucket = (bucket_from + offset) & _mask;
+                if (EMH_EMPTY(_index, bucket) || EMH_EMPTY(_index, ++bucket))
+                    return bucket;
+                offset += step++;//3.4.5
+            }
         }
-#endif
 
 #if EMH_PREFETCH
         __builtin_prefetch(static_cast<const void*>(_index + _last + 1), 0, EMH_PREFETCH);
 #endif
 
         for (;;) {
-#if EMH_PACK_TAIL
-            //find empty bucket and skip next
-            if (EMH_EMPTY(_index, _last++))// || EMH_EMPTY(_index, _last++))
-                return _last++ - 1;
+            if (PolicyT::pack_tail) {
+                //find empty bucket and skip next
+                if (EMH_EMPTY(_index, _last++))// || EMH_EMPTY(_index, _last++))
+                    return _last++ - 1;
 
-            if (EMH_UNLIKELY(_last >= _num_buckets))
-                _last = 0;
+                if (EMH_UNLIKELY(_last >= _num_buckets))
+                    _last = 0;
 
-            auto medium = (_mask / 4 + _last++) & _mask;
-            if (EMH_EMPTY(_index, medium))
-                return medium;
-#else
-            if (EMH_EMPTY(_index, ++_last))// || EMH_EMPTY(_index, ++_last))
-                return _last++;
+                auto medium = (_mask / 4 + _last++) & _mask;
+                if (EMH_EMPTY(_index, medium))
+                    return medium;
+            } else {
+                if (EMH_EMPTY(_index, ++_last))// || EMH_EMPTY(_index, ++_last))
+                    return _last++;
 
-            _last &= _mask;
-            auto medium = (_num_buckets / 2 + _last) & _mask;
-            if (EMH_EMPTY(_index, medium))// || EMH_EMPTY(_index, ++medium))
-                return _last = medium;
-#endif
+                _last &= _mask;
+                auto medium = (_num_buckets / 2 + _last) & _mask;
+                if (EMH_EMPTY(_index, medium))// || EMH_EMPTY(_index, ++medium))
+                    return _last = medium;
+            }
         }
 
         return 0;
@@ -1618,35 +2318,39 @@ one-way search strategy.
         return (size_type)hash_key(EMH_KEY(_pairs, slot)) & _mask;
     }
 
-#if EMH_INT_HASH
+public:
     static constexpr uint64_t KC = UINT64_C(11400714819323198485);
+    //integer mixer selected by PolicyT::int_hash
     static uint64_t hash64(uint64_t key)
     {
-#if __SIZEOF_INT128__ && EMH_INT_HASH == 1
-        __uint128_t r = key; r *= KC;
-        return (uint64_t)(r >> 64) + (uint64_t)r;
-#elif EMH_INT_HASH == 2
-        //MurmurHash3Mixer
-        uint64_t h = key;
-        h ^= h >> 33;
-        h *= 0xff51afd7ed558ccd;
-        h ^= h >> 33;
-        h *= 0xc4ceb9fe1a85ec53;
-        h ^= h >> 33;
-        return h;
-#elif _WIN64 && EMH_INT_HASH == 1
-        uint64_t high;
-        return _umul128(key, KC, &high) + high;
-#elif EMH_INT_HASH == 3
-        auto ror  = (key >> 32) | (key << 32);
-        auto low  = key * 0xA24BAED4963EE407ull;
-        auto high = ror * 0x9FB21C651E98DF25ull;
-        auto mix  = low + high;
-        return mix;
-#elif EMH_INT_HASH == 1
-        uint64_t r = key * UINT64_C(0xca4bcaa75ec3f625);
-        return (r >> 32) + r;
-#elif EMH_WYHASH64
+        if (PolicyT::int_hash == 1) {
+#if __SIZEOF_INT128__
+            __uint128_t r = key; r *= KC;
+            return (uint64_t)(r >> 64) + (uint64_t)r;
+#elif _WIN64
+            uint64_t high;
+            return _umul128(key, KC, &high) + high;
+#else
+            uint64_t r = key * UINT64_C(0xca4bcaa75ec3f625);
+            return (r >> 32) + r;
+#endif
+        } else if (PolicyT::int_hash == 2) {
+            //MurmurHash3Mixer
+            uint64_t h = key;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccd;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53;
+            h ^= h >> 33;
+            return h;
+        } else if (PolicyT::int_hash == 3) {
+            auto ror  = (key >> 32) | (key << 32);
+            auto low  = key * 0xA24BAED4963EE407ull;
+            auto high = ror * 0x9FB21C651E98DF25ull;
+            auto mix  = low + high;
+            return mix;
+        }
+#if EMH_WYHASH64
         return wyhash64(key, KC);
 #else
         uint64_t x = key;
@@ -1656,11 +2360,10 @@ one-way search strategy.
         return x;
 #endif
     }
-#endif
+private:
 
-#if EMH_WYHASH_HASH
     //#define WYHASH_CONDOM 1
-    inline uint64_t wymix(uint64_t A, uint64_t B)
+    static inline uint64_t wymix(uint64_t A, uint64_t B)
     {
 #if defined(__SIZEOF_INT128__)
         __uint128_t r = A; r *= B;
@@ -1738,37 +2441,69 @@ public:
 
         return wymix(secret[1] ^ len, wymix(a ^ secret[1], b ^ seed));
     }
-#endif
 
 private:
     template<typename UType, typename std::enable_if<std::is_integral<UType>::value, uint32_t>::type = 0>
     inline uint64_t hash_key(const UType key) const
     {
-#if EMH_INT_HASH
-        return hash64(key);
-#elif EMH_IDENTITY_HASH
-        return key + (key >> 24);
-#else
+        if (PolicyT::int_hash)
+            return hash64((uint64_t)key);
+        else if (PolicyT::identity_hash)
+            return key + (key >> 24);
+        return _hasher(key);
+    }
+
+    template<typename UType, typename std::enable_if<std::is_enum<UType>::value, uint32_t>::type = 0>
+    inline uint64_t hash_key(const UType key) const
+    {
+        if (PolicyT::int_hash)
+            return hash64((uint64_t)(typename std::underlying_type<UType>::type)key);
         return _hasher(key);
-#endif
     }
 
     template<typename UType, typename std::enable_if<std::is_same<UType, std::string>::value, uint32_t>::type = 0>
     inline uint64_t hash_key(const UType& key) const
     {
-#if EMH_WYHASH_HASH
-        return wyhashstr(key.data(), key.size());
-#else
+        if (PolicyT::wyhash_str)
+            return wyhashstr(key.data(), key.size());
         return _hasher(key);
-#endif
     }
 
-    template<typename UType, typename std::enable_if<!std::is_integral<UType>::value && !std::is_same<UType, std::string>::value, uint32_t>::type = 0>
+    template<typename UType, typename std::enable_if<!std::is_integral<UType>::value && !std::is_enum<UType>::value && !std::is_same<UType, std::string>::value, uint32_t>::type = 0>
     inline uint64_t hash_key(const UType& key) const
     {
         return _hasher(key);
     }
 
+    //fingerprint: hash bits 40..63 (the slot keeps the low ones) and the length low byte
+    static inline uint32_t make_fp(uint64_t key_hash, size_t len)
+    {
+        return ((uint32_t)(key_hash >> 32) & ~0xFFu) | (uint8_t)len;
+    }
+
+    template<typename K>
+    static inline void set_fp(IndexEntry<size_type, false>&, uint64_t, const K&) { }
+    template<typename K>
+    static inline void set_fp(IndexEntry<size_type, true>& index, uint64_t key_hash, const K& key)
+    {
+        index.fp = make_fp(key_hash, key.size());
+    }
+
+    template<typename K>
+    static inline bool match_fp(const IndexEntry<size_type, false>&, uint64_t, const K&, int) { return true; }
+    template<typename K>
+    static inline auto match_fp(const IndexEntry<size_type, true>& index, uint64_t key_hash, const K& key, int)
+        -> decltype(key.size(), bool())
+    {
+        return index.fp == make_fp(key_hash, key.size());
+    }
+    //heterogeneous keys without size() (const char*) only compare the hash bits
+    template<typename K>
+    static inline bool match_fp(const IndexEntry<size_type, true>& index, uint64_t key_hash, const K&, long)
+    {
+        return (index.fp >> 8) == (make_fp(key_hash, 0) >> 8);
+    }
+
 private:
     Index*    _index;
     value_type*_pairs;
@@ -1780,10 +2515,259 @@ private:
     size_type _num_buckets;
     size_type _num_filled;
     size_type _last;
-#if EMH_HIGH_LOAD
     size_type _ehead;
-#endif
     size_type _etail;
 };
+
+#if __cplusplus >= 201703L || _MSVC_LANG >= 201703L
+/// key of StringMap: where the characters are in the arena and their hash, 16 bytes, no heap block
+struct ArenaKey
+{
+    uint64_t offset;
+    uint32_t size;
+    uint32_t hash;
+};
+
+/// HashMap of string keys whose characters are appended to one arena owned by the map.
+/// _pairs only hold ArenaKey, so a key costs 16 bytes plus its characters, rehash never reads
+/// them (the hash is kept) and clear()/~StringMap release two blocks whatever the size.
+/// characters of erased keys stay in the arena until compact(), done by shrink_to_fit() and
+/// when the arena has to grow while half of it is garbage. lookups take std::string_view,
+/// iterators yield std::pair<ArenaKey, ValueT>, key(it->first) returns the string.
+template <typename ValueT, typename HashT = std::hash<std::string_view>, typename PolicyT = DefaultPolicy>
+class StringMap
+{
+    //lookup key: the string and the arena it is compared against, hashed once by StringMap
+    struct Probe
+    {
+        std::string_view key;
+        const char* arena;
+        uint32_t hash;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const ArenaKey& key) const { return key.hash; }
+        size_t operator()(const Probe& key) const { return key.hash; }
+    };
+
+    struct KeyEqual
+    {
+        bool operator()(const Probe& lhs, const ArenaKey& rhs) const
+        {
+            return lhs.key.size() == rhs.size && memcmp(lhs.key.data(), lhs.arena + rhs.offset, rhs.size) == 0;
+        }
+        //keys of one map never share characters
+        bool operator()(const ArenaKey& lhs, const ArenaKey& rhs) const { return lhs.offset == rhs.offset; }
+    };
+
+public:
+    using map_type = HashMap<ArenaKey, ValueT, KeyHash, KeyEqual, PolicyT>;
+    using size_type = typename map_type::size_type;
+    using value_type = typename map_type::value_type;
+    using iterator = typename map_type::iterator;
+    using const_iterator = typename map_type::const_iterator;
+
+    StringMap(size_type bucket = 2, float mlf = PolicyT::load_factor) : _map(bucket, mlf) { }
+
+    StringMap(const StringMap& rhs) : _map(rhs._map), _hasher(rhs._hasher)
+    {
+        grow(rhs._size);
+        if (rhs._size)
+            memcpy(_arena, rhs._arena, rhs._size);
+        _size = rhs._size;
+        _garbage = rhs._garbage;
+    }
+
+    StringMap(StringMap&& rhs) noexcept { swap(rhs); }
+
+    StringMap& operator=(StringMap rhs) noexcept
+    {
+        swap(rhs);
+        return *this;
+    }
+
+    ~StringMap() noexcept { free(_arena); }
+
+    void swap(StringMap& rhs) noexcept
+    {
+        _map.swap(rhs._map);
+        std::swap(_hasher, rhs._hasher);
+        std::swap(_arena, rhs._arena);
+        std::swap(_size, rhs._size);
+        std::swap(_capacity, rhs._capacity);
+        std::swap(_garbage, rhs._garbage);
+    }
+
+    inline iterator begin() { return _map.begin(); }
+    inline iterator end() { return _map.end(); }
+    inline const_iterator begin() const { return _map.begin(); }
+    inline const_iterator end() const { return _map.end(); }
+
+    inline size_type size() const { return _map.size(); }
+    inline bool empty() const { return _map.empty(); }
+    inline size_type bucket_count() const { return _map.bucket_count(); }
+    inline float load_factor() const { return _map.load_factor(); }
+    inline const map_type& map() const { return _map; }
+
+    /// arena bytes in use, erased keys included, and the erased part of them
+    inline uint64_t arena_size() const { return _size; }
+    inline uint64_t garbage_size() const { return _garbage; }
+
+    inline std::string_view key(const ArenaKey& key) const { return {_arena + key.offset, key.size}; }
+
+    inline iterator find(std::string_view key) noexcept { return _map.find(probe(key)); }
+    inline const_iterator find(std::string_view key) const noexcept { return _map.find(probe(key)); }
+    inline bool contains(std::string_view key) const noexcept { return _map.contains(probe(key)); }
+    inline size_type count(std::string_view key) const noexcept { return _map.count(probe(key)); }
+
+    ValueT* try_get(std::string_view key) noexcept
+    {
+        auto it = find(key);
+        return it != end() ? &it->second : nullptr;
+    }
+
+    ValueT& at(std::string_view key) { return find(key)->second; }
+    const ValueT& at(std::string_view key) const { return find(key)->second; }
+
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(std::string_view key, Args&&... args)
+    {
+        const auto kp = probe(key);
+        auto it = _map.find(kp);
+        if (it != _map.end())
+            return {it, false};
+
+        _map.insert_unique(append(key, kp.hash), ValueT(std::forward<Args>(args)...));
+        return {_map.last(), true};
+    }
+
+    template<typename... Args>
+    inline std::pair<iterator, bool> try_emplace(std::string_view key, Args&&... args)
+    {
+        return emplace(key, std::forward<Args>(args)...);
+    }
+
+    inline std::pair<iterator, bool> insert(const std::pair<std::string_view, ValueT>& kv) { return emplace(kv.first, kv.second); }
+
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(std::string_view key, V&& val)
+    {
+        auto ret = emplace(key, std::forward<V>(val));
+        if (!ret.second)
+            ret.first->second = std::forward<V>(val);
+        return ret;
+    }
+
+    inline ValueT& operator[](std::string_view key) { return emplace(key).first->second; }
+
+    size_type erase(std::string_view key) noexcept
+    {
+        auto it = find(key);
+        if (it == end())
+            return 0;
+        erase(it);
+        return 1;
+    }
+
+    iterator erase(const const_iterator& cit) noexcept
+    {
+        _garbage += cit->first.size;
+        return _map.erase(cit);
+    }
+
+    /// keep the arena capacity, pairs are trivially destructible for trivial ValueT
+    void clear() noexcept
+    {
+        _map.clear();
+        _size = _garbage = 0;
+    }
+
+    void reserve(size_type num_keys, uint64_t arena_bytes = 0)
+    {
+        _map.reserve(num_keys);
+        if (arena_bytes > _capacity)
+            grow(arena_bytes);
+    }
+
+    void shrink_to_fit()
+    {
+        compact();
+        _map.shrink_to_fit();
+        if (_size < _capacity) {
+            _capacity = _size;
+            auto arena = (char*)realloc(_arena, _capacity + !_capacity);
+            if (arena)
+                _arena = arena;
+        }
+    }
+
+    /// copy the live keys to a new arena in slot order, dropping erased characters.
+    /// throws std::bad_alloc and keeps the old arena when the new one can not be allocated
+    void compact()
+    {
+        if (_garbage == 0)
+            return;
+
+        auto arena = (char*)malloc(_capacity);
+        if (!arena)
+            throw std::bad_alloc();
+        uint64_t size = 0;
+        for (auto& kv : _map) {
+            memcpy(arena + size, _arena + kv.first.offset, kv.first.size);
+            kv.first.offset = size;
+            size += kv.first.size;
+        }
+        free(_arena);
+        _arena = arena;
+        _size = size;
+        _garbage = 0;
+    }
+
+private:
+    inline Probe probe(std::string_view key) const
+    {
+        const auto hash = (uint64_t)_hasher(key);
+        return {key, _arena, (uint32_t)(hash ^ (hash >> 32))};
+    }
+
+    ArenaKey append(std::string_view key, uint32_t hash)
+    {
+        std::string copy;
+        if (_size + key.size() > _capacity) {
+            //a key viewing this arena (key(it) of another entry) would dangle after compact()/grow()
+            if (key.data() >= _arena && key.data() < _arena + _capacity)
+                key = copy.assign(key.data(), key.size());
+            if (_garbage * 2 > _size)
+                compact();
+            if (_size + key.size() > _capacity)
+                grow(std::max<uint64_t>(_capacity * 2, _size + key.size() + 64));
+        }
+
+        const ArenaKey akey = {_size, (uint32_t)key.size(), hash};
+        memcpy(_arena + _size, key.data(), key.size());
+        _size += key.size();
+        return akey;
+    }
+
+    void grow(uint64_t capacity)
+    {
+        if (capacity <= _capacity)
+            return;
+        auto arena = (char*)realloc(_arena, capacity);
+        if (!arena)
+            throw std::bad_alloc();
+        _arena = arena;
+        _capacity = capacity;
+    }
+
+    map_type _map;
+    HashT    _hasher;
+    char*    _arena    = nullptr;
+    uint64_t _size     = 0;
+    uint64_t _capacity = 0;
+    uint64_t _garbage  = 0;
+};
+#endif
 } // namespace emhash
 
@@ -13,6 +13,20 @@
 #include "../hash_table6.hpp"
 #include "../hash_table7.hpp"
 #include "../hash_table8.hpp"
+#include "../hash_set2.hpp"
+#include "../hash_set3.hpp"
+#include "../hash_set4.hpp"
+#include "../hash_set8.hpp"
+#include "../hash_cpu.hpp"
+#include "../hash_quotient.hpp"
+#include "../hash_swmr7.hpp"
+#include "../hash_publish8.hpp"
+#include "../hash_groupby8.hpp"
+#include "../hash_join8.hpp"
+#include "../hash_front.hpp"
+#include "../hash_numa8.hpp"
+#include "../hash_background8.hpp"
+#include "../hash_concurrent5.hpp"
 #include "emilib/emilib2.hpp"
 
 
@@ -20,6 +34,9 @@
 #include "martinus/unordered_dense.h"
 #include "phmap/phmap.h"
 
+#include <atomic>
+#include <thread>
+
 #if CXX20
 #include <string_view>
 struct string_hash
@@ -134,6 +151,55 @@ inline Os& operator<<(Os& os, Container const& cont)
 #define ehmap8 emhash8::HashMap
 
 //TODO template
+struct CountObserver
+{
+    constexpr static bool enabled = true;
+    static int events[8];
+    static void on_event(const emhash8::TableEvent& ev)
+    {
+        assert(ev.type != emhash8::EVENT_REHASH_END || ev.new_buckets >= ev.size);
+        events[ev.type] ++;
+    }
+};
+int CountObserver::events[8];
+
+struct CountPolicy : emhash8::DefaultPolicy
+{
+    using observer = CountObserver;
+};
+
+struct HighLoadPolicy : emhash8::DefaultPolicy
+{
+    constexpr static uint32_t high_load = 1000;
+    constexpr static int      int_hash  = 2;
+};
+
+struct FingerprintPolicy : emhash8::DefaultPolicy
+{
+    constexpr static bool str_fingerprint = true;
+};
+
+//four consecutive keys share a main bucket, so inserts kick entries out of their buckets
+struct QuadHash
+{
+    size_t operator()(int key) const { return (size_t)key >> 2; }
+};
+
+//three threads pull task indexes from one counter, the executor of the parallel_* tests
+struct ThreadExecutor
+{
+    template<typename F>
+    void operator()(size_t tasks, const F& task) const
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 3; t++)
+            threads.emplace_back([&] { for (size_t i; (i = next++) < tasks; ) task(i); });
+        for (auto& t : threads)
+            t.join();
+    }
+};
+
 static void TestApi()
 {
     printf("============================== %s ============================\n", __FUNCTION__);
@@ -593,6 +659,758 @@ static void TestApi()
 #endif
     }
 
+    {
+        auto check_stats = [](const auto& map, uint32_t step) {
+            const auto st = map.stats(step);
+            assert(st.size == map.size() && st.buckets == map.bucket_count());
+            assert(st.sampled == (map.bucket_count() + step - 1) / step);
+            assert(st.main_ratio > 0 && st.main_ratio <= 1);
+            assert(st.avg_hit_probe >= 1 && st.max_hit_probe >= 1);
+            uint64_t chains = 0;
+            for (auto c : st.chain_len) chains += c;
+            assert(chains > 0 || step > 1);
+            if (step == 1) {
+                uint64_t elems = 0;
+                for (uint32_t i = 0; i < st.CHAIN_SLOTS - 1; i++) elems += st.chain_len[i] * i;
+                assert(st.max_hit_probe >= st.CHAIN_SLOTS - 1 || elems == map.size());
+                //chain heads cost their chain, every other bucket one probe
+                const double misses = (double)st.buckets - chains + map.size();
+                assert(std::abs(st.avg_miss_probe * st.sampled - misses) < 1e-3 * misses);
+            }
+            assert(st.avg_miss_probe >= 1 && st.max_miss_probe >= 1);
+        };
+
+        ehmap5<uint64_t, int> m5; ehmap6<uint64_t, int> m6; ehmap7<uint64_t, int> m7; ehmap8<uint64_t, int> m8;
+        for (int i = 0; i < 10000; i++) {
+            const auto key = (uint64_t)rand() * rand();
+            m5[key] = m6[key] = m7[key] = m8[key] = i;
+        }
+        for (uint32_t step : {1, 7}) {
+            check_stats(m5, step); check_stats(m6, step);
+            check_stats(m7, step); check_stats(m8, step);
+        }
+        const auto st = m8.stats();
+        printf("emhash8 stats: load %.2f main %.2f hit %.2f miss %.2f link %.2f\n",
+                st.load_factor, st.main_ratio, st.avg_hit_probe, st.avg_miss_probe, st.avg_link_dist);
+    }
+
+    {
+        emhash8::HashMap<int, int, std::hash<int>, std::equal_to<int>, CountPolicy> map;
+        for (int i = 0; i < 10000; i++)
+            map[i] = i;
+        for (int i = 0; i < 9900; i++)
+            map.erase(i);
+        map.shrink_to_fit();
+        map.clear();
+        assert(CountObserver::events[emhash8::EVENT_REHASH_BEGIN] == CountObserver::events[emhash8::EVENT_REHASH_END]);
+        assert(CountObserver::events[emhash8::EVENT_REHASH_END] > 1);
+        assert(CountObserver::events[emhash8::EVENT_SHRINK] == 1 && CountObserver::events[emhash8::EVENT_CLEAR] == 1);
+    }
+
+    {
+        //a high load map next to a default one in the same binary
+        emhash8::HashMap<uint64_t, int, std::hash<uint64_t>, std::equal_to<uint64_t>, HighLoadPolicy> dense;
+        ehmap8<uint64_t, int> hot;
+        dense.max_load_factor(0.95f);
+        for (int i = 0; i < 110000; i++)
+            dense[i * 7] = hot[i * 7] = i;
+        assert(dense.load_factor() > hot.load_factor());
+        for (int i = 0; i < 60000; i++)
+            assert(dense.erase(i * 7) == 1 && hot.erase(i * 7) == 1);
+        for (int i = 60000; i < 110000; i++)
+            assert(dense.at(i * 7) == i && hot.at(i * 7) == i);
+    }
+
+    {
+        //every dispatched scan kernel the cpu can run agrees with the scalar one
+        std::vector<size_t> words(64, ~(size_t)0);
+        for (int level = emcpu::SCALAR; level <= emcpu::level(); level++) {
+            const auto scan = emcpu::select_scan_ne(level);
+            for (size_t n = 0; n < words.size(); n++) {
+                assert(scan(words.data(), n, ~(size_t)0) == n);
+                for (size_t pos = 0; pos < n; pos++) {
+                    words[pos] = (size_t)1 << (pos % 64);
+                    assert(scan(words.data(), n, ~(size_t)0) == emcpu::scan_ne_scalar(words.data(), n, ~(size_t)0));
+                    assert(scan(words.data(), n, ~(size_t)0) == pos);
+                    words[pos] = ~(size_t)0;
+                }
+            }
+        }
+        printf("cpu dispatch level = %s\n", emcpu::level_name(emcpu::level()));
+
+        //batch integer hashing is bit identical to the scalar hash64 mixers
+        std::vector<int64_t> keys(1001);
+        std::vector<uint64_t> hashes(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            keys[i] = (int64_t)(i * 0x9E3779B97F4A7C15ull) >> (i % 40);
+        emhash8::HashMap<int64_t, int, std::hash<int64_t>, std::equal_to<int64_t>, HighLoadPolicy> m8;
+        m8.hash_keys(keys.data(), hashes.data(), keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            assert(hashes[i] == emcpu::hash64<HighLoadPolicy::int_hash>((uint64_t)keys[i]));
+        emcpu::hash_keys<1>(keys.data(), hashes.data(), keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            assert(hashes[i] == emcpu::hash64<1>((uint64_t)keys[i]));
+    }
+
+    {
+        //hardware hasher on every length around the aes thresholds and wide keys
+        emhash8::HashMap<std::string, int, emcpu::HwHash> smap;
+        emhash8::HashMap<uint64_t, int, emcpu::HwHash> imap;
+        std::string key;
+        for (int i = 0; i < 600; i++) {
+            key += char('a' + i % 26);
+            smap[key] = i; imap[(uint64_t)i << 32] = i;
+        }
+        key.clear();
+        for (int i = 0; i < 600; i++) {
+            key += char('a' + i % 26);
+            assert(smap.at(key) == i && imap.at((uint64_t)i << 32) == i);
+        }
+        assert(emcpu::hash_bytes(key.data(), 40) != emcpu::hash_bytes(key.data() + 1, 40));
+#if __SIZEOF_INT128__
+        emhash8::HashMap<__uint128_t, int, emcpu::HwHash> wmap;
+        for (int i = 0; i < 1000; i++)
+            wmap[(__uint128_t)i << 64 | (uint64_t)i] = i;
+        for (int i = 0; i < 1000; i++)
+            assert(wmap.at((__uint128_t)i << 64 | (uint64_t)i) == i);
+#endif
+    }
+
+    {
+        //composite keys with the default emhash8::Hash, no user hasher
+        emhash8::HashMap<std::pair<uint32_t, uint32_t>, int> pmap;
+        emhash8::HashMap<std::tuple<int, std::string>, int> tmap;
+        emhash8::HashMap<const int*, int> amap;
+        std::vector<int> objs(1000);
+        for (int i = 0; i < 1000; i++) {
+            pmap[{(uint32_t)i, (uint32_t)i * 7}] = i;
+            tmap[std::make_tuple(i, std::to_string(i))] = i;
+            amap[&objs[i]] = i;
+        }
+        for (int i = 0; i < 1000; i++) {
+            assert(pmap.at({(uint32_t)i, (uint32_t)i * 7}) == i && pmap.count({(uint32_t)i * 7, (uint32_t)i}) == (i == 0));
+            assert(tmap.at(std::make_tuple(i, std::to_string(i))) == i);
+            assert(amap.at(&objs[i]) == i);
+        }
+        assert(amap.stats().main_ratio > 0.5);
+    }
+
+    {
+        //string fingerprint: low hash bits all collide, only the fingerprint tells keys apart
+        struct HighBitsHash { size_t operator()(const std::string& s) const { return std::hash<std::string>()(s) & ~(size_t)0xFFFFFFFF; } };
+        emhash8::HashMap<std::string, int, HighBitsHash, std::equal_to<std::string>, FingerprintPolicy> fmap;
+        std::unordered_map<std::string, int> umap;
+        for (int i = 0; i < 5000; i++) {
+            const auto key = std::to_string(i * 131 % 2000);
+            if (i % 3 == 2) {
+                assert(fmap.erase(key) == umap.erase(key));
+            } else {
+                fmap[key] = i; umap[key] = i;
+            }
+        }
+        assert(fmap.size() == umap.size());
+        for (const auto& kv : umap)
+            assert(fmap.at(kv.first) == kv.second);
+    }
+
+    {
+        //fixed size keys: every byte position matters to compare and hash, all tables agree
+        using Uuid = std::array<uint8_t, 16>;
+        using Sha1 = std::array<char, 20>;
+        emhash5::HashMap<Uuid, int, emcpu::FixedHash, emcpu::FixedEqual> map5;
+        emhash6::HashMap<Uuid, int, emcpu::FixedHash, emcpu::FixedEqual> map6;
+        emhash7::HashMap<Sha1, int, emcpu::FixedHash, emcpu::FixedEqual> map7;
+        emhash8::HashMap<Sha1, int> map8;
+        for (int i = 0; i < 2000; i++) {
+            Uuid uuid = {}; Sha1 sha1 = {};
+            uuid[i % 16] = sha1[i % 20] = (char)(i / 20 + 1);
+            map5[uuid] = map6[uuid] = map7[sha1] = map8[sha1] = i;
+        }
+        assert(map5.size() == map6.size() && map7.size() == 2000 && map8.size() == 2000);
+        for (int i = 0; i < 2000; i++) {
+            Sha1 sha1 = {};
+            sha1[i % 20] = (char)(i / 20 + 1);
+            assert(map7.at(sha1) == i && map8.at(sha1) == i);
+            sha1[(i + 1) % 20] ^= 0x40;
+            assert(!map7.contains(sha1) && !map8.contains(sha1));
+        }
+        std::array<uint8_t, 32> a = {}, b = {};
+        for (int i = 0; i < 32; i++) {
+            b[i] = 1;
+            assert(!emcpu::fixed_equal<32>(&a, &b) && emcpu::fixed_hash<32>(&a) != emcpu::fixed_hash<32>(&b));
+            b[i] = 0;
+        }
+        assert(emcpu::fixed_equal<32>(&a, &b));
+        //the default emhash8 hash of byte keys is the same with and without EMH_CPU_DISPATCH
+        const Sha1 sha1 = {'e', 'm', 'h'};
+        assert(emhash8::Hash<Sha1>()(sha1) == (size_t)emcpu::fixed_hash<20>(&sha1));
+        assert(emhash8::Hash<decltype(a)>()(a) == (size_t)emcpu::fixed_hash<32>(&a));
+    }
+
+    {
+        //flooded chains switch only this emhash6 map to its seeded hash, content survives the rehash
+        struct FloodHash { size_t operator()(int) const { return 42; } size_t operator()(const std::string& s) const { return s.size(); } };
+        emhash6::HashMap<int, int, FloodHash> imap;
+        emhash6::HashMap<std::string, int, FloodHash> smap;
+        emhash6::HashMap<int, int> fair;
+        for (int i = 0; i < 20000; i++) {
+            imap[i] = smap[std::to_string(i)] = fair[i * 7] = i;
+        }
+        assert(smap.flood_rehash() == 1 && fair.flood_rehash() == 0);
+#if EMH_INT_HASH == 0
+        assert(imap.flood_rehash() == 1); //EMH_INT_HASH never calls FloodHash for int keys
+#endif
+        for (int i = 0; i < 20000; i += 2) {
+            assert(imap.erase(i) == 1 && smap.at(std::to_string(i)) == i);
+        }
+        auto copy = imap;
+        for (int i = 1; i < 20000; i += 2)
+            assert(copy.at(i) == i && !copy.contains(i - 1));
+    }
+
+    {
+        //swmr map: growth and clear publish new tables, a pinned reader holds back their reclamation
+        emhash7::SwmrMap<int, int> smap(8, 4);
+        auto reader = smap.reader();
+        assert(reader.valid());
+        for (int i = 0; i < 1000; i++)
+            assert(smap.insert(i, i * 2) && !smap.insert(i, 0));
+        assert(smap.size() == 1000 && smap.publish_count() > 0);
+        for (int i = 0; i < 999; i += 3)
+            assert(smap.erase(i) == 1 && !smap.insert_or_assign(i + 1, i));
+        int val = 0;
+        for (int i = 0; i < 999; i++)
+            assert(reader.find(i, val) == (i % 3 != 0) && (i % 3 == 0 || val == (i % 3 == 1 ? i - 1 : i * 2)));
+        {
+            auto guard = reader.pin();
+            smap.clear();
+            assert(!reader.find(1, val) && smap.pending_reclaim() > 0);
+        }
+        assert(smap.collect() == 0 && smap.size() == 0);
+    }
+
+    {
+        //swmr map: readers loop find() while the writer kicks entries out and grows the table
+        emhash7::SwmrMap<int, int, QuadHash> smap(8, 4);
+        const auto value = [](int key) { return key * 7 + 1; };
+        for (int i = 0; i < 4000; i += 4)
+            smap.insert(i, value(i));
+        const auto published = smap.publish_count();
+        std::atomic<bool> stop{false};
+        std::atomic<int> started{0};
+        std::atomic<size_t> hits{0};
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 3; t++) {
+            readers.emplace_back([&, t] {
+                auto reader = smap.reader();
+                assert(reader.valid());
+                started++;
+                size_t found_keys = 0;
+                for (int k = t; !stop.load(std::memory_order_relaxed); k = (k + 13) % 20000) {
+                    int val = 0;
+                    const bool found = reader.find(k, val);
+                    assert(found || k % 4 != 0 || k >= 4000);
+                    assert(!found || val == value(k));
+                    found_keys += found;
+                }
+                hits += found_keys;
+            });
+        }
+        while (started < 3)
+            std::this_thread::yield();
+
+        //keys 4n stay, the others come and go around them, new keys up to 20000 grow the table
+        for (int round = 0; round < 20; round++) {
+            for (int i = 1; i < 4000; i++) {
+                if (i % 4 != 0)
+                    smap.insert_or_assign(i, value(i));
+            }
+            for (int i = 4000 + round * 800; i < 4800 + round * 800; i++)
+                smap.insert(i, value(i));
+            if (round == 10)
+                smap.reserve(1 << 16);
+            for (int i = 1 + round % 3; i < 4000; i += 3) {
+                if (i % 4 != 0)
+                    smap.erase(i);
+            }
+            std::this_thread::yield();
+        }
+        stop = true;
+        for (auto& t : readers)
+            t.join();
+        assert(smap.publish_count() > published + 1 && hits > 0);
+        int stable = 0;
+        smap.for_each([&](int key, int val) { assert(val == value(key)); stable += key % 4 == 0; });
+        assert(stable == 5000);
+        smap.collect();
+        assert(smap.pending_reclaim() == 0);
+    }
+
+    {
+        //published map: a batch publish reuses the version it replaced once no snapshot pins it
+        emhash8::Published<emhash8::HashMap<int, int>> pub;
+        auto reader = pub.reader();
+        for (int v = 1; v <= 4; v++) {
+            emhash8::Published<emhash8::HashMap<int, int>>::Batch batch;
+            for (int i = 0; i < 100; i++)
+                batch.insert_or_assign(i, i * v);
+            batch.erase(v);
+            const auto reused = pub.publish(std::move(batch));
+            assert(reused == (v > 1));
+            auto snap = reader.snapshot();
+            assert(snap->size() == 99 && !snap->contains(v) && snap->at(v + 1) == (v + 1) * v);
+        }
+        assert(pub.version() == 4 && pub.copies() == 1);
+        {
+            //the old snapshot pins the spare of the second publish, which copies instead
+            auto old = reader.snapshot();
+            emhash8::Published<emhash8::HashMap<int, int>>::Batch batch1, batch2;
+            batch1.erase(10);
+            batch2.erase(11);
+            assert(pub.publish(std::move(batch1), 0) && !pub.publish(std::move(batch2), 0));
+            assert(old->contains(10) && old->contains(11) && pub.current().size() == 97 && pub.copies() == 2);
+        }
+        pub.publish(emhash8::HashMap<int, int>{{1, 1}});
+        assert(reader.snapshot()->size() == 1 && pub.current().at(1) == 1);
+    }
+
+    //published map: readers hold snapshots while the writer publishes, with and without waiting for them
+    for (const uint32_t wait_spins : {0u, 1000u}) {
+        using PubMap = emhash8::Published<emhash8::HashMap<int, int>>;
+        //version v maps key i to i * v, key -1 to v and holds the one extra key 1000 + v
+        const int keys = 200;
+        emhash8::HashMap<int, int> initial;
+        for (int i = 0; i < keys; i++)
+            initial.emplace(i, i);
+        initial.emplace(-1, 1);
+        initial.emplace(1001, 0);
+        PubMap pub(std::move(initial));
+
+        std::atomic<bool> stop{false};
+        std::atomic<int> started{0};
+        std::atomic<size_t> checked{0};
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 3; t++) {
+            readers.emplace_back([&] {
+                auto reader = pub.reader();
+                assert(reader.valid());
+                started++;
+                int last = 0;
+                size_t snaps = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    auto snap = reader.snapshot();
+                    const int v = snap->at(-1);
+                    assert(v >= last && snap->size() == keys + 2);
+                    assert(snap->contains(1000 + v) && !snap->contains(1000 + v - 1));
+                    for (int i = 0; i < keys; i++)
+                        assert(snap->at(i) == i * v);
+                    last = v;
+                    snaps++;
+                }
+                checked += snaps;
+            });
+        }
+        while (started < 3)
+            std::this_thread::yield();
+
+        size_t reused = 0;
+        for (int v = 2; v <= 300; v++) {
+            PubMap::Batch batch;
+            for (int i = 0; i < keys; i++)
+                batch.insert_or_assign(i, i * v);
+            batch.insert_or_assign(-1, v);
+            batch.erase(1000 + v - 1);
+            batch.insert_or_assign(1000 + v, 0);
+            reused += pub.publish(std::move(batch), wait_spins);
+            std::this_thread::yield();
+        }
+        stop = true;
+        for (auto& t : readers)
+            t.join();
+        assert(checked > 0 && pub.version() == 299 && reused + pub.copies() == 299);
+        assert(pub.current().at(-1) == 300 && pub.current().at(keys - 1) == (keys - 1) * 300);
+    }
+
+    {
+        //concurrent grow only map: threads race on the same keys while the table grows
+        emhash5::ConcurrentMap<int, int> cmap;
+        emhash5::ConcurrentSet<uint64_t> cset(4);
+        std::atomic<int> fresh{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 20000; i++) {
+                    const auto key = (i * 7 + t * (i & 1)) % 15000;
+                    fresh += cmap.insert(key, key * 3);
+                    cset.insert((uint64_t)key << 32);
+                    int val = 0;
+                    assert(cmap.find(key, val) && val == key * 3);
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+        assert(cmap.size() == 15000 && fresh == 15000 && cset.size() == 15000 && cmap.resize_count() > 0);
+        int sum = 0;
+        cmap.for_each([&](int key, int val) { assert(val == key * 3); sum++; });
+        assert(sum == 15000 && !cmap.insert(7, 0) && !cmap.contains(15000) && cset.contains((uint64_t)14999 << 32));
+    }
+
+    {
+        //parallel rehash builds the layout of rehash(), with one thread and with several
+        emhash8::HashMap<int, int> base;
+        for (int i = 0; i < 200000; i++)
+            base.emplace(i * 13, i);
+        auto plain = base, serial = base, threaded = base;
+        plain.rehash(300000);
+        serial.parallel_rehash(300000, emhash8::SerialExecutor());
+        threaded.parallel_rehash(300000, ThreadExecutor());
+        assert(plain.bucket_count() == base.bucket_count() * 2 && threaded.bucket_count() == plain.bucket_count());
+        auto it = threaded.begin();
+        for (const auto& kv : plain) {
+            assert(it != threaded.end() && it->first == kv.first && it->second == kv.second);
+            ++it;
+        }
+        for (int i = 0; i < 200000; i++) {
+            const auto bucket = plain.index_bucket(i * 13);
+            assert(bucket == threaded.index_bucket(i * 13) && bucket == serial.index_bucket(i * 13));
+            assert(threaded.at(i * 13) == i && !threaded.contains(i * 13 + 1));
+        }
+        const auto s0 = plain.stats(), s1 = serial.stats(), s2 = threaded.stats();
+        assert(memcmp(&s0, &s1, sizeof(s0)) == 0 && memcmp(&s0, &s2, sizeof(s0)) == 0);
+    }
+
+    {
+        //parallel scans and erase_if agree with the serial ones, a few and many victims
+        ThreadExecutor pool;
+        emhash5::HashMap<int, int> map5;
+        emhash6::HashMap<int, int> map6;
+        emhash7::HashMap<int, int> map7;
+        emhash8::HashMap<int, int> map8;
+        emhash2::HashSet<int> set2;
+        emhash7::HashSet<int> set3;
+        emhash9::HashSet<int> set4;
+        emhash8::HashSet<int> set8;
+        for (int i = 0; i < 300000; i++) {
+            map5[i * 7] = map6[i * 7] = map7[i * 7] = map8[i * 7] = i;
+            set2.insert(i * 7); set3.insert(i * 7); set4.insert(i * 7); set8.insert(i * 7);
+        }
+
+        auto sum = [](const auto& kv) { return (int64_t)kv.second; };
+        auto key = [](int k) { return (int64_t)k; };
+        auto add = [](int64_t a, int64_t b) { return a + b; };
+        const int64_t total = 300000ll * 299999 / 2;
+        const int64_t sums[] = {map5.parallel_reduce(pool, (int64_t)0, sum, add), map6.parallel_reduce(pool, (int64_t)0, sum, add),
+            map7.parallel_reduce(pool, (int64_t)0, sum, add), map8.parallel_reduce(pool, (int64_t)0, sum, add),
+            set2.parallel_reduce(pool, (int64_t)0, key, add) / 7, set3.parallel_reduce(pool, (int64_t)0, key, add) / 7,
+            set4.parallel_reduce(pool, (int64_t)0, key, add) / 7, set8.parallel_reduce(pool, (int64_t)0, key, add) / 7};
+        for (auto s : sums)
+            assert(s == total);
+        map6.parallel_for_each(pool, [](auto& kv) { kv.second ++; });
+        map8.parallel_for_each(pool, [](std::pair<int, int>& kv) { kv.second ++; });
+        assert(map6.parallel_reduce(emhash8::SerialExecutor(), (int64_t)0, sum, add) == total + 300000);
+        assert(map8.parallel_reduce(emhash8::SerialExecutor(), (int64_t)0, sum, add) == total + 300000);
+        std::atomic<int64_t> seen{0};
+        set2.parallel_for_each(pool, [&](int k) { seen += k; });
+        set3.parallel_for_each(pool, [&](int k) { seen += k; });
+        set4.parallel_for_each(pool, [&](int k) { seen += k; });
+        set8.parallel_for_each(pool, [&](int k) { seen += k; });
+        assert(seen == total * 7 * 4);
+
+        for (int mod : {100, 3}) {
+            auto pred = [mod](const auto& kv) { return kv.first / 7 % mod == 0; };
+            auto kpred = [mod](int k) { return k / 7 % mod == 0; };
+            size_t victims = 0;
+            for (const auto& kv : map8)
+                victims += pred(kv);
+            const size_t erased[] = {map5.parallel_erase_if(pool, pred), map6.parallel_erase_if(pool, pred),
+                map7.parallel_erase_if(pool, pred), map8.parallel_erase_if(pool, pred),
+                set2.parallel_erase_if(pool, kpred), set3.parallel_erase_if(pool, kpred),
+                set4.parallel_erase_if(pool, kpred), set8.parallel_erase_if(pool, kpred)};
+            for (auto e : erased)
+                assert(e == victims);
+            const size_t sizes[] = {map5.size(), map6.size(), map7.size(), set2.size(), set3.size(), set4.size(), set8.size()};
+            for (auto n : sizes)
+                assert(n == map8.size());
+            for (const auto& kv : map5) {
+                assert(kv.first / 7 % mod != 0 && map7.at(kv.first) == kv.second);
+                assert(map6.at(kv.first) == kv.second + 1 && map8.at(kv.first) == kv.second + 1);
+                assert(set2.contains(kv.first) && set3.contains(kv.first) && set4.contains(kv.first) && set8.contains(kv.first));
+            }
+        }
+    }
+
+    {
+        //group by over partitions matches one unordered_map, merge_into combines partials
+        ThreadExecutor pool;
+        std::vector<int> keys(200000), vals(200000);
+        std::unordered_map<int, int64_t> sums;
+        std::mt19937 rng(46);
+        for (int i = 0; i < 200000; i++) {
+            keys[i] = (int)(rng() % 30000);
+            vals[i] = (int)(rng() % 1000) - 500;
+            sums[keys[i]] += vals[i];
+        }
+
+        emhash8::GroupBy<int, emhash8::agg::Sum<int64_t>> sum;
+        emhash8::GroupBy<int, emhash8::agg::Count> count(emhash8::agg::Count(), 3);
+        const auto groups = sum.aggregate(keys.data(), vals.data(), keys.size(), pool).groups;
+        count.aggregate(keys.data(), vals.data(), keys.size(), emhash8::SerialExecutor());
+        assert(groups == sums.size() && count.partition_count() == 8 && count.size() == sums.size());
+        int64_t val; uint64_t rows = 0, n;
+        for (const auto& kv : sums) {
+            assert(sum.find(kv.first, val) && val == kv.second);
+            assert(count.find(kv.first, n));
+            rows += n;
+        }
+        assert(rows == keys.size() && !sum.find(-1, val));
+
+        emhash8::HashMap<int, int64_t> out;
+        sum.merge_into(out);
+        assert(sum.size() == 0 && out.size() == sums.size());
+        sum.aggregate(keys.data(), vals.data(), keys.size(), pool);
+        sum.merge_into(out);
+        for (const auto& kv : sums)
+            assert(out.at(kv.first) == kv.second * 2);
+    }
+
+    {
+        //partitioned join with duplicate build keys against an unordered_multimap
+        ThreadExecutor pool;
+        std::vector<int> build(60000), probe(150000);
+        std::unordered_multimap<int, size_t> ref;
+        std::mt19937 rng(47);
+        for (size_t i = 0; i < build.size(); i++)
+            ref.emplace(build[i] = (int)(rng() % 30000), i);
+        for (auto& key : probe)
+            key = (int)(rng() % 60000);
+
+        std::vector<std::pair<size_t, size_t>> pairs, want;
+        size_t semi = 0;
+        for (size_t i = 0; i < probe.size(); i++) {
+            const auto range = ref.equal_range(probe[i]);
+            semi += range.first != range.second;
+            for (auto it = range.first; it != range.second; ++it)
+                want.emplace_back(it->second, i);
+        }
+        std::sort(want.begin(), want.end());
+
+        emhash8::HashJoin<int> join, join3(3);
+        const auto unbuilt = join.anti(probe.data(), 100, pool, [](size_t) {});
+        const auto keys = join.build(build.data(), build.size(), pool).keys;
+        join3.build(build.data(), build.size(), emhash8::SerialExecutor());
+        assert(unbuilt == 100 && keys == join3.stats().keys);
+        join3.inner(probe.data(), probe.size(), emhash8::SerialExecutor(), [&](size_t b, size_t p) { pairs.emplace_back(b, p); });
+        std::sort(pairs.begin(), pairs.end());
+        assert(join3.partition_count() == 8 && pairs == want);
+
+        std::atomic<size_t> found{0}, missing{0};
+        const auto inner = join.inner(probe.data(), probe.size(), pool, [](size_t, size_t) {});
+        const auto semis = join.semi(probe.data(), probe.size(), pool, [&](size_t p) { found += ref.count(probe[p]) > 0; });
+        const auto antis = join.anti(probe.data(), probe.size(), pool, [&](size_t p) { missing += ref.count(probe[p]) == 0; });
+        assert(inner == want.size() && semis == semi && found == semi);
+        assert(antis == probe.size() - semi && missing == antis);
+    }
+
+    {
+        //front cache answers repeats locally and drops an entry once its stripe was bumped
+        emhash8::HashMap<int, int> map;
+        emfront::Generation gen(4);
+        emfront::FrontCache<int, int, 16> cache(gen);
+        int loads = 0, val = 0;
+        auto load = [&](int key, int& v) { loads ++; return map.try_get(key, v); };
+        for (int i = 0; i < 1000; i++)
+            map[i] = i;
+
+        for (int r = 0; r < 3; r++)
+            for (int i = 0; i < 8; i++)
+                assert(cache.find(i, val, load) && val == i);
+        assert(cache.hits() + cache.misses() == 24 && cache.hits() >= 8 && loads == (int)cache.misses());
+        assert(!cache.find(-1, val, load));
+
+        map[3] = 33;
+        gen.bump(std::hash<int>()(3));
+        assert(cache.find(3, val, load) && val == 33);
+        const auto misses = cache.misses();
+        for (int i = 0; i < 1000; i++)
+            assert(cache.find(i % 200, val, load) && val == (i % 200 == 3 ? 33 : i % 200));
+        assert(cache.misses() > misses && cache.hit_rate() > 0 && cache.hit_rate() < 1);
+
+        map.clear();
+        gen.bump_all();
+        assert(!cache.find(3, val, load) && !cache.find(5, val, load));
+    }
+
+    {
+        //numa shards: both modes hold the same keys, blocks go through the policy allocator
+        using Numa = emhash8::NumaMap<int, int>;
+        const auto before = emnuma::allocated(0);
+        {
+            Numa parts(Numa::PARTITIONED, 3, true), copies(Numa::REPLICATED);
+            assert(parts.shard_count() == 3u * emnuma::nodes() && copies.shard_count() == (size_t)emnuma::nodes());
+            for (int i = 0; i < 100000; i++) {
+                const auto fresh = parts.insert(i, i);
+                assert(fresh && copies.insert_or_assign(i, i));
+            }
+            for (int i = 0; i < 100000; i += 3) {
+                const auto erased = parts.erase(i);
+                assert(erased == 1 && copies.erase(i) == 1);
+            }
+            assert(parts.size() == copies.size() && parts.size() == 66666);
+
+            int val = 0;
+            for (int i = 0; i < 1000; i++)
+                assert(parts.contains(i) == (i % 3 != 0) && copies.try_get(i, val) == (i % 3 != 0));
+            size_t entries = 0, lookups = 0;
+            for (const auto& st : parts.stats())
+                entries += st.entries, lookups += st.local_lookups + st.remote_lookups;
+            assert(entries == parts.size() && lookups == 1000 && emnuma::allocated(0) > before);
+        }
+        assert(emnuma::allocated(0) == before);
+    }
+
+    {
+        //background growth: writes during migrations land in the delta and survive the swaps
+        emhash8::BackgroundMap<int, int> bmap(16, 0.5f);
+        std::unordered_map<int, int> umap;
+        for (int i = 0; i < 200000; i++) {
+            const auto key = (i * 7919) % 150000;
+            if (i % 5 == 0) {
+                const auto erased = bmap.erase(key);
+                assert(erased == umap.erase(key));
+            } else if (i % 5 == 1) {
+                bmap[key] += i;
+                umap[key] += i;
+            } else {
+                const auto fresh = bmap.insert_or_assign(key, i);
+                assert(fresh == umap.insert_or_assign(key, i).second);
+            }
+            assert(bmap.size() == umap.size());
+        }
+
+        size_t n = 0;
+        bmap.for_each([&](int key, int val) { n++; assert(umap.at(key) == val); });
+        assert(n == umap.size());
+        bmap.wait();
+        assert(!bmap.migrating() && bmap.stats().migrations > 0);
+        for (const auto& kv : umap) {
+            int val = 0;
+            assert(bmap.try_get(kv.first, val) && val == kv.second);
+        }
+    }
+
+    {
+        //quotient tables give back the exact keys they were fed, through grow and erase churn
+        emhash8::QuotientMap<uint64_t, int> qmap;
+        emhash8::QuotientSet<int> qset;
+        std::unordered_map<uint64_t, int> umap;
+        std::unordered_set<int> uset;
+        std::mt19937_64 rng(39);
+        for (int i = 0; i < 100000; i++) {
+            const auto key = rng() >> (i % 40);
+            const auto skey = (int)(key >> 32 ^ key); //narrow on purpose, both sets see the same int
+            if (i % 3 == 0) {
+                const auto erased = qmap.erase(key);
+                assert(erased == umap.erase(key));
+                const auto serased = qset.erase(skey);
+                assert(serased == uset.erase(skey));
+            } else {
+                qmap.insert_or_assign(key, i);
+                umap[key] = i;
+                const auto inserted = qset.insert(skey);
+                assert(inserted == uset.insert(skey).second);
+            }
+        }
+        assert(qmap.size() == umap.size() && qset.size() == uset.size());
+        size_t n = 0;
+        qmap.for_each([&](uint64_t key, int val) { assert(umap.at(key) == val); n++; });
+        assert(n == umap.size());
+        n = 0;
+        qset.for_each([&](int key) { assert(uset.count(key) == 1); n++; });
+        assert(n == uset.size());
+        for (auto key : uset)
+            assert(qset.contains(key));
+        for (const auto& kv : umap)
+            assert(qmap.at(kv.first) == kv.second);
+        bool thrown = false;
+        try { qmap.at(~(uint64_t)0); } catch (const std::out_of_range&) { thrown = true; }
+        assert(thrown == (umap.count(~(uint64_t)0) == 0));
+        assert(qset.memory() <= qset.size() * 20);
+    }
+
+    {
+        //emhash7::HashSet<std::string>: slot words stay right while keys are built and destroyed
+        emhash7::HashSet<std::string> sset;
+        std::unordered_set<std::string> uset;
+        for (int i = 0; i < 30000; i++) {
+            const auto key = "key_" + std::to_string(i * 7919 % 9000) + std::string(i % 30, 'x');
+            if (i % 7 == 3) {
+                const auto erased = sset.erase(key);
+                assert(erased == uset.erase(key));
+            } else {
+                const auto inserted = sset.insert(key).second;
+                assert(inserted == uset.insert(key).second);
+            }
+        }
+        size_t n = 0;
+        for (const auto& key : sset)
+            n += uset.count(key);
+        assert(sset.size() == uset.size() && n == uset.size());
+        for (const auto& key : uset)
+            assert(sset.contains(key));
+        sset.clear();
+        assert(sset.size() == 0 && sset.begin() == sset.end() && !sset.contains(*uset.begin()));
+        for (const auto& key : uset)
+            sset.insert(key);
+        assert(sset.size() == uset.size());
+    }
+
+#if __cplusplus >= 201703L
+    {
+        //arena string keys: churn against std::unordered_map, compaction keeps every key
+        emhash8::StringMap<int> amap;
+        std::unordered_map<std::string, int> umap;
+        for (int i = 0; i < 20000; i++) {
+            const auto key = "key_" + std::to_string(i * 7919 % 3000) + std::string(i % 40, 'x');
+            if (i % 7 == 3) {
+                assert(amap.erase(key) == umap.erase(key));
+            } else {
+                amap[key] = i; umap[key] = i;
+            }
+        }
+        assert(amap.size() == umap.size() && amap.garbage_size() > 0);
+        amap.shrink_to_fit();
+        assert(amap.garbage_size() == 0);
+        uint64_t bytes = 0;
+        for (const auto& kv : amap) {
+            const auto key = amap.key(kv.first);
+            assert(umap.at(std::string(key)) == kv.second);
+            bytes += key.size();
+        }
+        assert(bytes == amap.arena_size());
+
+        auto copy = amap;
+        amap.clear();
+        assert(amap.empty() && !amap.contains("key_1") && copy.size() == umap.size());
+        for (const auto& kv : umap)
+            assert(*copy.try_get(kv.first) == kv.second);
+
+        //a key viewing the arena is copied before the arena grows or is compacted
+        const auto view = copy.key(copy.begin()->first);
+        const std::string grown(view.substr(1));
+        assert(copy.emplace(view.substr(1), -1).second && copy.at(grown) == -1);
+        copy.shrink_to_fit();
+        const auto live = copy.key(copy.begin()->first);
+        const std::string kept(live), compacted(live.substr(2));
+        for (const auto& kv : umap)
+            if (kv.first != kept)
+                copy.erase(kv.first);
+        assert(copy.garbage_size() * 2 > copy.arena_size());
+        assert(copy.emplace(copy.key(copy.find(kept)->first).substr(2), -2).second && copy.garbage_size() == 0);
+        assert(copy.at(compacted) == -2 && copy.at(grown) == -1 && copy.count(kept) == 1);
+    }
+#endif
+
 #if CXX20
     {
         ehmap<std::string, int, string_hash, string_equal> map;